@@ -0,0 +1,299 @@
+//
+// Copyright (c) 2008-2015 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#include <Urho3D/Container/Sort.h>
+#include <Urho3D/Core/CoreEvents.h>
+#include <Urho3D/Core/ProcessUtils.h>
+#include <Urho3D/Engine/Engine.h>
+#include <Urho3D/IO/File.h>
+#include <Urho3D/IO/Log.h>
+#include <Urho3D/Physics/PhysicsEvents.h>
+#include <Urho3D/Physics/PhysicsWorld.h>
+#include <Urho3D/Scene/Scene.h>
+
+#include "Benchmark.h"
+#include "CameraOcclusion.h"
+#include "InputLatencyTracer.h"
+#include "PlatformRenderer.h"
+#include "PlatformSystem.h"
+
+#include <Urho3D/DebugNew.h>
+
+BenchmarkStats::BenchmarkStats(PODVector<float>& samples) :
+    count_(samples.Size()),
+    min_(0.0f),
+    median_(0.0f),
+    p99_(0.0f),
+    max_(0.0f),
+    mean_(0.0f)
+{
+    if (samples.Empty())
+        return;
+
+    Sort(samples.Begin(), samples.End());
+
+    float sum = 0.0f;
+    for (unsigned i = 0; i < count_; ++i)
+        sum += samples[i];
+
+    min_ = samples.Front();
+    median_ = samples[count_ / 2];
+    p99_ = samples[Min((unsigned)(count_ * 0.99f), count_ - 1)];
+    max_ = samples.Back();
+    mean_ = sum / count_;
+}
+
+String BenchmarkStats::ToJSON() const
+{
+    return "{\"min\":" + String(min_) + ",\"median\":" + String(median_) + ",\"p99\":" + String(p99_) + ",\"max\":" +
+        String(max_) + ",\"mean\":" + String(mean_) + "}";
+}
+
+Benchmark::Benchmark(Context* context) :
+    Object(context),
+    numFrames_(0),
+    warmupFrames_(0),
+    timeStep_(1.0f / 60.0f),
+    frameNumber_(0),
+    running_(false),
+    physicsUSec_(0),
+    collisions_(0)
+{
+}
+
+Benchmark::~Benchmark()
+{
+}
+
+void Benchmark::Start(Scene* scene, unsigned numFrames, unsigned warmupFrames, float timeStep)
+{
+    scene_ = scene;
+    numFrames_ = numFrames;
+    warmupFrames_ = warmupFrames;
+    timeStep_ = timeStep;
+    frameNumber_ = 0;
+    running_ = true;
+    physicsUSec_ = 0;
+    collisions_ = 0;
+
+    frameTimes_.Clear();
+    physicsTimes_.Clear();
+    platformTimes_.Clear();
+    platformRenderTimes_.Clear();
+    collisionCounts_.Clear();
+    platformCounts_.Clear();
+    broadphaseUpdateCounts_.Clear();
+    staticMoveCounts_.Clear();
+    kinematicMoveCounts_.Clear();
+    frameTimes_.Reserve(numFrames);
+    physicsTimes_.Reserve(numFrames);
+    platformTimes_.Reserve(numFrames);
+    platformRenderTimes_.Reserve(numFrames);
+    collisionCounts_.Reserve(numFrames);
+    platformCounts_.Reserve(numFrames);
+    broadphaseUpdateCounts_.Reserve(numFrames);
+    staticMoveCounts_.Reserve(numFrames);
+    kinematicMoveCounts_.Reserve(numFrames);
+
+    // Run as fast as possible with a fixed timestep, so that the results do not depend on the frame limiter or the host
+    Engine* engine = GetSubsystem<Engine>();
+    engine->SetMaxFps(0);
+    engine->SetMaxInactiveFps(0);
+    engine->SetNextTimeStep(timeStep_);
+
+    // The platform instance transforms are prepared also when headless, so the batch preparation cost is measurable here
+    PODVector<Node*> rendererNodes;
+    scene->GetChildrenWithComponent<PlatformRenderer>(rendererNodes, true);
+    platformRenderer_ = rendererNodes.Size() ? rendererNodes[0]->GetComponent<PlatformRenderer>() : 0;
+    physicsBroadphase_ = scene->GetComponent<PhysicsBroadphase>();
+
+    SubscribeToEvent(E_BEGINFRAME, HANDLER(Benchmark, HandleBeginFrame));
+    SubscribeToEvent(E_ENDFRAME, HANDLER(Benchmark, HandleEndFrame));
+
+    PhysicsWorld* physicsWorld = scene->GetComponent<PhysicsWorld>();
+    if (physicsWorld)
+    {
+        SubscribeToEvent(physicsWorld, E_PHYSICSPRESTEP, HANDLER(Benchmark, HandlePhysicsPreStep));
+        SubscribeToEvent(physicsWorld, E_PHYSICSPOSTSTEP, HANDLER(Benchmark, HandlePhysicsPostStep));
+        SubscribeToEvent(physicsWorld, E_PHYSICSCOLLISION, HANDLER(Benchmark, HandlePhysicsCollision));
+    }
+
+    LOGINFOF("Benchmark started: %u frames after %u warmup frames, timestep %f", numFrames, warmupFrames, timeStep);
+}
+
+void Benchmark::AddResult(const String& name, float value)
+{
+    for (unsigned i = 0; i < results_.Size(); ++i)
+    {
+        if (results_[i].first_ == name)
+        {
+            results_[i].second_ = value;
+            return;
+        }
+    }
+
+    results_.Push(MakePair(name, value));
+}
+
+String Benchmark::GetResultsJSON() const
+{
+    PODVector<float> frameTimes = frameTimes_;
+    PODVector<float> physicsTimes = physicsTimes_;
+    PODVector<float> platformTimes = platformTimes_;
+    PODVector<float> platformRenderTimes = platformRenderTimes_;
+    PODVector<float> collisionCounts = collisionCounts_;
+    PODVector<float> platformCounts = platformCounts_;
+    PODVector<float> broadphaseUpdateCounts = broadphaseUpdateCounts_;
+    PODVector<float> staticMoveCounts = staticMoveCounts_;
+    PODVector<float> kinematicMoveCounts = kinematicMoveCounts_;
+
+    String json = "{\"frames\":" + String(frameTimes.Size()) + ",\"warmupFrames\":" + String(warmupFrames_) + ",\"timeStep\":" +
+        String(timeStep_);
+    json += ",\"frameTimeMs\":" + BenchmarkStats(frameTimes).ToJSON();
+    json += ",\"physicsStepMs\":" + BenchmarkStats(physicsTimes).ToJSON();
+    json += ",\"platformUpdateMs\":" + BenchmarkStats(platformTimes).ToJSON();
+    json += ",\"platformBatchPrepMs\":" + BenchmarkStats(platformRenderTimes).ToJSON();
+    json += ",\"collisionEventsPerFrame\":" + BenchmarkStats(collisionCounts).ToJSON();
+    json += ",\"platformsUpdatedPerFrame\":" + BenchmarkStats(platformCounts).ToJSON();
+    if (physicsBroadphase_)
+    {
+        json += ",\"broadphaseUpdatesPerStep\":" + BenchmarkStats(broadphaseUpdateCounts).ToJSON();
+        json += ",\"staticBroadphaseMovesPerStep\":" + BenchmarkStats(staticMoveCounts).ToJSON();
+        json += ",\"kinematicBroadphaseMovesPerStep\":" + BenchmarkStats(kinematicMoveCounts).ToJSON();
+    }
+    InputLatencyTracer* latencyTracer = GetSubsystem<InputLatencyTracer>();
+    if (latencyTracer)
+        json += ",\"inputLatency\":" + latencyTracer->GetResultsJSON();
+    CameraOcclusion* occlusion = GetSubsystem<CameraOcclusion>();
+    if (occlusion)
+        json += ",\"cameraOcclusion\":" + occlusion->GetResultsJSON();
+    for (unsigned i = 0; i < results_.Size(); ++i)
+        json += ",\"" + results_[i].first_ + "\":" + String(results_[i].second_);
+    json += "}";
+
+    return json;
+}
+
+void Benchmark::HandleBeginFrame(StringHash eventType, VariantMap& eventData)
+{
+    frameTimer_.Reset();
+    physicsUSec_ = 0;
+    collisions_ = 0;
+    if (physicsBroadphase_)
+        frameBroadphaseCounters_ = physicsBroadphase_->GetCounters();
+}
+
+void Benchmark::HandleEndFrame(StringHash eventType, VariantMap& eventData)
+{
+    if (!running_)
+        return;
+
+    float frameTime = frameTimer_.GetUSec(false) / 1000.0f;
+
+    if (frameNumber_ >= warmupFrames_)
+    {
+        PlatformSystem* platformSystem = scene_ ? scene_->GetComponent<PlatformSystem>() : 0;
+
+        frameTimes_.Push(frameTime);
+        physicsTimes_.Push(physicsUSec_ / 1000.0f);
+        platformTimes_.Push(platformSystem ? platformSystem->GetLastUpdateTime() : 0.0f);
+        platformRenderTimes_.Push(platformRenderer_ ? platformRenderer_->GetLastPrepareTime() : 0.0f);
+        collisionCounts_.Push((float)collisions_);
+        platformCounts_.Push(platformSystem ? (float)platformSystem->GetNumUpdatedPlatforms() : 0.0f);
+
+        // Frames without a physics step are not recorded, so that they do not dilute the per-step averages
+        if (physicsBroadphase_)
+        {
+            const BroadphaseCounters& counters = physicsBroadphase_->GetCounters();
+            unsigned long long steps = counters.steps_ - frameBroadphaseCounters_.steps_;
+            if (steps)
+            {
+                broadphaseUpdateCounts_.Push((float)(counters.aabbUpdates_ - frameBroadphaseCounters_.aabbUpdates_) / steps);
+                staticMoveCounts_.Push((float)(counters.staticMoves_ - frameBroadphaseCounters_.staticMoves_) / steps);
+                kinematicMoveCounts_.Push((float)(counters.kinematicMoves_ - frameBroadphaseCounters_.kinematicMoves_) /
+                    steps);
+            }
+        }
+    }
+
+    ++frameNumber_;
+
+    // Input latencies and occlusion query costs are only recorded after the warmup, like the per-frame metrics
+    if (frameNumber_ == warmupFrames_)
+    {
+        InputLatencyTracer* latencyTracer = GetSubsystem<InputLatencyTracer>();
+        if (latencyTracer)
+            latencyTracer->Reset();
+        CameraOcclusion* occlusion = GetSubsystem<CameraOcclusion>();
+        if (occlusion)
+            occlusion->Reset();
+    }
+
+    if (frameNumber_ >= warmupFrames_ + numFrames_)
+        Finish();
+    else
+        GetSubsystem<Engine>()->SetNextTimeStep(timeStep_);
+}
+
+void Benchmark::HandlePhysicsPreStep(StringHash eventType, VariantMap& eventData)
+{
+    physicsTimer_.Reset();
+}
+
+void Benchmark::HandlePhysicsPostStep(StringHash eventType, VariantMap& eventData)
+{
+    physicsUSec_ += physicsTimer_.GetUSec(false);
+}
+
+void Benchmark::HandlePhysicsCollision(StringHash eventType, VariantMap& eventData)
+{
+    ++collisions_;
+}
+
+void Benchmark::Finish()
+{
+    running_ = false;
+    UnsubscribeFromAllEvents();
+
+    // Platform LOD tier populations at the end of the run
+    PlatformSystem* platformSystem = scene_ ? scene_->GetComponent<PlatformSystem>() : 0;
+    if (platformSystem)
+    {
+        AddResult("platformsFullRate", (float)platformSystem->GetNumPlatformsInTier(PLATFORM_LOD_FULL));
+        AddResult("platformsReducedRate", (float)platformSystem->GetNumPlatformsInTier(PLATFORM_LOD_REDUCED));
+        AddResult("platformsFrozen", (float)platformSystem->GetNumPlatformsInTier(PLATFORM_LOD_FROZEN));
+    }
+
+    String json = GetResultsJSON();
+    PrintLine(json);
+
+    if (!outputFile_.Empty())
+    {
+        File file(context_, outputFile_, FILE_WRITE);
+        if (file.IsOpen())
+            file.WriteLine(json);
+        else
+            LOGERROR("Could not write benchmark results to " + outputFile_);
+    }
+
+    GetSubsystem<Engine>()->Exit();
+}
@@ -0,0 +1,159 @@
+//
+// Copyright (c) 2008-2015 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#pragma once
+
+#include <Urho3D/Container/Pair.h>
+#include <Urho3D/Core/Object.h>
+#include <Urho3D/Core/Timer.h>
+
+#include "PhysicsBroadphase.h"
+
+namespace Urho3D
+{
+
+class Scene;
+
+}
+
+using namespace Urho3D;
+
+class PlatformRenderer;
+
+/// Summary statistics of one per-frame benchmark metric.
+struct BenchmarkStats
+{
+    /// Construct from samples. The samples are sorted in place.
+    BenchmarkStats(PODVector<float>& samples);
+
+    /// Return as a JSON object.
+    String ToJSON() const;
+
+    /// Number of samples.
+    unsigned count_;
+    /// Minimum.
+    float min_;
+    /// Median.
+    float median_;
+    /// 99th percentile.
+    float p99_;
+    /// Maximum.
+    float max_;
+    /// Mean.
+    float mean_;
+};
+
+/// Headless benchmark driver. Runs the scene with a fixed timestep for a set number of frames, records frame, physics
+/// step, platform update and platform batch preparation times, collision events and evaluated platforms per frame, the
+/// broadphase updates per physics step when the scene has a PhysicsBroadphase, and the input latency histograms when an
+/// InputLatencyTracer is present, then prints the summary as JSON and exits the engine.
+class Benchmark : public Object
+{
+    OBJECT(Benchmark);
+
+public:
+    /// Construct.
+    Benchmark(Context* context);
+    /// Destruct.
+    virtual ~Benchmark();
+
+    /// Start measuring the scene. The first warmup frames are simulated but not recorded.
+    void Start(Scene* scene, unsigned numFrames, unsigned warmupFrames, float timeStep);
+    /// Set a file to also write the results to.
+    void SetOutputFile(const String& fileName) { outputFile_ = fileName; }
+    /// Add a named value to the results, for measurements taken outside the frame loop.
+    void AddResult(const String& name, float value);
+
+    /// Return whether the benchmark is running.
+    bool IsRunning() const { return running_; }
+    /// Return number of frames simulated so far, including warmup.
+    unsigned GetFrameNumber() const { return frameNumber_; }
+    /// Return simulated time since the start.
+    float GetElapsedTime() const { return frameNumber_ * timeStep_; }
+    /// Return the fixed timestep.
+    float GetTimeStep() const { return timeStep_; }
+    /// Return the results as JSON.
+    String GetResultsJSON() const;
+
+private:
+    /// Handle frame begin.
+    void HandleBeginFrame(StringHash eventType, VariantMap& eventData);
+    /// Handle frame end. Records the frame and finishes the benchmark when done.
+    void HandleEndFrame(StringHash eventType, VariantMap& eventData);
+    /// Handle physics step begin.
+    void HandlePhysicsPreStep(StringHash eventType, VariantMap& eventData);
+    /// Handle physics step end.
+    void HandlePhysicsPostStep(StringHash eventType, VariantMap& eventData);
+    /// Handle a physics collision.
+    void HandlePhysicsCollision(StringHash eventType, VariantMap& eventData);
+    /// Print and save the results and exit the engine.
+    void Finish();
+
+    /// Scene being measured.
+    WeakPtr<Scene> scene_;
+    /// Platform renderer of the scene, if any.
+    WeakPtr<PlatformRenderer> platformRenderer_;
+    /// Broadphase counters of the scene, if any.
+    WeakPtr<PhysicsBroadphase> physicsBroadphase_;
+    /// Broadphase totals at the start of the current frame.
+    BroadphaseCounters frameBroadphaseCounters_;
+    /// Output file name.
+    String outputFile_;
+    /// Frames to record.
+    unsigned numFrames_;
+    /// Frames to simulate before recording.
+    unsigned warmupFrames_;
+    /// Fixed timestep.
+    float timeStep_;
+    /// Frames simulated so far.
+    unsigned frameNumber_;
+    /// Running flag.
+    bool running_;
+    /// Frame timer.
+    HiresTimer frameTimer_;
+    /// Physics step timer.
+    HiresTimer physicsTimer_;
+    /// Physics step time accumulated during the current frame in microseconds.
+    long long physicsUSec_;
+    /// Collision events during the current frame.
+    unsigned collisions_;
+    /// Recorded frame times in milliseconds.
+    PODVector<float> frameTimes_;
+    /// Recorded physics step times in milliseconds.
+    PODVector<float> physicsTimes_;
+    /// Recorded platform update times in milliseconds.
+    PODVector<float> platformTimes_;
+    /// Recorded collision events per frame.
+    PODVector<float> collisionCounts_;
+    /// Recorded platform instance preparation times in milliseconds.
+    PODVector<float> platformRenderTimes_;
+    /// Recorded number of platforms evaluated per frame.
+    PODVector<float> platformCounts_;
+    /// Recorded broadphase bounding box updates per physics step, averaged over each frame.
+    PODVector<float> broadphaseUpdateCounts_;
+    /// Recorded broadphase moves of static bodies per physics step, averaged over each frame.
+    PODVector<float> staticMoveCounts_;
+    /// Recorded broadphase moves of kinematic bodies per physics step, averaged over each frame.
+    PODVector<float> kinematicMoveCounts_;
+    /// Extra named results.
+    Vector<Pair<String, float> > results_;
+};
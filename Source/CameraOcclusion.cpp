@@ -0,0 +1,228 @@
+//
+// Copyright (c) 2008-2015 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#include <Urho3D/Core/CoreEvents.h>
+#include <Urho3D/Core/StringUtils.h>
+#include <Urho3D/Engine/DebugHud.h>
+#include <Urho3D/Math/Ray.h>
+#include <Urho3D/Physics/PhysicsUtils.h>
+#include <Urho3D/Physics/PhysicsWorld.h>
+#include <Urho3D/Physics/RigidBody.h>
+
+#include <Bullet/BulletDynamics/Dynamics/btDiscreteDynamicsWorld.h>
+#include <Bullet/BulletDynamics/Dynamics/btRigidBody.h>
+
+#include "CameraOcclusion.h"
+
+#include <Urho3D/DebugNew.h>
+
+/// Interval between debug HUD updates in milliseconds.
+static const unsigned OCCLUSION_HUD_INTERVAL = 500;
+
+CameraOcclusion::CameraOcclusion(Context* context) :
+    Object(context),
+    maxDistance_(0.0f),
+    collisionMask_(0),
+    hitDistance_(0.0f),
+    smoothedDistance_(-1.0f),
+    cacheAge_(0.0f),
+    moveThreshold_(DEFAULT_OCCLUSION_MOVE_THRESHOLD),
+    cosAngleThreshold_(Cos(DEFAULT_OCCLUSION_ANGLE_THRESHOLD)),
+    maxCacheAge_(DEFAULT_OCCLUSION_MAX_CACHE_AGE),
+    watchMargin_(DEFAULT_OCCLUSION_WATCH_MARGIN),
+    returnSpeed_(DEFAULT_OCCLUSION_RETURN_SPEED),
+    cacheValid_(false),
+    numQueries_(0),
+    numFullRaycasts_(0),
+    cachedUSec_(0),
+    fullUSec_(0)
+{
+    SubscribeToEvent(E_ENDFRAME, HANDLER(CameraOcclusion, HandleEndFrame));
+}
+
+CameraOcclusion::~CameraOcclusion()
+{
+}
+
+float CameraOcclusion::Update(PhysicsWorld* world, const Vector3& aimPoint, const Vector3& direction, float maxDistance,
+    unsigned collisionMask, float timeStep)
+{
+    if (!world)
+        return maxDistance;
+
+    HiresTimer timer;
+    Ray ray(aimPoint, direction);
+    ++numQueries_;
+    cacheAge_ += timeStep;
+
+    // While nothing moved much, only the last hit body is retested, which follows its small movements
+    bool cached = IsCacheValid(ray, maxDistance, collisionMask);
+    if (cached && hitBody_)
+        cached = RetestHitBody(ray, maxDistance);
+
+    if (cached)
+        cachedUSec_ += timer.GetUSec(false);
+    else
+    {
+        CastRay(world, ray, maxDistance, collisionMask);
+        ++numFullRaycasts_;
+        fullUSec_ += timer.GetUSec(false);
+    }
+
+    // Pull in at once so that the view is never blocked, ease back out once the occluder is gone
+    if (smoothedDistance_ < 0.0f || hitDistance_ < smoothedDistance_)
+        smoothedDistance_ = hitDistance_;
+    else
+        smoothedDistance_ += (hitDistance_ - smoothedDistance_) * Min(timeStep * returnSpeed_, 1.0f);
+
+    return smoothedDistance_;
+}
+
+void CameraOcclusion::Invalidate()
+{
+    cacheValid_ = false;
+}
+
+void CameraOcclusion::Reset()
+{
+    numQueries_ = 0;
+    numFullRaycasts_ = 0;
+    cachedUSec_ = 0;
+    fullUSec_ = 0;
+}
+
+void CameraOcclusion::SetMoveThreshold(float distance)
+{
+    moveThreshold_ = Max(distance, 0.0f);
+}
+
+void CameraOcclusion::SetAngleThreshold(float degrees)
+{
+    cosAngleThreshold_ = Cos(Clamp(degrees, 0.0f, 180.0f));
+}
+
+void CameraOcclusion::SetMaxCacheAge(float age)
+{
+    maxCacheAge_ = Max(age, 0.0f);
+}
+
+void CameraOcclusion::SetWatchMargin(float margin)
+{
+    watchMargin_ = Max(margin, 0.0f);
+    cacheValid_ = false;
+}
+
+void CameraOcclusion::SetReturnSpeed(float speed)
+{
+    returnSpeed_ = Max(speed, 0.0f);
+}
+
+String CameraOcclusion::GetResultsJSON() const
+{
+    unsigned numCached = numQueries_ - numFullRaycasts_;
+    return "{\"queries\":" + String(numQueries_) + ",\"fullRaycasts\":" + String(numFullRaycasts_) + ",\"hitRate\":" +
+        String(GetHitRate()) + ",\"cachedQueryUs\":" + String(numCached ? (float)cachedUSec_ / numCached : 0.0f) +
+        ",\"fullQueryUs\":" + String(numFullRaycasts_ ? (float)fullUSec_ / numFullRaycasts_ : 0.0f) + "}";
+}
+
+void CameraOcclusion::HandleEndFrame(StringHash eventType, VariantMap& eventData)
+{
+    DebugHud* debugHud = GetSubsystem<DebugHud>();
+    if (!debugHud || !debugHud->GetMode() || hudTimer_.GetMSec(false) < OCCLUSION_HUD_INTERVAL)
+        return;
+
+    hudTimer_.Reset();
+    unsigned numCached = numQueries_ - numFullRaycasts_;
+    debugHud->SetAppStats("Camera occlusion hit rate / us", ToString("%.1f%% cached %.1f full %.1f", GetHitRate() * 100.0f,
+        numCached ? (float)cachedUSec_ / numCached : 0.0f, numFullRaycasts_ ? (float)fullUSec_ / numFullRaycasts_ : 0.0f));
+}
+
+bool CameraOcclusion::IsCacheValid(const Ray& ray, float maxDistance, unsigned collisionMask) const
+{
+    if (!cacheValid_ || cacheAge_ >= maxCacheAge_ || maxDistance != maxDistance_ || collisionMask != collisionMask_)
+        return false;
+
+    float thresholdSquared = moveThreshold_ * moveThreshold_;
+    if ((ray.origin_ - aimPoint_).LengthSquared() > thresholdSquared || ray.direction_.DotProduct(direction_) < cosAngleThreshold_)
+        return false;
+
+    // The last hit body is among the watched bodies, so it being removed is caught here too
+    for (unsigned i = 0; i < watchedBodies_.Size(); ++i)
+    {
+        RigidBody* body = watchedBodies_[i];
+        if (!body || (body->GetPosition() - watchedPositions_[i]).LengthSquared() > thresholdSquared)
+            return false;
+    }
+
+    return true;
+}
+
+bool CameraOcclusion::RetestHitBody(const Ray& ray, float maxDistance)
+{
+    btRigidBody* object = hitBody_->GetBody();
+    if (!object || !object->getCollisionShape())
+        return false;
+
+    btVector3 from = ToBtVector3(ray.origin_);
+    btVector3 to = ToBtVector3(ray.origin_ + ray.direction_ * maxDistance);
+    btCollisionWorld::ClosestRayResultCallback callback(from, to);
+    btCollisionWorld::rayTestSingle(btTransform(btQuaternion::getIdentity(), from), btTransform(btQuaternion::getIdentity(), to),
+        object, object->getCollisionShape(), object->getWorldTransform(), callback);
+    if (!callback.hasHit())
+        return false;
+
+    hitDistance_ = callback.m_closestHitFraction * maxDistance;
+    return true;
+}
+
+void CameraOcclusion::CastRay(PhysicsWorld* world, const Ray& ray, float maxDistance, unsigned collisionMask)
+{
+    PhysicsRaycastResult result;
+    world->RaycastSingle(result, ray, maxDistance, collisionMask);
+    hitBody_ = result.body_;
+    hitDistance_ = result.body_ ? result.distance_ : maxDistance;
+
+    // Watch the bodies that could block the ray after moving less than the watch margin
+    Vector3 end = ray.origin_ + ray.direction_ * maxDistance;
+    Vector3 margin(watchMargin_, watchMargin_, watchMargin_);
+    BoundingBox box(ray.origin_, ray.origin_);
+    box.Merge(end);
+    box.min_ -= margin;
+    box.max_ += margin;
+    PODVector<RigidBody*> bodies;
+    world->GetRigidBodies(bodies, box, collisionMask);
+
+    watchedBodies_.Resize(bodies.Size());
+    watchedPositions_.Resize(bodies.Size());
+    for (unsigned i = 0; i < bodies.Size(); ++i)
+    {
+        watchedBodies_[i] = bodies[i];
+        watchedPositions_[i] = bodies[i]->GetPosition();
+    }
+
+    aimPoint_ = ray.origin_;
+    direction_ = ray.direction_;
+    maxDistance_ = maxDistance;
+    collisionMask_ = collisionMask;
+    cacheAge_ = 0.0f;
+    cacheValid_ = true;
+}
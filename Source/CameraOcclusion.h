@@ -0,0 +1,152 @@
+//
+// Copyright (c) 2008-2015 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#pragma once
+
+#include <Urho3D/Core/Object.h>
+#include <Urho3D/Core/Timer.h>
+#include <Urho3D/Math/Vector3.h>
+
+namespace Urho3D
+{
+
+class PhysicsWorld;
+class Ray;
+class RigidBody;
+
+}
+
+using namespace Urho3D;
+
+/// Default aim and body movement below which the cached result is reused.
+static const float DEFAULT_OCCLUSION_MOVE_THRESHOLD = 0.25f;
+/// Default aim direction change in degrees below which the cached result is reused.
+static const float DEFAULT_OCCLUSION_ANGLE_THRESHOLD = 2.0f;
+/// Default age in seconds after which a full raycast is cast regardless.
+static const float DEFAULT_OCCLUSION_MAX_CACHE_AGE = 0.25f;
+/// Default margin around the ray within which bodies are watched for movement.
+static const float DEFAULT_OCCLUSION_WATCH_MARGIN = 2.0f;
+/// Default fraction per second by which the camera distance returns outwards after an occluder is gone.
+static const float DEFAULT_OCCLUSION_RETURN_SPEED = 5.0f;
+
+/// Temporally coherent camera occlusion query. Finds how far the camera can be along a ray from the aim point before
+/// scenery blocks the view, without a full physics raycast through the whole scene every frame. After a full raycast it
+/// keeps the hit body and watches the bodies around the ray; while the aim and the watched bodies stay within the move
+/// threshold, it only retests the ray against the last hit body. A full raycast runs when something moved beyond the
+/// threshold, the last hit body no longer blocks the ray, or the result is older than the maximum cache age, which covers
+/// bodies moving into the ray from beyond the watch margin. The returned distance is pulled in at once and eased back
+/// out. Query counts, the cache hit rate and the query costs are shown in the debug HUD.
+class CameraOcclusion : public Object
+{
+    OBJECT(CameraOcclusion);
+
+public:
+    /// Construct.
+    CameraOcclusion(Context* context);
+    /// Destruct.
+    virtual ~CameraOcclusion();
+
+    /// Return the smoothed distance along the ray from the aim point, up to the maximum distance, at which the first body
+    /// in the collision mask blocks the ray.
+    float Update(PhysicsWorld* world, const Vector3& aimPoint, const Vector3& direction, float maxDistance,
+        unsigned collisionMask, float timeStep);
+    /// Forget the cached result, so that the next query casts a full ray.
+    void Invalidate();
+    /// Clear the query counts and costs.
+    void Reset();
+    /// Set aim and body movement below which the cached result is reused.
+    void SetMoveThreshold(float distance);
+    /// Set aim direction change in degrees below which the cached result is reused.
+    void SetAngleThreshold(float degrees);
+    /// Set age in seconds after which a full raycast is cast regardless.
+    void SetMaxCacheAge(float age);
+    /// Set margin around the ray within which bodies are watched for movement.
+    void SetWatchMargin(float margin);
+    /// Set fraction per second by which the distance returns outwards.
+    void SetReturnSpeed(float speed);
+
+    /// Return unsmoothed distance found by the last query.
+    float GetHitDistance() const { return hitDistance_; }
+    /// Return body hit by the last query, or null if the ray was clear.
+    RigidBody* GetHitBody() const { return hitBody_; }
+    /// Return number of queries.
+    unsigned GetNumQueries() const { return numQueries_; }
+    /// Return number of queries that cast a full raycast.
+    unsigned GetNumFullRaycasts() const { return numFullRaycasts_; }
+    /// Return fraction of queries answered from the cache.
+    float GetHitRate() const { return numQueries_ ? (float)(numQueries_ - numFullRaycasts_) / numQueries_ : 0.0f; }
+    /// Return the query counts and average costs as JSON, in microseconds.
+    String GetResultsJSON() const;
+
+private:
+    /// Handle frame end. Updates the debug HUD.
+    void HandleEndFrame(StringHash eventType, VariantMap& eventData);
+    /// Return whether the cached result can be reused for a ray.
+    bool IsCacheValid(const Ray& ray, float maxDistance, unsigned collisionMask) const;
+    /// Retest the ray against the last hit body. Return true if it still blocks the ray.
+    bool RetestHitBody(const Ray& ray, float maxDistance);
+    /// Cast a full raycast and collect the bodies to watch.
+    void CastRay(PhysicsWorld* world, const Ray& ray, float maxDistance, unsigned collisionMask);
+
+    /// Aim point of the last full raycast.
+    Vector3 aimPoint_;
+    /// Ray direction of the last full raycast.
+    Vector3 direction_;
+    /// Maximum distance of the last full raycast.
+    float maxDistance_;
+    /// Collision mask of the last full raycast.
+    unsigned collisionMask_;
+    /// Body hit by the last query.
+    WeakPtr<RigidBody> hitBody_;
+    /// Bodies around the ray at the last full raycast.
+    Vector<WeakPtr<RigidBody> > watchedBodies_;
+    /// Positions of the watched bodies at the last full raycast.
+    PODVector<Vector3> watchedPositions_;
+    /// Unsmoothed distance found by the last query.
+    float hitDistance_;
+    /// Smoothed distance.
+    float smoothedDistance_;
+    /// Time since the last full raycast.
+    float cacheAge_;
+    /// Aim and body movement threshold.
+    float moveThreshold_;
+    /// Cosine of the aim direction change threshold.
+    float cosAngleThreshold_;
+    /// Maximum cache age.
+    float maxCacheAge_;
+    /// Watch margin around the ray.
+    float watchMargin_;
+    /// Return speed of the smoothed distance.
+    float returnSpeed_;
+    /// Cached result valid flag.
+    bool cacheValid_;
+    /// Number of queries.
+    unsigned numQueries_;
+    /// Number of queries that cast a full raycast.
+    unsigned numFullRaycasts_;
+    /// Time spent in queries answered from the cache, in microseconds.
+    long long cachedUSec_;
+    /// Time spent in queries that cast a full raycast, in microseconds.
+    long long fullUSec_;
+    /// Debug HUD update timer.
+    Timer hudTimer_;
+};
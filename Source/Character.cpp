@@ -22,7 +22,9 @@
 
 #include <Urho3D/Core/Context.h>
 #include <Urho3D/Graphics/AnimationController.h>
-#include <Urho3D/IO/MemoryBuffer.h>
+#include <Urho3D/Graphics/Material.h>
+#include <Urho3D/Graphics/Model.h>
+#include <Urho3D/Graphics/StaticModel.h>
 #include <Urho3D/Physics/PhysicsEvents.h>
 #include <Urho3D/Physics/PhysicsWorld.h>
 #include <Urho3D/Physics/RigidBody.h>
@@ -34,7 +36,12 @@
 
 
 #include "Character.h"
-#include "Platform.h"
+#include "GroundProbeSystem.h"
+#include "InputLatencyTracer.h"
+#include "InputRecorder.h"
+#include "PhysicsContacts.h"
+#include "PlatformSystem.h"
+#include "TraceCapture.h"
 
 #include <iostream>
 
@@ -44,36 +51,111 @@ Character::Character(Context* context) :
     okToJump_(true),
     inAirTimer_(0.0f),
     onPlatform_(false),
-    transform_(Vector3(0,0,0)),
-    contactTransform_(Vector3(0,0,0)),
-    platformTransform_(Vector3(0,0,0)),
-    currentTransform_(Vector3(0,0,0)),
-    switchTransform_(true)
+    platformIndex_(M_MAX_UNSIGNED),
+    platformVelocity_(Vector3::ZERO),
+    savedFriction_(0.0f),
+    appliedInputSequence_(0),
+    platformNodeID_(0),
+    platformNodeDirty_(false)
 {
     // Only the physics update event is needed: unsubscribe from the rest for optimization
     SetUpdateEventMask(USE_FIXEDUPDATE);
 }
 
+Character::~Character()
+{
+    if (contacts_)
+        contacts_->RemoveListener(this);
+}
+
 void Character::RegisterObject(Context* context)
 {
     context->RegisterFactory<Character>();
 
+    // These macros register the class attributes to the Context for automatic load / save handling.
+    // We specify the Default attribute mode which means it will be used both for saving into file, and network replication
+    ATTRIBUTE("Controls Yaw", float, controls_.yaw_, 0.0f, AM_DEFAULT);
+    ATTRIBUTE("Controls Pitch", float, controls_.pitch_, 0.0f, AM_DEFAULT);
+    ATTRIBUTE("On Ground", bool, onGround_, false, AM_DEFAULT);
+    ATTRIBUTE("OK To Jump", bool, okToJump_, true, AM_DEFAULT);
+    ATTRIBUTE("In Air Timer", float, inAirTimer_, 0.0f, AM_DEFAULT);
+    ATTRIBUTE("On Platform", bool, onPlatform_, false, AM_DEFAULT);
+    ACCESSOR_ATTRIBUTE("Platform Node", GetPlatformNodeAttr, SetPlatformNodeAttr, unsigned, 0, AM_DEFAULT | AM_NODEID);
+    ATTRIBUTE("Platform Velocity", Vector3, platformVelocity_, Vector3::ZERO, AM_DEFAULT);
+    ATTRIBUTE("Saved Friction", float, savedFriction_, 0.0f, AM_DEFAULT);
+}
+
+void Character::ApplyAttributes()
+{
+    if (!platformNodeDirty_)
+        return;
+
+    platformNodeDirty_ = false;
+
+    // The node ID has been remapped by now, so the ridden platform can be looked up from the platform system
+    Scene* scene = GetScene();
+    PlatformSystem* platformSystem = scene ? scene->GetComponent<PlatformSystem>() : 0;
+    otherBody_ = scene && platformNodeID_ ? scene->GetNode(platformNodeID_) : 0;
+    platformIndex_ = platformSystem ? platformSystem->GetPlatformIndex(otherBody_) : M_MAX_UNSIGNED;
+
+    if (platformIndex_ == M_MAX_UNSIGNED)
+    {
+        otherBody_.Reset();
+        platformVelocity_ = Vector3::ZERO;
+        onPlatform_ = false;
+    }
+}
+
+void Character::SetPlatformNodeAttr(unsigned nodeID)
+{
+    platformNodeID_ = nodeID;
+    platformNodeDirty_ = true;
+}
+
+unsigned Character::GetPlatformNodeAttr() const
+{
+    return platformNodeDirty_ ? platformNodeID_ : (otherBody_ ? otherBody_->GetID() : 0);
 }
 
 void Character::Start()
 {
-    // Component has been inserted into its scene node. Subscribe to events now
-    SubscribeToEvent(GetNode(), E_NODECOLLISION, HANDLER(Character, HandleNodeCollision));
-    SubscribeToEvent(GetNode(), E_NODECOLLISIONSTART, HANDLER(Character, HandleNodeCollisionStart));
-    SubscribeToEvent(GetNode(), E_NODECOLLISIONEND, HANDLER(Character, HandleNodeCollisionEnd));
+    platformSystem_ = GetScene()->GetComponent<PlatformSystem>();
+    contacts_ = GetScene()->GetComponent<PhysicsContacts>();
+    body_ = GetComponent<RigidBody>();
+    
+    // Component has been inserted into its scene node. Listen to the collisions of the body now; they are delivered by
+    // a direct call from the contact index instead of the node collision events
+    if (contacts_)
+        contacts_->AddListener(body_, this);
+    
+    // Ground detection is left to one downward probe per physics step instead of per-step collision events
+    groundProbes_ = GetScene()->GetComponent<GroundProbeSystem>();
+    if (groundProbes_)
+        groundProbes_->AddProbe(node_);
+
+    latencyTracer_ = GetSubsystem<InputLatencyTracer>();
+    inputRecorder_ = GetSubsystem<InputRecorder>();
     
     CreateSphere(Urho3D::Vector3(0,0,0));
 }
 
 void Character::FixedUpdate(float timeStep)
 {
-    /// \todo Could cache the components for faster access instead of finding them each frame
-    RigidBody* body = GetComponent<RigidBody>();
+    TRACE_ZONE("Character::FixedUpdate");
+
+    RigidBody* body = body_;
+    if (!body)
+        return;
+
+    // The controls of each physics step are what an input recording stores, and what a replay overwrites
+    if (inputRecorder_)
+    {
+        inputRecorder_->ProcessStep(controls_);
+        if (inputRecorder_->IsReplaying())
+            node_->SetRotation(Quaternion(controls_.yaw_, Vector3::UP));
+    }
+
+    onGround_ = IsOnGround();
 
     // Update the in air timer. Reset if grounded
     if (!onGround_)
@@ -83,10 +165,24 @@ void Character::FixedUpdate(float timeStep)
     // When character has been in air less than 1/10 second, it's still interpreted as being on ground
     bool softGrounded = inAirTimer_ < INAIR_THRESHOLD_TIME;
 
+    // Carry the character along with the platform it rides: swap last step's platform velocity for the current one.
+    // The rest of the movement logic then works on the velocity relative to the platform
+    if (onPlatform_)
+    {
+        if (platformSystem_ && platformSystem_->GetPlatformNode(platformIndex_) == otherBody_)
+        {
+            Vector3 platformVelocity = platformSystem_->GetPlatformVelocity(platformIndex_, platformSystem_->GetTime());
+            body->SetLinearVelocity(body->GetLinearVelocity() + platformVelocity - platformVelocity_);
+            platformVelocity_ = platformVelocity;
+        }
+        else
+            LeavePlatform();
+    }
+
     // Update movement & animation
     const Quaternion& rot = node_->GetRotation();
     Vector3 moveDir = Vector3::ZERO;
-    const Vector3& velocity = body->GetLinearVelocity();
+    Vector3 velocity = body->GetLinearVelocity() - platformVelocity_;
     // Velocity on the XZ plane
     Vector3 planeVelocity(velocity.x_, 0.0f, velocity.z_);
 
@@ -125,109 +221,74 @@ void Character::FixedUpdate(float timeStep)
             okToJump_ = true;
     }
 
-    
-    if(onPlatform_)
+    // The controls sampled on the render frame have now reached the physics simulation
+    if (latencyTracer_)
     {
-        if(switchTransform_)
-        {
-            Vector3 diff = currentTransform_ - platformTransform_  ;
-            Vector3 combine =  diff + otherBody_->GetWorldPosition();
-            
-            node_->GetComponent<RigidBody>()->SetFriction(0);
-            node_->GetComponent<RigidBody>()->SetRestitution(0);
-            node_->SetWorldPosition(combine);
-            
-            testSphere_->SetWorldPosition(combine);
-        }
-        else
-        {
-            node_->SetParent(otherBody_);
-        }
-        
+        latencyTracer_->MarkApplied();
+        appliedInputSequence_ = latencyTracer_->GetInputSequence();
     }
 
-    
-    // Reset grounded flag for next frame
-    onGround_ = false;
-    
     //onPlatform_ = false;
     
 }
 
-void Character::HandleNodeCollision(StringHash eventType, VariantMap& eventData)
+bool Character::IsOnGround() const
 {
-    using namespace NodeCollision;
-    
-    Node* otherNode = (Node*)eventData[P_OTHERNODE].GetPtr();
-    
-    MemoryBuffer contacts(eventData[P_CONTACTS].GetBuffer());
-    
-    while (!contacts.IsEof())
-    {
-        Vector3 contactPosition = contacts.ReadVector3();
-        Vector3 contactNormal = contacts.ReadVector3();
-        /*float contactDistance = */contacts.ReadFloat();
-        /*float contactImpulse = */contacts.ReadFloat();
-        
-        // If contact is below node center and mostly vertical, assume it's a ground contact
-        if (contactPosition.y_ < (node_->GetPosition().y_ + 1.0f))
-        {
-            float level = Abs(contactNormal.y_);
-            if (level > 0.75)
-                onGround_ = true;
-        }
-        
-        
-    }
+    return groundProbes_ && groundProbes_->IsGrounded(node_);
 }
 
-void Character::HandleNodeCollisionStart(StringHash eventType, VariantMap& eventData)
+void Character::OnCollisionStart(const CollisionData& collision)
 {
-    // Check collision contacts and see if character is standing on ground (look for a contact that has near vertical normal)
-    using namespace NodeCollision;
-    
-    Node* otherNode = (Node*)eventData[P_OTHERNODE].GetPtr();
-    
-    Platform *platform = otherNode->GetComponent<Platform>();
-    
-    
+    TRACE_ZONE("Character::OnCollisionStart");
+
+    // Check the new contacts and see if character landed on a moving platform (look for a contact that has vertical normal)
+    if (onPlatform_ || !body_ || !platformSystem_)
+        return;
     
-    MemoryBuffer contacts(eventData[P_CONTACTS].GetBuffer());
+    Node* otherNode = collision.otherNode_;
+    unsigned platformIndex = platformSystem_->GetPlatformIndex(otherNode);
+    if (platformIndex == M_MAX_UNSIGNED)
+        return;
     
+    const ContactManifoldView* manifold = collision.manifold_;
     
-    while (!contacts.IsEof())
+    for (unsigned i = 0; i < manifold->GetNumContacts(); ++i)
     {
-        Vector3 contactPosition = contacts.ReadVector3();
-        Vector3 contactNormal = contacts.ReadVector3();
-        /*float contactDistance = */contacts.ReadFloat();
-        /*float contactImpulse = */contacts.ReadFloat();
-        
-        
-        if (platform)
+        if (manifold->GetNormal(i).DotProduct(Vector3(0,1.0,0))==1.0)
         {
-            if (!onPlatform_)
-            {
-                if(contactNormal.DotProduct(Vector3(0,1.0,0))==1.0)
-                {
-                    
-                    otherBody_ = otherNode;
-                    contactTransform_ = contactPosition;
-                    platformTransform_ = otherNode->GetWorldPosition();
-                    currentTransform_ = node_->GetWorldPosition();
-                    
-                    
-                    onPlatform_ = true;
-                }
-                
-            }
+            // Board the platform. Everything needed while riding is captured here once; the platform velocity is
+            // transferred from the next physics step on, so friction is disabled to keep the contact from
+            // dragging against it
+            otherBody_ = otherNode;
+            platformIndex_ = platformIndex;
+            platformVelocity_ = Vector3::ZERO;
+            savedFriction_ = body_->GetFriction();
+            body_->SetFriction(0.0f);
             
+            testSphere_->SetWorldPosition(manifold->GetPosition(i));
+            
+            onPlatform_ = true;
+            break;
         }
     }
-    
 }
 
-void Character::HandleNodeCollisionEnd(StringHash eventType, VariantMap& eventData)
+void Character::OnCollisionEnd(const CollisionData& collision)
 {
+    TRACE_ZONE("Character::OnCollisionEnd");
+
+    if (onPlatform_ && collision.otherNode_ == otherBody_.Get())
+        LeavePlatform();
+}
+
+void Character::LeavePlatform()
+{
+    if (body_)
+        body_->SetFriction(savedFriction_);
+    
+    otherBody_.Reset();
+    platformIndex_ = M_MAX_UNSIGNED;
+    platformVelocity_ = Vector3::ZERO;
     onPlatform_ = false;
 }
 
@@ -25,8 +25,22 @@
 #include <Urho3D/Input/Controls.h>
 #include <Urho3D/Scene/LogicComponent.h>
 
+#include "PhysicsContacts.h"
+
+namespace Urho3D
+{
+
+class RigidBody;
+
+}
+
 using namespace Urho3D;
 
+class GroundProbeSystem;
+class InputLatencyTracer;
+class InputRecorder;
+class PlatformSystem;
+
 const int CTRL_FORWARD = 1;
 const int CTRL_BACK = 2;
 const int CTRL_LEFT = 4;
@@ -39,33 +53,53 @@ const float BRAKE_FORCE = 0.2f;
 const float JUMP_FORCE = 7.0f;
 const float YAW_SENSITIVITY = 0.1f;
 const float INAIR_THRESHOLD_TIME = 0.1f;
+const float CAMERA_DISTANCE = 10.0f;
+const float CAMERA_MIN_DISTANCE = 1.0f;
 
 /// Character component, responsible for physical movement according to controls, as well as animation.
-class Character : public LogicComponent
+class Character : public LogicComponent, public CollisionListener
 {
     OBJECT(Character)
 
 public:
     /// Construct.
     Character(Context* context);
+    /// Destruct.
+    virtual ~Character();
     
     /// Register object factory and attributes.
     static void RegisterObject(Context* context);
+
+    /// Apply attribute changes that can not be applied immediately. Resolves the ridden platform after loading.
+    virtual void ApplyAttributes();
     
     /// Handle startup. Called by LogicComponent base class.
     virtual void Start();
     /// Handle physics world update. Called by LogicComponent base class.
     virtual void FixedUpdate(float timeStep);
+    /// Handle a collision that started, to board moving platforms. Called by the contact index.
+    virtual void OnCollisionStart(const CollisionData& collision);
+    /// Handle a collision that ended, to leave the ridden platform. Called by the contact index.
+    virtual void OnCollisionEnd(const CollisionData& collision);
     
     
+    /// Return whether the character is riding a moving platform.
+    bool IsOnPlatform() const { return onPlatform_; }
+    /// Return sequence number of the traced input the last physics step applied.
+    unsigned GetAppliedInputSequence() const { return appliedInputSequence_; }
+    /// Set ridden platform node ID attribute.
+    void SetPlatformNodeAttr(unsigned nodeID);
+    /// Return ridden platform node ID attribute.
+    unsigned GetPlatformNodeAttr() const;
+    
     /// Movement controls. Assigned by the main program each frame.
     Controls controls_;
     
 private:
-    /// Handle physics collision event.
-    void HandleNodeCollision(StringHash eventType, VariantMap& eventData);
-    void HandleNodeCollisionStart(StringHash eventType, VariantMap& eventData);
-    void HandleNodeCollisionEnd(StringHash eventType, VariantMap& eventData);
+    /// Return whether the ground probe found ground below the character after the last physics step.
+    bool IsOnGround() const;
+    /// Stop riding the current platform. The character keeps its absolute velocity.
+    void LeavePlatform();
     
     void CreateSphere(Vector3 position);
     
@@ -76,16 +110,36 @@ private:
     /// In air timer. Due to possible physics inaccuracy, character can be off ground for max. 1/10 second and still be allowed to move.
     float inAirTimer_;
     
+    /// Standing on a moving platform flag.
     bool onPlatform_;
     
-    bool switchTransform_;
-    
     SharedPtr<Node> testSphere_;
     
-    Vector3 transform_;
-    Vector3 contactTransform_;
-    Vector3 platformTransform_;
-    Vector3 currentTransform_;
+    /// Cached rigid body of the character.
+    WeakPtr<RigidBody> body_;
+    /// Platform node the character is riding.
     SharedPtr<Node> otherBody_;
+    /// Index of the ridden platform in the platform system.
+    unsigned platformIndex_;
+    /// Platform velocity added to the character velocity on the last physics step.
+    Vector3 platformVelocity_;
+    /// Character friction before boarding, restored when leaving the platform.
+    float savedFriction_;
+    /// Platform system of the scene, used to recognize platform nodes.
+    WeakPtr<PlatformSystem> platformSystem_;
+    /// Input latency tracer, told when a physics step applies the controls.
+    WeakPtr<InputLatencyTracer> latencyTracer_;
+    /// Sequence number of the traced input the last physics step applied.
+    unsigned appliedInputSequence_;
+    /// Input recorder, which records or replays the controls of each physics step.
+    WeakPtr<InputRecorder> inputRecorder_;
+    /// Ridden platform node ID attribute waiting to be resolved.
+    unsigned platformNodeID_;
+    /// Ridden platform node ID needs resolving flag.
+    bool platformNodeDirty_;
+    /// Contact index of the scene, used for platform detection.
+    WeakPtr<PhysicsContacts> contacts_;
+    /// Ground probe service of the scene, used for ground detection.
+    WeakPtr<GroundProbeSystem> groundProbes_;
     
 };
@@ -22,80 +22,456 @@
 
 #include <Urho3D/Core/CoreEvents.h>
 #include <Urho3D/Core/ProcessUtils.h>
+#include <Urho3D/Core/StringUtils.h>
+#include <Urho3D/Core/Timer.h>
+#include <Urho3D/Core/WorkQueue.h>
 #include <Urho3D/Engine/Engine.h>
+#include <Urho3D/Engine/EngineEvents.h>
 #include <Urho3D/Graphics/AnimatedModel.h>
 #include <Urho3D/Graphics/AnimationController.h>
 #include <Urho3D/Graphics/Camera.h>
+#include <Urho3D/Graphics/Graphics.h>
 #include <Urho3D/Graphics/Light.h>
 #include <Urho3D/Graphics/Material.h>
+#include <Urho3D/Graphics/Model.h>
 #include <Urho3D/Graphics/Octree.h>
 #include <Urho3D/Graphics/Renderer.h>
+#include <Urho3D/Graphics/Texture2D.h>
 #include <Urho3D/Graphics/Zone.h>
 #include <Urho3D/Input/Controls.h>
 #include <Urho3D/Input/Input.h>
+#include <Urho3D/IO/File.h>
 #include <Urho3D/IO/FileSystem.h>
+#include <Urho3D/IO/Log.h>
 #include <Urho3D/Physics/CollisionShape.h>
 #include <Urho3D/Physics/PhysicsWorld.h>
 #include <Urho3D/Physics/RigidBody.h>
+#include <Urho3D/Resource/Image.h>
 #include <Urho3D/Resource/ResourceCache.h>
+#include <Urho3D/Resource/XMLFile.h>
 #include <Urho3D/Scene/Scene.h>
 #include <Urho3D/UI/Font.h>
 #include <Urho3D/UI/Text.h>
 #include <Urho3D/UI/UI.h>
 
+#include "Benchmark.h"
+#include "CameraOcclusion.h"
 #include "Character.h"
 #include "CharacterDemo.h"
+#include "CharacterSystem.h"
+#include "GridBroadphase.h"
+#include "GroundProbeSystem.h"
+#include "InputLatencyTracer.h"
+#include "InputRecorder.h"
+#include "LoopbackTransport.h"
+#include "PhysicsBroadphase.h"
+#include "PhysicsContacts.h"
+#include "PhysicsDebugDraw.h"
+#include "PlatformGroup.h"
+#include "PlatformRenderer.h"
+#include "PlatformSystem.h"
+#include "ReplicationClient.h"
+#include "ReplicationServer.h"
+#include "ResourcePreloader.h"
+#include "SceneSnapshot.h"
+#include "TraceCapture.h"
 
 #include <Urho3D/DebugNew.h>
 #include <Urho3D/Graphics/DebugRenderer.h>
 
-#include "Platform.h"
-
 DEFINE_APPLICATION_MAIN(CharacterDemo)
 
 CharacterDemo::CharacterDemo(Context* context) :
-    Sample(context)
+    Sample(context),
+    kernelBenchmark_(false),
+    threadBenchmarkPlatforms_(0),
+    snapshotBenchmarkPlatforms_(0),
+    broadphaseBenchmarkPlatforms_(0),
+    replicationBenchmarkPlatforms_(0),
+    benchmarkFrames_(0),
+    benchmarkWarmupFrames_(60),
+    benchmarkTimeStep_(1.0f / 60.0f),
+    sceneConstructionTime_(0.0f),
+    numBots_(0),
+    physicsDebugRadius_(DEFAULT_PHYSICS_DEBUG_RADIUS),
+    traceOnStart_(false),
+    traceOutput_("Trace.json"),
+    saveSnapshotFile_("Snapshot.bin"),
+    physicsFps_(60),
+    broadphaseType_(BROADPHASE_DBVT),
+    broadphaseCellSize_(DEFAULT_GRID_CELL_SIZE),
+    replicationClients_(0),
+    replicationLatency_(0.05f),
+    firstFrameTime_(-1.0f)
 {
     // Register factory and attributes for the Character component so it can be created via CreateComponent, and loaded / saved
     Character::RegisterObject(context);
-    context->RegisterFactory<Platform>();
+    PlatformSystem::RegisterObject(context);
+    CharacterSystem::RegisterObject(context);
+    PhysicsContacts::RegisterObject(context);
+    PhysicsBroadphase::RegisterObject(context);
+    PlatformRenderer::RegisterObject(context);
+    PlatformGroup::RegisterObject(context);
+    GroundProbeSystem::RegisterObject(context);
+    PhysicsDebugDraw::RegisterObject(context);
 }
 
 CharacterDemo::~CharacterDemo()
 {
 }
 
+void CharacterDemo::Setup()
+{
+    // Execute base class setup
+    Sample::Setup();
+
+    ParseOptions(GetArguments());
+
+    // A replay runs with the options it was recorded with. Options given now are applied on top, for example to benchmark it
+    if (!replayFile_.Empty())
+    {
+        InputRecorder* inputRecorder = new InputRecorder(context_);
+        context_->RegisterSubsystem(inputRecorder);
+        if (inputRecorder->StartReplay(replayFile_))
+        {
+            inputRecorder->SetExitOnFinish(true);
+            ParseOptions(inputRecorder->GetOptions());
+            ParseOptions(GetArguments());
+        }
+        else
+            context_->RemoveSubsystem<InputRecorder>();
+    }
+
+    // Benchmarks need no window, renderer or sound, so that they can run unattended on any machine
+    if (kernelBenchmark_ || threadBenchmarkPlatforms_ || snapshotBenchmarkPlatforms_ || broadphaseBenchmarkPlatforms_ ||
+        replicationBenchmarkPlatforms_ || benchmarkFrames_)
+    {
+        engineParameters_["Headless"] = true;
+        engineParameters_["Sound"] = false;
+    }
+}
+
+void CharacterDemo::ParseOptions(const Vector<String>& arguments)
+{
+    for (unsigned i = 0; i < arguments.Size(); ++i)
+    {
+        String argument = arguments[i].ToLower();
+        // Value of an option, if the next argument is not another option
+        String value = i + 1 < arguments.Size() && !arguments[i + 1].StartsWith("-") ? arguments[i + 1] : String::EMPTY;
+
+        if (argument == "-kernelbench")
+            kernelBenchmark_ = true;
+        else if (argument == "-threadbench")
+            threadBenchmarkPlatforms_ = value.Empty() ? 65536 : Max(ToUInt(value), 1U);
+        else if (argument == "-snapshotbench")
+            snapshotBenchmarkPlatforms_ = value.Empty() ? 10000 : Max(ToUInt(value), 1U);
+        else if (argument == "-broadphasebench")
+            broadphaseBenchmarkPlatforms_ = value.Empty() ? 10000 : Max(ToUInt(value), 1U);
+        else if (argument == "-broadphase" && !value.Empty())
+            broadphaseType_ = (BroadphaseType)GetStringListIndex(value.CString(), broadphaseTypeNames, BROADPHASE_DBVT);
+        else if (argument == "-broadphasecell" && !value.Empty())
+            broadphaseCellSize_ = Max(ToFloat(value), M_EPSILON);
+        else if (argument == "-replicationbench")
+            replicationBenchmarkPlatforms_ = value.Empty() ? 10000 : Max(ToUInt(value), 1U);
+        else if (argument == "-replicate")
+            replicationClients_ = value.Empty() ? 1 : ToUInt(value);
+        else if (argument == "-replicationlatency" && !value.Empty())
+            replicationLatency_ = Max(ToFloat(value), 0.0f) / 1000.0f;
+        else if (argument == "-loadsnapshot" && !value.Empty())
+            loadSnapshotFile_ = value;
+        else if (argument == "-savesnapshot" && !value.Empty())
+            saveSnapshotFile_ = value;
+        else if (argument == "-benchmark")
+            benchmarkFrames_ = value.Empty() ? 1000 : Max(ToUInt(value), 1U);
+        else if (argument == "-benchwarmup" && !value.Empty())
+            benchmarkWarmupFrames_ = ToUInt(value);
+        else if (argument == "-benchtimestep" && !value.Empty())
+            benchmarkTimeStep_ = Max(ToFloat(value), M_EPSILON);
+        else if (argument == "-benchoutput")
+            benchmarkOutput_ = value;
+        else if (argument == "-bots")
+            numBots_ = ToUInt(value);
+        else if (argument == "-trace")
+        {
+            traceOnStart_ = true;
+            if (!value.Empty())
+                traceOutput_ = value;
+        }
+        else if (argument == "-record" && !value.Empty())
+            recordFile_ = value;
+        else if (argument == "-replay" && !value.Empty())
+            replayFile_ = value;
+        else if (argument == "-debugradius" && !value.Empty())
+            physicsDebugRadius_ = ToFloat(value);
+        else if (argument == "-physicsfps" && !value.Empty())
+            physicsFps_ = Max(ToInt(value), 1);
+        else if (argument.StartsWith("-"))
+            platformLayout_.SetOption(argument.Substring(1), value);
+    }
+}
+
+Vector<String> CharacterDemo::GetRecordedOptions() const
+{
+    const Vector<String>& arguments = GetArguments();
+    Vector<String> options;
+    for (unsigned i = 0; i < arguments.Size(); ++i)
+    {
+        String argument = arguments[i].ToLower();
+        if (argument == "-record" || argument == "-replay")
+        {
+            if (i + 1 < arguments.Size() && !arguments[i + 1].StartsWith("-"))
+                ++i;
+        }
+        else
+            options.Push(arguments[i]);
+    }
+
+    return options;
+}
+
 void CharacterDemo::Start()
+{
+    // Timeline capture of the hot paths, dumped as Chrome trace JSON with the T key, the "trace dump" console command or at exit
+    TraceCapture* traceCapture = new TraceCapture(context_);
+    traceCapture->SetOutputFile(traceOutput_);
+    context_->RegisterSubsystem(traceCapture);
+    if (traceOnStart_)
+        traceCapture->Start();
+
+    if (kernelBenchmark_)
+    {
+        RunKernelBenchmark();
+        engine_->Exit();
+        return;
+    }
+    if (threadBenchmarkPlatforms_)
+    {
+        RunThreadBenchmark();
+        engine_->Exit();
+        return;
+    }
+    if (snapshotBenchmarkPlatforms_)
+    {
+        RunSnapshotBenchmark();
+        engine_->Exit();
+        return;
+    }
+    if (broadphaseBenchmarkPlatforms_)
+    {
+        RunBroadphaseBenchmark();
+        engine_->Exit();
+        return;
+    }
+    if (replicationBenchmarkPlatforms_)
+    {
+        RunReplicationBenchmark();
+        engine_->Exit();
+        return;
+    }
+
+    // Latency from control changes to the physics step and the camera, shown in the debug HUD and the benchmark results
+    context_->RegisterSubsystem(new InputLatencyTracer(context_));
+    context_->RegisterSubsystem(new CameraOcclusion(context_));
+
+    // Load the resources of the UI and the scene in the background while frames keep running, and build everything that
+    // uses them only once they are all resident
+    startupTimer_.Reset();
+    preloader_ = new ResourcePreloader(context_);
+    if (!engine_->IsHeadless())
+    {
+        preloader_->AddResource<Texture2D>("Textures/LogoLarge.png");
+        preloader_->AddResource<Image>("Textures/UrhoIcon.png");
+        preloader_->AddResource<XMLFile>("UI/DefaultStyle.xml");
+    }
+    preloader_->AddResource<Model>("Models/Box.mdl");
+    preloader_->AddResource<Model>("Models/Sphere.mdl");
+    preloader_->AddResource<Material>("Materials/Stone.xml");
+    preloader_->AddResource<Material>("Materials/Jack.xml");
+    preloader_->AddResource<Material>("Materials/Editor/RedUnlit.xml");
+    SubscribeToEvent(preloader_, E_PRELOADPROGRESS, HANDLER(CharacterDemo, HandlePreloadProgress));
+    SubscribeToEvent(preloader_, E_PRELOADFINISHED, HANDLER(CharacterDemo, HandlePreloadFinished));
+    preloader_->Start();
+}
+
+void CharacterDemo::StartDemo()
 {
     // Execute base class startup
     Sample::Start();
 
+    // The recorded controls, the random seed and the fixed timestep together reproduce a session exactly
+    InputRecorder* inputRecorder = GetSubsystem<InputRecorder>();
+    if (!inputRecorder && !recordFile_.Empty())
+    {
+        inputRecorder = new InputRecorder(context_);
+        context_->RegisterSubsystem(inputRecorder);
+    }
+    unsigned seed = inputRecorder && inputRecorder->IsReplaying() ? inputRecorder->GetSeed() : GetRandomSeed();
+    if (inputRecorder)
+        SetRandomSeed(seed);
+    // Replication clients recreate the platforms from the layout, so the layout must draw from a known seed
+    if (replicationClients_ && !platformLayout_.seed_)
+        platformLayout_.seed_ = Max(seed, 1U);
+
     // Create static scene content
     CreateScene();
     // Create the controllable character
     CreateCharacter();
+    // Create bot characters for load testing
+    CreateBots();
+
+    // Restore the platforms and the character state from a snapshot instead of generating the platforms
+    if (!loadSnapshotFile_.Empty())
+    {
+        SharedPtr<SceneSnapshot> snapshot(new SceneSnapshot(context_));
+        if (snapshot->Load(scene_, loadSnapshotFile_))
+            sceneConstructionTime_ += snapshot->GetLastLoadTime();
+    }
+
+    if (inputRecorder)
+    {
+        PhysicsWorld* physicsWorld = scene_->GetComponent<PhysicsWorld>();
+        if (inputRecorder->IsReplaying())
+            physicsWorld->SetFps(inputRecorder->GetPhysicsFps());
+        else
+        {
+            inputRecorder->StartRecording(recordFile_, seed, benchmarkTimeStep_, physicsWorld->GetFps(),
+                GetRecordedOptions());
+        }
+        inputRecorder->SetTarget(character_->GetNode());
+    }
+
+    if (replicationClients_)
+        StartReplication();
 
     // Subscribe to necessary events
     SubscribeToEvents();
+    // Record the physics steps of the scene in the trace capture
+    GetSubsystem<TraceCapture>()->SetScene(scene_);
+
+    if (benchmarkFrames_)
+    {
+        benchmark_ = new Benchmark(context_);
+        benchmark_->SetOutputFile(benchmarkOutput_);
+        benchmark_->AddResult("platforms", (float)platformLayout_.count_);
+        benchmark_->AddResult("sceneConstructionMs", sceneConstructionTime_);
+        benchmark_->AddResult("preloadMs", preloader_->GetElapsedTime());
+        benchmark_->AddResult("bots", (float)numBots_);
+        benchmark_->AddResult("physicsFps", (float)scene_->GetComponent<PhysicsWorld>()->GetFps());
+        benchmark_->Start(scene_, benchmarkFrames_, benchmarkWarmupFrames_, benchmarkTimeStep_);
+    }
+}
+
+void CharacterDemo::StartReplication()
+{
+    // Platforms restored from a snapshot need not match the layout, which is all the clients get
+    if (!loadSnapshotFile_.Empty())
+    {
+        LOGWARNING("Replication is not available when loading a snapshot");
+        return;
+    }
+
+    // Server and clients run in this process and talk over a loopback transport with a simulated latency
+    SharedPtr<LoopbackTransport> transport(new LoopbackTransport(context_));
+    transport->SetLatency(replicationLatency_);
+    replicationServer_ = new ReplicationServer(context_);
+    if (!replicationServer_->Start(scene_, platformLayout_, transport))
+    {
+        replicationServer_.Reset();
+        return;
+    }
+
+    replicationServer_->AddCharacter(character_->GetNode());
+    CharacterSystem* characterSystem = scene_->GetComponent<CharacterSystem>();
+    if (characterSystem)
+    {
+        for (unsigned i = 0; i < characterSystem->GetNumCharacters(); ++i)
+            replicationServer_->AddCharacter(characterSystem->GetCharacterNode(i));
+    }
+    for (unsigned i = 0; i < replicationClients_; ++i)
+        replicationServer_->AddLoopbackClient();
+}
+
+void CharacterDemo::HandlePreloadProgress(StringHash eventType, VariantMap& eventData)
+{
+    using namespace PreloadProgress;
+
+    // The window title is the only thing on screen before the UI style is loaded
+    Graphics* graphics = GetSubsystem<Graphics>();
+    if (graphics)
+        graphics->SetWindowTitle("Loading " + String((int)(eventData[P_PROGRESS].GetFloat() * 100.0f)) + "%");
+}
+
+void CharacterDemo::HandlePreloadFinished(StringHash eventType, VariantMap& eventData)
+{
+    UnsubscribeFromEvent(preloader_, E_PRELOADPROGRESS);
+    UnsubscribeFromEvent(preloader_, E_PRELOADFINISHED);
+    StartDemo();
+}
+
+void CharacterDemo::Stop()
+{
+    InputRecorder* inputRecorder = GetSubsystem<InputRecorder>();
+    if (inputRecorder && inputRecorder->GetMode() == INPUT_RECORDER_RECORDING)
+        inputRecorder->Finish();
+
+    TraceCapture* traceCapture = GetSubsystem<TraceCapture>();
+    if (traceCapture && traceCapture->IsCapturing())
+    {
+        traceCapture->Stop();
+        traceCapture->Dump(traceCapture->GetOutputFile());
+    }
+
+    Sample::Stop();
 }
 
 void CharacterDemo::CreateScene()
 {
+    HiresTimer timer;
+
     ResourceCache* cache = GetSubsystem<ResourceCache>();
 
     scene_ = new Scene(context_);
 
     // Create scene subsystem components
     scene_->CreateComponent<Octree>();
-    scene_->CreateComponent<PhysicsWorld>();
+    // Platforms and characters move on the physics steps and are drawn interpolated between them, so the rate can be low
+    PhysicsWorld* physicsWorld = scene_->CreateComponent<PhysicsWorld>();
+    physicsWorld->SetFps(physicsFps_);
+    // Selects the broadphase algorithm and counts its work per physics step, for comparing the platform body modes and
+    // the algorithms. Set up before any body exists, so that no body has to be moved over to the selected broadphase.
+    // The axis sweep bounds cover the platforms at the far ends of their travel and the floor
+    PhysicsBroadphase* physicsBroadphase = scene_->CreateComponent<PhysicsBroadphase>();
+    BoundingBox worldBounds = platformLayout_.GetBounds(PLATFORM_TRAVEL_MARGIN);
+    worldBounds.Merge(BoundingBox(Vector3(-100.0f, -1.0f, -100.0f), Vector3(100.0f, 0.0f, 100.0f)));
+    physicsBroadphase->SetWorldBounds(worldBounds);
+    physicsBroadphase->SetCellSize(broadphaseCellSize_);
+    physicsBroadphase->SetType(broadphaseType_);
+    // Contact queries of the characters read the physics world's contact manifolds through this index
+    scene_->CreateComponent<PhysicsContacts>();
+    // Ground detection of all characters runs as one batch of downward probes after each physics step
+    scene_->CreateComponent<GroundProbeSystem>();
     scene_->CreateComponent<DebugRenderer>();
+    // Physics debug geometry is limited to the bodies around the character and in view, and cached while they stay put
+    PhysicsDebugDraw* physicsDebugDraw = scene_->CreateComponent<PhysicsDebugDraw>();
+    physicsDebugDraw->SetRadius(physicsDebugRadius_);
+    // All moving platforms are advanced together by the platform system instead of one logic component each
+    PlatformSystem* platformSystem = scene_->CreateComponent<PlatformSystem>();
 
     // Create camera and define viewport. We will be doing load / save, so it's convenient to create the camera outside the scene,
     // so that it won't be destroyed and recreated, and we don't have to redefine the viewport on load
     cameraNode_ = new Node(context_);
     Camera* camera = cameraNode_->CreateComponent<Camera>();
     camera->SetFarClip(300.0f);
-    GetSubsystem<Renderer>()->SetViewport(0, new Viewport(context_, scene_, camera));
+    Renderer* renderer = GetSubsystem<Renderer>();
+    if (renderer)
+        renderer->SetViewport(0, new Viewport(context_, scene_, camera));
+    physicsDebugDraw->SetCamera(camera);
+
+    // Platforms far from both the camera and the character update at reduced rate or not at all
+    platformSystem->AddObserver(cameraNode_);
+    platformSystem->SetLodDistances(platformLayout_.lodDistances_.x_, platformLayout_.lodDistances_.y_);
+    platformSystem->SetReducedInterval(platformLayout_.lodInterval_);
+    platformSystem->SetLodHysteresis(platformLayout_.lodHysteresis_);
 
     // Create static scene content. First create a zone for ambient lighting and fog control
     Node* zoneNode = scene_->CreateChild("Zone");
@@ -128,42 +504,366 @@ void CharacterDemo::CreateScene()
     // Use collision layer bit 2 to mark world scenery. This is what we will raycast against to prevent camera from going
     // inside geometry
     body->SetCollisionLayer(2);
+    // Collisions are delivered to the collision listeners, so the scenery generates no collision events
+    body->SetCollisionEventMode(COLLISION_NEVER);
     CollisionShape* shape = floorNode->CreateComponent<CollisionShape>();
     shape->SetBox(Vector3::ONE);
 
-    // Create Platforms of varying sizes
-    const unsigned NUM_PLATFORMS = 60;
-    for (unsigned i = 0; i < NUM_PLATFORMS; ++i)
-    {
-        Node* objectNode = scene_->CreateChild("Platform");
-        objectNode->SetPosition(Vector3(Random(-10.0f,10.0f), 0.0f, i*4.0f));
-        //objectNode->SetRotation(Quaternion(0.0f, Random(360.0f), 0.0f));
-        //objectNode->SetScale(2.0f + Random(5.0f));
-        objectNode->SetScale(Vector3(40,1,3));
-        StaticModel* object = objectNode->CreateComponent<StaticModel>();
-        object->SetModel(cache->GetResource<Model>("Models/box.mdl"));
-        object->SetMaterial(cache->GetResource<Material>("Materials/Jack.xml"));
-        object->SetCastShadows(true);
+    // Create platforms of varying sizes as described by the platform layout, or restore them from a snapshot. Either
+    // way they are stamped out in bulk from a platform prototype
+    if (loadSnapshotFile_.Empty())
+        platformLayout_.CreatePlatforms(scene_, platformSystem);
 
-        RigidBody* body = objectNode->CreateComponent<RigidBody>();
-        body->SetCollisionLayer(2);
-        CollisionShape* shape = objectNode->CreateComponent<CollisionShape>();
-        shape->SetBox(Vector3::ONE);
-        
-        body->SetFriction(1.0f);
-        
-        objectNode->CreateComponent<Platform>();
-        
-        objectNode->GetComponent<Platform>()->SetId(i);
-        
-        if(i%2)
+    // The platforms are drawn by instanced drawables per area filled from the platform system, instead of a model per node
+    Node* platformsNode = scene_->CreateChild("Platforms");
+    PlatformRenderer* platformRenderer = platformsNode->CreateComponent<PlatformRenderer>();
+    platformRenderer->SetModel(cache->GetResource<Model>("Models/Box.mdl"));
+    platformRenderer->SetMaterial(cache->GetResource<Material>("Materials/Jack.xml"));
+    platformRenderer->SetCastShadows(true);
+    platformRenderer->SetPlatformSystem(platformSystem);
+
+    sceneConstructionTime_ = timer.GetUSec(false) / 1000.0f;
+    LOGINFOF("Created scene with %u platforms in %.2f ms", platformSystem->GetNumPlatforms(), sceneConstructionTime_);
+}
+
+void CharacterDemo::RunKernelBenchmark()
+{
+    // Sizes from the demo scene up to the stress scenes; keep the total work per size roughly constant
+    const unsigned counts[] = { 64, 1024, 16384, 131072 };
+    const unsigned numCounts = sizeof(counts) / sizeof(counts[0]);
+
+    String json = "{\"kernel\":\"" + String(GetPlatformKernelName()) + "\",\"width\":" + String(GetPlatformKernelWidth()) +
+        ",\"maxErrorBound\":" + String(PLATFORM_KERNEL_MAX_ERROR) + ",\"results\":[";
+    for (unsigned i = 0; i < numCounts; ++i)
+    {
+        PlatformKernelBenchmark result = BenchmarkPlatformKernel(counts[i], 16777216 / counts[i]);
+        if (i)
+            json += ",";
+        json += "{\"platforms\":" + String(result.count_) + ",\"iterations\":" + String(result.iterations_) +
+            ",\"kernelPlatformsPerSec\":" + String((float)result.kernelPlatformsPerSecond_) +
+            ",\"referencePlatformsPerSec\":" + String((float)result.referencePlatformsPerSecond_) +
+            ",\"maxError\":" + String(result.maxError_) + "}";
+    }
+    json += "]}";
+
+    PrintLine(json);
+}
+
+void CharacterDemo::RunThreadBenchmark()
+{
+    const unsigned iterations = 100;
+    const float timeStep = 1.0f / 60.0f;
+    const double checkTime = 1000.0;
+
+    // A bare scene with only the platform system and the platform nodes, so that the platform update is measured alone
+    SharedPtr<Scene> scene(new Scene(context_));
+    PlatformSystem* platformSystem = scene->CreateComponent<PlatformSystem>();
+    platformSystem->SetMinParallelPlatforms(1);
+    for (unsigned i = 0; i < threadBenchmarkPlatforms_; ++i)
+    {
+        Node* node = scene->CreateChild("Platform", LOCAL);
+        node->SetPosition(platformLayout_.GetGridPosition(i));
+        platformSystem->AddPlatform(node, i);
+    }
+
+    // Single-threaded reference positions for the identity check
+    platformSystem->SetMaxThreads(1);
+    platformSystem->SetTime(checkTime);
+    PODVector<Vector3> reference(threadBenchmarkPlatforms_);
+    for (unsigned i = 0; i < threadBenchmarkPlatforms_; ++i)
+        reference[i] = platformSystem->GetPlatformPosition(i);
+
+    WorkQueue* queue = GetSubsystem<WorkQueue>();
+    unsigned maxThreads = (queue ? queue->GetNumThreads() : 0) + 1;
+    float singleEvaluateTime = 0.0f;
+
+    String json = "{\"platforms\":" + String(threadBenchmarkPlatforms_) + ",\"iterations\":" + String(iterations) +
+        ",\"results\":[";
+    for (unsigned threads = 1; threads <= maxThreads; ++threads)
+    {
+        platformSystem->SetMaxThreads(threads);
+        platformSystem->SetTime(0.0);
+
+        float evaluateTime = 0.0f;
+        HiresTimer timer;
+        for (unsigned i = 0; i < iterations; ++i)
         {
-            body->SetKinematic(true);
+            platformSystem->Update(timeStep);
+            evaluateTime += platformSystem->GetLastEvaluateTime();
         }
-        
+        float updateTime = timer.GetUSec(false) / 1000.0f / iterations;
+        evaluateTime /= iterations;
+        if (threads == 1)
+            singleEvaluateTime = evaluateTime;
+
+        platformSystem->SetTime(checkTime);
+        bool identical = true;
+        for (unsigned i = 0; i < threadBenchmarkPlatforms_ && identical; ++i)
+            identical = platformSystem->GetPlatformPosition(i) == reference[i];
+
+        if (threads > 1)
+            json += ",";
+        json += "{\"threads\":" + String(threads) + ",\"updateMs\":" + String(updateTime) + ",\"evaluateMs\":" +
+            String(evaluateTime) + ",\"evaluateSpeedup\":" + String(evaluateTime > 0.0f ? singleEvaluateTime / evaluateTime :
+            0.0f) + ",\"identical\":" + String(identical) + "}";
+    }
+    json += "]}";
+
+    PrintLine(json);
+}
+
+void CharacterDemo::RunSnapshotBenchmark()
+{
+    const double snapshotTime = 12.5;
+
+    FileSystem* fileSystem = GetSubsystem<FileSystem>();
+    String snapshotFile = fileSystem->GetProgramDir() + "SnapshotBenchmark.bin";
+    String binaryFile = fileSystem->GetProgramDir() + "SnapshotBenchmark.scn";
+    String xmlFile = fileSystem->GetProgramDir() + "SnapshotBenchmark.xml";
+
+    PlatformLayout layout = platformLayout_;
+    layout.count_ = snapshotBenchmarkPlatforms_;
+
+    // Procedural generation, as done at startup without a snapshot
+    SharedPtr<Scene> scene(new Scene(context_));
+    scene->CreateComponent<PhysicsWorld>();
+    PlatformSystem* platformSystem = scene->CreateComponent<PlatformSystem>();
+    HiresTimer timer;
+    layout.CreatePlatforms(scene, platformSystem);
+    platformSystem->SetTime(snapshotTime);
+    float generateTime = timer.GetUSec(false) / 1000.0f;
+
+    SharedPtr<SceneSnapshot> snapshot(new SceneSnapshot(context_));
+    snapshot->Save(scene, snapshotFile);
+
+    // The engine's own binary and XML scene files for comparison
+    float binarySaveTime, xmlSaveTime;
+    unsigned binarySize, xmlSize;
+    {
+        File file(context_, binaryFile, FILE_WRITE);
+        timer.Reset();
+        scene->Save(file);
+        binarySaveTime = timer.GetUSec(false) / 1000.0f;
+        binarySize = file.GetSize();
+    }
+    {
+        File file(context_, xmlFile, FILE_WRITE);
+        timer.Reset();
+        scene->SaveXML(file);
+        xmlSaveTime = timer.GetUSec(false) / 1000.0f;
+        xmlSize = file.GetSize();
+    }
+
+    SharedPtr<Scene> snapshotScene(new Scene(context_));
+    snapshotScene->CreateComponent<PhysicsWorld>();
+    snapshot->Load(snapshotScene, snapshotFile);
+
+    SharedPtr<Scene> binaryScene(new Scene(context_));
+    float binaryLoadTime;
+    {
+        File file(context_, binaryFile);
+        timer.Reset();
+        binaryScene->Load(file);
+        binaryLoadTime = timer.GetUSec(false) / 1000.0f;
+    }
+
+    SharedPtr<Scene> xmlScene(new Scene(context_));
+    float xmlLoadTime;
+    {
+        File file(context_, xmlFile);
+        timer.Reset();
+        xmlScene->LoadXML(file);
+        xmlLoadTime = timer.GetUSec(false) / 1000.0f;
+    }
+
+    // The snapshot must restore the platforms exactly
+    PlatformSystem* loadedSystem = snapshotScene->GetComponent<PlatformSystem>();
+    bool identical = loadedSystem->GetNumPlatforms() == platformSystem->GetNumPlatforms() &&
+        loadedSystem->GetTime() == platformSystem->GetTime();
+    for (unsigned i = 0; i < platformSystem->GetNumPlatforms() && identical; ++i)
+    {
+        identical = loadedSystem->GetPlatformBasePosition(i) == platformSystem->GetPlatformBasePosition(i) &&
+            loadedSystem->GetPlatformAxis(i) == platformSystem->GetPlatformAxis(i) &&
+            loadedSystem->GetPlatformNode(i)->GetScale() == platformSystem->GetPlatformNode(i)->GetScale();
+    }
+
+    fileSystem->Delete(snapshotFile);
+    fileSystem->Delete(binaryFile);
+    fileSystem->Delete(xmlFile);
+
+    String json = "{\"platforms\":" + String(snapshotBenchmarkPlatforms_) + ",\"generateMs\":" + String(generateTime) +
+        ",\"snapshot\":{\"bytes\":" + String(snapshot->GetLastFileSize()) + ",\"saveMs\":" +
+        String(snapshot->GetLastSaveTime()) + ",\"loadMs\":" + String(snapshot->GetLastLoadTime()) + "}" +
+        ",\"binaryScene\":{\"bytes\":" + String(binarySize) + ",\"saveMs\":" + String(binarySaveTime) + ",\"loadMs\":" +
+        String(binaryLoadTime) + "}" + ",\"xmlScene\":{\"bytes\":" + String(xmlSize) + ",\"saveMs\":" +
+        String(xmlSaveTime) + ",\"loadMs\":" + String(xmlLoadTime) + "},\"identical\":" + String(identical) + "}";
+
+    PrintLine(json);
+}
+
+void CharacterDemo::RunBroadphaseBenchmark()
+{
+    const unsigned warmupSteps = 60;
+    const unsigned steps = 300;
+    const float timeStep = 1.0f / 60.0f;
+    // One dynamic box dropped onto every this many platforms, so that there are pairs to find
+    const unsigned platformsPerBox = 8;
+
+    // The configured layout as a single long row and as a square field of the same number of platforms, with the same
+    // random layout for every broadphase
+    const char* layoutNames[] = { "row", "field" };
+    const unsigned numLayouts = sizeof(layoutNames) / sizeof(layoutNames[0]);
+    PlatformLayout layouts[numLayouts] = { platformLayout_, platformLayout_ };
+    for (unsigned i = 0; i < numLayouts; ++i)
+    {
+        layouts[i].count_ = broadphaseBenchmarkPlatforms_;
+        if (!layouts[i].seed_)
+            layouts[i].seed_ = 1;
     }
+    layouts[0].columns_ = 1;
+    layouts[1].columns_ = Max((unsigned)sqrtf((float)broadphaseBenchmarkPlatforms_), 1U);
 
+    String json = "{\"platforms\":" + String(broadphaseBenchmarkPlatforms_) + ",\"boxes\":" +
+        String(broadphaseBenchmarkPlatforms_ / platformsPerBox) + ",\"steps\":" + String(steps) + ",\"cellSize\":" +
+        String(broadphaseCellSize_) + ",\"results\":[";
+    for (unsigned i = 0; i < numLayouts; ++i)
+    {
+        const PlatformLayout& layout = layouts[i];
+        for (unsigned type = BROADPHASE_DBVT; type <= BROADPHASE_GRID; ++type)
+        {
+            SharedPtr<Scene> scene(new Scene(context_));
+            PhysicsWorld* physicsWorld = scene->CreateComponent<PhysicsWorld>();
+            physicsWorld->SetFps((int)(1.0f / timeStep + 0.5f));
+            PhysicsBroadphase* broadphase = scene->CreateComponent<PhysicsBroadphase>();
+            broadphase->SetWorldBounds(layout.GetBounds(PLATFORM_TRAVEL_MARGIN));
+            broadphase->SetCellSize(broadphaseCellSize_);
+            broadphase->SetType((BroadphaseType)type);
+            PlatformSystem* platformSystem = scene->CreateComponent<PlatformSystem>();
+
+            HiresTimer timer;
+            layout.CreatePlatforms(scene, platformSystem);
+            for (unsigned j = 0; j < layout.count_; j += platformsPerBox)
+            {
+                Node* boxNode = scene->CreateChild("Box", LOCAL);
+                boxNode->SetPosition(platformSystem->GetPlatformPosition(j) + Vector3(0.0f, 2.0f, 0.0f));
+                RigidBody* body = boxNode->CreateComponent<RigidBody>();
+                body->SetCollisionLayer(1);
+                body->SetMass(1.0f);
+                body->SetCollisionEventMode(COLLISION_NEVER);
+                CollisionShape* shape = boxNode->CreateComponent<CollisionShape>();
+                shape->SetBox(Vector3::ONE);
+            }
+            float createTime = timer.GetUSec(false) / 1000.0f;
+
+            for (unsigned j = 0; j < warmupSteps; ++j)
+                physicsWorld->Update(timeStep);
+
+            BroadphaseCounters start = broadphase->GetCounters();
+            timer.Reset();
+            for (unsigned j = 0; j < steps; ++j)
+                physicsWorld->Update(timeStep);
+            float stepTime = timer.GetUSec(false) / 1000.0f;
+            const BroadphaseCounters& end = broadphase->GetCounters();
+
+            float numSteps = (float)Max(end.steps_ - start.steps_, 1ULL);
+            unsigned long long moves = (end.staticMoves_ + end.kinematicMoves_ + end.dynamicMoves_) - (start.staticMoves_ +
+                start.kinematicMoves_ + start.dynamicMoves_);
+
+            if (i || type)
+                json += ",";
+            json += "{\"layout\":\"" + String(layoutNames[i]) + "\",\"broadphase\":\"" + String(broadphaseTypeNames[type]) +
+                "\",\"createMs\":" + String(createTime) + ",\"stepMs\":" + String(stepTime / numSteps) + ",\"updateMs\":" +
+                String((end.updateUSec_ - start.updateUSec_) / numSteps / 1000.0f) + ",\"pairMs\":" +
+                String((end.pairUSec_ - start.pairUSec_) / numSteps / 1000.0f) + ",\"movesPerStep\":" +
+                String(moves / numSteps) + ",\"pairsPerStep\":" + String((end.pairs_ - start.pairs_) / numSteps) +
+                ",\"candidatePairsPerStep\":" + String((end.candidatePairs_ - start.candidatePairs_) / numSteps);
+            // Only the grid counts its own bounding box tests
+            if (type == BROADPHASE_GRID)
+                json += ",\"aabbTestsPerStep\":" + String((end.overlapTests_ - start.overlapTests_) / numSteps);
+            json += "}";
+        }
+    }
+    json += "]}";
 
+    PrintLine(json);
+}
+
+void CharacterDemo::RunReplicationBenchmark()
+{
+    const unsigned frames = 600;
+    const float timeStep = 1.0f / 60.0f;
+    const unsigned numCharacters = 16;
+    // What sending every platform transform instead would cost per state: a 3-byte node ID and a position per platform
+    const unsigned naivePlatformBytes = 15;
+
+    String json = "{\"characters\":" + String(numCharacters) + ",\"frames\":" + String(frames) + ",\"latencyMs\":" +
+        String(replicationLatency_ * 1000.0f) + ",\"results\":[";
+    for (unsigned count = Min(100U, replicationBenchmarkPlatforms_);; count = Min(count * 10, replicationBenchmarkPlatforms_))
+    {
+        PlatformLayout layout = platformLayout_;
+        layout.count_ = count;
+        // Every server platform follows the clock at full rate, so that all of them can be compared with the client
+        layout.lodDistances_ = Vector2::ZERO;
+        if (!layout.seed_)
+            layout.seed_ = 1;
+
+        SharedPtr<Scene> scene(new Scene(context_));
+        scene->CreateComponent<PhysicsWorld>();
+        PlatformSystem* platformSystem = scene->CreateComponent<PlatformSystem>();
+        layout.CreatePlatforms(scene, platformSystem);
+        PODVector<Node*> characters;
+        for (unsigned i = 0; i < numCharacters; ++i)
+            characters.Push(scene->CreateChild("Character", LOCAL));
+
+        SharedPtr<LoopbackTransport> transport(new LoopbackTransport(context_));
+        transport->SetLatency(replicationLatency_);
+        SharedPtr<ReplicationServer> server(new ReplicationServer(context_));
+        server->Start(scene, layout, transport);
+        for (unsigned i = 0; i < numCharacters; ++i)
+            server->AddCharacter(characters[i]);
+        ReplicationClient* client = server->AddLoopbackClient();
+
+        for (unsigned frame = 0; frame < frames; ++frame)
+        {
+            // The characters walk in circles above the first platforms
+            float angle = frame * timeStep * 90.0f;
+            for (unsigned i = 0; i < numCharacters; ++i)
+            {
+                float heading = angle + i * 360.0f / numCharacters;
+                characters[i]->SetPosition(platformSystem->GetPlatformPosition(i % count) + Vector3(Cos(heading) * 5.0f, 2.0f,
+                    Sin(heading) * 5.0f));
+                characters[i]->SetRotation(Quaternion(heading, Vector3::UP));
+            }
+            scene->Update(timeStep);
+        }
+
+        double elapsed = transport->GetTime();
+        const TransportCounters& counters = transport->GetCounters(client->GetEndpoint());
+        PlatformSystem* clientSystem = client->GetPlatformSystem();
+        bool platformsMatch = clientSystem && clientSystem->GetNumPlatforms() == platformSystem->GetNumPlatforms();
+        float maxError = 0.0f;
+        for (unsigned i = 0; platformsMatch && i < platformSystem->GetNumPlatforms(); ++i)
+        {
+            maxError = Max(maxError, (clientSystem->GetPlatformPosition(i) - platformSystem->GetPlatformPosition(i,
+                clientSystem->GetTime())).Length());
+        }
+
+        if (count != Min(100U, replicationBenchmarkPlatforms_))
+            json += ",";
+        json += "{\"platforms\":" + String(count) + ",\"bytesPerSecDown\":" + String((float)(counters.bytesReceived_ /
+            elapsed)) + ",\"bytesPerSecUp\":" + String((float)(counters.bytesSent_ / elapsed)) + ",\"naiveBytesPerSec\":" +
+            String((float)count * naivePlatformBytes * server->GetSendRate()) + ",\"serverMs\":" +
+            String((float)server->GetUpdateUSec() / Max(server->GetNumUpdates(), 1U) / 1000.0f) + ",\"clientMs\":" +
+            String((float)client->GetUpdateUSec() / frames / 1000.0f) + ",\"clockErrorMs\":" +
+            String((float)(client->GetTime() - platformSystem->GetTime()) * 1000.0f) + ",\"maxPlatformError\":" +
+            String(maxError) + ",\"platformsMatch\":" + String(platformsMatch) + "}";
+
+        if (count >= replicationBenchmarkPlatforms_)
+            break;
+    }
+    json += "]}";
+
+    PrintLine(json);
 }
 
 void CharacterDemo::CreateCharacter()
@@ -176,7 +876,7 @@ void CharacterDemo::CreateCharacter()
 
     // Create the rendering component + animation controller
     StaticModel* object = objectNode->CreateComponent<StaticModel>();
-    object->SetModel(cache->GetResource<Model>("Models/box.mdl"));
+    object->SetModel(cache->GetResource<Model>("Models/Box.mdl"));
     //object->SetModel(cache->GetResource<Model>("Models/Jack.mdl"));
     object->SetMaterial(cache->GetResource<Material>("Materials/Jack.xml"));
     object->SetCastShadows(true);
@@ -195,8 +895,9 @@ void CharacterDemo::CreateCharacter()
     // Instead we will control the character yaw manually
     body->SetAngularFactor(Vector3::ZERO);
 
-    // Set the rigidbody to signal collision also when in rest, so that we get ground collisions properly
-    body->SetCollisionEventMode(COLLISION_ALWAYS);
+    // Ground is found by the ground probes and the platforms are boarded through a collision listener, so no collision
+    // events are needed
+    body->SetCollisionEventMode(COLLISION_NEVER);
 
     // Set a capsule shape for collision
     CollisionShape* shape = objectNode->CreateComponent<CollisionShape>();
@@ -207,16 +908,64 @@ void CharacterDemo::CreateCharacter()
     // Remember it so that we can set the controls. Use a WeakPtr because the scene hierarchy already owns it
     // and keeps it alive as long as it's not removed from the hierarchy
     character_ = objectNode->CreateComponent<Character>();
+
+    scene_->GetComponent<PlatformSystem>()->AddObserver(objectNode);
+    scene_->GetComponent<PhysicsDebugDraw>()->SetFocusNode(objectNode);
 }
 
 
 
+void CharacterDemo::CreateBots()
+{
+    if (!numBots_)
+        return;
+
+    ResourceCache* cache = GetSubsystem<ResourceCache>();
+    Model* model = cache->GetResource<Model>("Models/Box.mdl");
+    Material* material = cache->GetResource<Material>("Materials/Jack.xml");
+
+    // All bots are driven together by the character system, each with its own control script
+    CharacterSystem* characterSystem = scene_->CreateComponent<CharacterSystem>();
+    unsigned numPlatforms = Max(platformLayout_.count_, 1U);
+
+    for (unsigned i = 0; i < numBots_; ++i)
+    {
+        // Drop the bots onto the platforms, spreading them over the platform grid
+        Node* botNode = scene_->CreateChild("Bot");
+        botNode->SetPosition(platformLayout_.GetGridPosition(i % numPlatforms) + Vector3(Random(-10.0f, 10.0f), 2.0f +
+            (float)(i / numPlatforms) * 2.5f, 0.0f));
+        botNode->SetScale(Vector3(1.0f, 2.0f, 1.0f));
+
+        StaticModel* object = botNode->CreateComponent<StaticModel>();
+        object->SetModel(model);
+        object->SetMaterial(material);
+        object->SetCastShadows(true);
+
+        RigidBody* body = botNode->CreateComponent<RigidBody>();
+        body->SetCollisionLayer(1);
+        body->SetMass(1.0f);
+        body->SetFriction(1.0f);
+        body->SetAngularFactor(Vector3::ZERO);
+        // The character system reads the ground contacts from the contact index, so no collision events are needed
+        body->SetCollisionEventMode(COLLISION_NEVER);
+
+        CollisionShape* shape = botNode->CreateComponent<CollisionShape>();
+        shape->SetBox(object->GetBoundingBox().Size());
+
+        characterSystem->AddCharacter(botNode, i + 1);
+    }
+
+    LOGINFOF("Created %u bot characters", numBots_);
+}
+
 void CharacterDemo::SubscribeToEvents()
 {
     
     SubscribeToEvent(E_POSTRENDERUPDATE, HANDLER(CharacterDemo, HandlePostRenderUpdate));
     // Subscribe to Update event for setting the character controls before physics simulation
     SubscribeToEvent(E_UPDATE, HANDLER(CharacterDemo, HandleUpdate));
+    // Subscribe to console commands for changing the physics rate at runtime
+    SubscribeToEvent(E_CONSOLECOMMAND, HANDLER(CharacterDemo, HandleConsoleCommand));
 
     // Subscribe to PostUpdate event for updating the camera position after physics simulation
     SubscribeToEvent(E_POSTUPDATE, HANDLER(CharacterDemo, HandlePostUpdate));
@@ -227,13 +976,84 @@ void CharacterDemo::SubscribeToEvents()
     UnsubscribeFromEvent(E_SCENEUPDATE);
 }
 
+void CharacterDemo::HandleConsoleCommand(StringHash eventType, VariantMap& eventData)
+{
+    using namespace ConsoleCommand;
+
+    Vector<String> arguments = eventData[P_COMMAND].GetString().Split(' ');
+    if (arguments.Empty() || arguments[0].ToLower() != "physicsfps")
+        return;
+
+    PhysicsWorld* physicsWorld = scene_->GetComponent<PhysicsWorld>();
+    if (arguments.Size() > 1)
+    {
+        // A replay only reproduces the session at its recorded rate
+        InputRecorder* inputRecorder = GetSubsystem<InputRecorder>();
+        if (inputRecorder && inputRecorder->GetMode() != INPUT_RECORDER_IDLE)
+        {
+            LOGWARNING("The physics rate can not be changed while recording or replaying input");
+            return;
+        }
+        physicsWorld->SetFps(Max(ToInt(arguments[1]), 1));
+    }
+    LOGINFOF("Physics rate %d Hz", physicsWorld->GetFps());
+}
+
 void CharacterDemo::HandleUpdate(StringHash eventType, VariantMap& eventData)
 {
     using namespace Update;
 
     Input* input = GetSubsystem<Input>();
 
-    if (character_)
+    // The first update with the scene in place is the first frame that responds to input
+    if (firstFrameTime_ < 0.0f)
+    {
+        firstFrameTime_ = startupTimer_.GetUSec(false) / 1000.0f;
+        LOGINFOF("First interactive frame %.2f ms after start", firstFrameTime_);
+        if (benchmark_)
+            benchmark_->AddResult("firstFrameMs", firstFrameTime_);
+    }
+
+    // Cycle the physics debug geometry between off, filtered and the whole world
+    if (input->GetKeyPress('P') && !GetSubsystem<UI>()->GetFocusElement())
+        scene_->GetComponent<PhysicsDebugDraw>()->CycleMode();
+
+    // Save and load the scene snapshot
+    if (input->GetKeyPress(KEY_F5) && !GetSubsystem<UI>()->GetFocusElement())
+    {
+        SharedPtr<SceneSnapshot> snapshot(new SceneSnapshot(context_));
+        snapshot->Save(scene_, saveSnapshotFile_);
+    }
+    if (input->GetKeyPress(KEY_F7) && !GetSubsystem<UI>()->GetFocusElement())
+    {
+        SharedPtr<SceneSnapshot> snapshot(new SceneSnapshot(context_));
+        snapshot->Load(scene_, saveSnapshotFile_);
+    }
+
+    // Start the trace capture, or stop it and write it out
+    if (input->GetKeyPress('T') && !GetSubsystem<UI>()->GetFocusElement())
+    {
+        TraceCapture* traceCapture = GetSubsystem<TraceCapture>();
+        if (traceCapture->IsCapturing())
+        {
+            traceCapture->Stop();
+            traceCapture->Dump(traceCapture->GetOutputFile());
+        }
+        else
+            traceCapture->Start();
+    }
+
+    // Replayed controls are applied by the character itself on each physics step
+    InputRecorder* inputRecorder = GetSubsystem<InputRecorder>();
+    bool replaying = inputRecorder && inputRecorder->IsReplaying();
+
+    if (character_ && !replaying && benchmark_ && benchmark_->IsRunning())
+    {
+        // Benchmark runs are driven by scripted controls instead of the keyboard and mouse
+        controlScript_.Evaluate(benchmark_->GetElapsedTime(), character_->controls_);
+        character_->GetNode()->SetRotation(Quaternion(character_->controls_.yaw_, Vector3::UP));
+    }
+    else if (character_ && !replaying)
     {
         // Clear previous controls
         character_->controls_.Set(CTRL_FORWARD | CTRL_BACK | CTRL_LEFT | CTRL_RIGHT | CTRL_JUMP, false);
@@ -265,10 +1085,15 @@ void CharacterDemo::HandleUpdate(StringHash eventType, VariantMap& eventData)
         // Set rotation already here so that it's updated every rendering frame instead of every physics frame
         character_->GetNode()->SetRotation(Quaternion(character_->controls_.yaw_, Vector3::UP));
     }
+
+    if (character_)
+        GetSubsystem<InputLatencyTracer>()->SampleControls(character_->controls_.buttons_);
 }
 
 void CharacterDemo::HandlePostUpdate(StringHash eventType, VariantMap& eventData)
 {
+    using namespace PostUpdate;
+
     if (!character_)
         return;
 
@@ -284,16 +1109,28 @@ void CharacterDemo::HandlePostUpdate(StringHash eventType, VariantMap& eventData
 
     // Collide camera ray with static physics objects (layer bitmask 2) to ensure we see the character properly
     Vector3 rayDir = dir * Vector3::BACK;
+    // The query reuses its last result while neither the aim nor the nearby platforms moved noticeably
+    float rayDistance = GetSubsystem<CameraOcclusion>()->Update(scene_->GetComponent<PhysicsWorld>(), aimPoint, rayDir,
+        CAMERA_DISTANCE, 2, eventData[P_TIMESTEP].GetFloat());
+    rayDistance = Max(rayDistance, CAMERA_MIN_DISTANCE);
 
-    cameraNode_->SetPosition(aimPoint + rayDir * 10);
-    cameraNode_->SetRotation(dir);
+    // Only a move that follows the character ends an input trace, and only once the character state includes the input;
+    // the occlusion easing in and out moves the camera on its own
+    if (aimPoint != cameraAimPoint_ || dir != cameraNode_->GetRotation())
+        GetSubsystem<InputLatencyTracer>()->MarkCameraMoved(character_->GetAppliedInputSequence());
+    cameraAimPoint_ = aimPoint;
 
+    Vector3 cameraPosition = aimPoint + rayDir * rayDistance;
+
+    cameraNode_->SetPosition(cameraPosition);
+    cameraNode_->SetRotation(dir);
 }
 
 void CharacterDemo::HandlePostRenderUpdate(StringHash eventType, VariantMap& eventData)
 {
+    // Nothing is rendered when running headless
+    if (engine_->IsHeadless())
+        return;
 
-    scene_->GetComponent<PhysicsWorld>()->DrawDebugGeometry(true);
-    
-    
+    scene_->GetComponent<PhysicsDebugDraw>()->Draw(scene_->GetComponent<DebugRenderer>(), true);
 }
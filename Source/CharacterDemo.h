@@ -22,6 +22,11 @@
 
 #pragma once
 
+#include <Urho3D/Core/Timer.h>
+
+#include "ControlScript.h"
+#include "PhysicsBroadphase.h"
+#include "PlatformLayout.h"
 #include "Sample.h"
 
 namespace Urho3D
@@ -32,7 +37,10 @@ class Scene;
 
 }
 
+class Benchmark;
 class Character;
+class ReplicationServer;
+class ResourcePreloader;
 class Touch;
 
 /// Moving character example.
@@ -53,16 +61,34 @@ public:
     /// Destruct.
     ~CharacterDemo();
 
-    /// Setup after engine initialization and before running the main loop.
+    /// Setup before engine initialization. Selects headless mode for benchmarks.
+    virtual void Setup();
+    /// Setup after engine initialization and before running the main loop. Starts preloading the resources; the scene is
+    /// created once they are resident.
     virtual void Start();
+    /// Cleanup after the main loop. Writes out the trace capture if one is running.
+    virtual void Stop();
 
 private:
+    /// Create the UI, the scene and the characters, and start the benchmark or the input recording if requested. Called
+    /// when the resource preload finishes.
+    void StartDemo();
+    /// Handle resource preload progress.
+    void HandlePreloadProgress(StringHash eventType, VariantMap& eventData);
+    /// Handle resource preload finishing.
+    void HandlePreloadFinished(StringHash eventType, VariantMap& eventData);
+    /// Start replicating the scene to loopback clients.
+    void StartReplication();
     /// Create static scene content.
     void CreateScene();
     /// Create controllable character.
     void CreateCharacter();
+    /// Create script-driven bot characters.
+    void CreateBots();
     /// Subscribe to necessary events.
     void SubscribeToEvents();
+    /// Handle a console command. Sets the physics rate with "physicsfps [rate]".
+    void HandleConsoleCommand(StringHash eventType, VariantMap& eventData);
     /// Handle application update. Set controls to character.
     void HandleUpdate(StringHash eventType, VariantMap& eventData);
     /// Handle application post-update. Update camera position after character has moved.
@@ -70,6 +96,83 @@ private:
     
     void HandlePostRenderUpdate(StringHash eventType, VariantMap& eventData);
 
+    /// Parse command line options of the demo.
+    void ParseOptions(const Vector<String>& arguments);
+    /// Return the command line options to store in an input recording, without the recording and replay options.
+    Vector<String> GetRecordedOptions() const;
+    /// Run the platform kernel microbenchmark and print the results.
+    void RunKernelBenchmark();
+    /// Run the platform update thread scaling benchmark and print the results.
+    void RunThreadBenchmark();
+    /// Run the scene snapshot save and load benchmark and print the results.
+    void RunSnapshotBenchmark();
+    /// Run the broadphase comparison benchmark on the generated platform layouts and print the results.
+    void RunBroadphaseBenchmark();
+    /// Run the replication bandwidth benchmark over growing platform counts and print the results.
+    void RunReplicationBenchmark();
+
     /// The controllable character component.
     WeakPtr<Character> character_;
+    /// Platform kernel microbenchmark flag, set from the -kernelbench command line option.
+    bool kernelBenchmark_;
+    /// Number of platforms in the thread scaling benchmark, set from the -threadbench command line option. Zero when not running it.
+    unsigned threadBenchmarkPlatforms_;
+    /// Number of platforms in the snapshot benchmark, set from the -snapshotbench command line option. Zero when not running it.
+    unsigned snapshotBenchmarkPlatforms_;
+    /// Number of platforms in the broadphase benchmark, set from the -broadphasebench command line option. Zero when not running it.
+    unsigned broadphaseBenchmarkPlatforms_;
+    /// Largest number of platforms in the replication benchmark, set from the -replicationbench command line option. Zero when not running it.
+    unsigned replicationBenchmarkPlatforms_;
+    /// Number of frames to record in benchmark mode, set from the -benchmark command line option. Zero when not benchmarking.
+    unsigned benchmarkFrames_;
+    /// Number of frames to simulate before recording in benchmark mode.
+    unsigned benchmarkWarmupFrames_;
+    /// Fixed timestep in benchmark mode.
+    float benchmarkTimeStep_;
+    /// File to write benchmark results to.
+    String benchmarkOutput_;
+    /// Benchmark driver.
+    SharedPtr<Benchmark> benchmark_;
+    /// Scripted controls used in benchmark mode.
+    ControlScript controlScript_;
+    /// Layout of the generated platforms, set from the -platforms and related command line options.
+    PlatformLayout platformLayout_;
+    /// Time taken by the last CreateScene() in milliseconds.
+    float sceneConstructionTime_;
+    /// Number of bot characters, set from the -bots command line option.
+    unsigned numBots_;
+    /// Radius around the character within which physics debug geometry is drawn, set from the -debugradius command line option.
+    float physicsDebugRadius_;
+    /// Start the trace capture at startup, set from the -trace command line option.
+    bool traceOnStart_;
+    /// File to write the trace capture to, set from the -trace command line option.
+    String traceOutput_;
+    /// File to record the input to, set from the -record command line option.
+    String recordFile_;
+    /// File to replay the input from, set from the -replay command line option.
+    String replayFile_;
+    /// Scene snapshot to create the platforms from at startup, set from the -loadsnapshot command line option.
+    String loadSnapshotFile_;
+    /// Scene snapshot file written with F5 and read with F7, set from the -savesnapshot command line option.
+    String saveSnapshotFile_;
+    /// Physics steps per second, set from the -physicsfps command line option.
+    int physicsFps_;
+    /// Broadphase algorithm, set from the -broadphase command line option.
+    BroadphaseType broadphaseType_;
+    /// Grid broadphase cell size, set from the -broadphasecell command line option.
+    float broadphaseCellSize_;
+    /// Number of loopback replication clients, set from the -replicate command line option.
+    unsigned replicationClients_;
+    /// One-way latency of the replication transport in seconds, set from the -replicationlatency command line option in milliseconds.
+    float replicationLatency_;
+    /// Replication server when replicating.
+    SharedPtr<ReplicationServer> replicationServer_;
+    /// Background loader of the startup resources.
+    SharedPtr<ResourcePreloader> preloader_;
+    /// Camera aim point on the last frame, to tell camera moves that follow the character from those of the occlusion.
+    Vector3 cameraAimPoint_;
+    /// Timer from the start of the application.
+    HiresTimer startupTimer_;
+    /// Time from the start to the first interactive frame in milliseconds. Negative until it has happened.
+    float firstFrameTime_;
 };
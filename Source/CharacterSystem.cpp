@@ -0,0 +1,281 @@
+//
+// Copyright (c) 2008-2015 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#include <Urho3D/Core/Context.h>
+#include <Urho3D/Core/Timer.h>
+#include <Urho3D/Physics/PhysicsEvents.h>
+#include <Urho3D/Physics/PhysicsWorld.h>
+#include <Urho3D/Physics/RigidBody.h>
+#include <Urho3D/Scene/Node.h>
+#include <Urho3D/Scene/Scene.h>
+#include <Urho3D/Scene/SceneEvents.h>
+
+#include "Character.h"
+#include "CharacterSystem.h"
+#include "GroundProbeSystem.h"
+#include "TraceCapture.h"
+
+#include <Urho3D/DebugNew.h>
+
+CharacterSystem::CharacterSystem(Context* context) :
+    Component(context),
+    time_(0.0f),
+    numGrounded_(0),
+    lastUpdateTime_(0.0f)
+{
+}
+
+CharacterSystem::~CharacterSystem()
+{
+}
+
+void CharacterSystem::RegisterObject(Context* context)
+{
+    context->RegisterFactory<CharacterSystem>();
+}
+
+unsigned CharacterSystem::AddCharacter(Node* node, unsigned scriptSeed)
+{
+    if (!node)
+        return M_MAX_UNSIGNED;
+
+    unsigned existing = GetCharacterIndex(node);
+    if (existing != M_MAX_UNSIGNED)
+        return existing;
+
+    RigidBody* body = node->GetComponent<RigidBody>();
+    if (!body)
+        return M_MAX_UNSIGNED;
+
+    unsigned index = nodes_.Size();
+
+    buttons_.Push(0);
+    yaws_.Push(0.0f);
+    inAirTimers_.Push(0.0f);
+    flags_.Push(CHARACTER_OK_TO_JUMP);
+    bodies_.Push(body);
+    nodes_.Push(node);
+    scripts_.Push(ControlScript(scriptSeed));
+    probeIndices_.Push(groundProbes_ ? groundProbes_->AddProbe(node) : M_MAX_UNSIGNED);
+    nodeIndices_[node->GetID()] = index;
+
+    return index;
+}
+
+void CharacterSystem::RemoveCharacter(Node* node)
+{
+    unsigned index = GetCharacterIndex(node);
+    if (index != M_MAX_UNSIGNED)
+        RemoveCharacterAt(index);
+}
+
+void CharacterSystem::RemoveAllCharacters()
+{
+    buttons_.Clear();
+    yaws_.Clear();
+    inAirTimers_.Clear();
+    flags_.Clear();
+    bodies_.Clear();
+    nodes_.Clear();
+    scripts_.Clear();
+    probeIndices_.Clear();
+    nodeIndices_.Clear();
+}
+
+void CharacterSystem::Update(float timeStep)
+{
+    TRACE_ZONE("CharacterSystem::Update");
+
+    HiresTimer timer;
+
+    time_ += timeStep;
+
+    unsigned count = nodes_.Size();
+    unsigned* buttons = buttons_.Buffer();
+    float* yaws = yaws_.Buffer();
+    float* inAirTimers = inAirTimers_.Buffer();
+    unsigned char* flags = flags_.Buffer();
+    RigidBody** bodies = bodies_.Buffer();
+    Node** nodes = nodes_.Buffer();
+    const ControlScript* scripts = scripts_.Buffer();
+    unsigned* probeIndices = probeIndices_.Buffer();
+    GroundProbeSystem* groundProbes = groundProbes_;
+
+    // Evaluate the scripted controls first, so that the movement pass only touches the hot state and the bodies
+    Controls controls;
+    for (unsigned i = 0; i < count; ++i)
+    {
+        scripts[i].Evaluate(time_, controls);
+        buttons[i] = controls.buttons_;
+        if (controls.yaw_ != yaws[i])
+        {
+            yaws[i] = controls.yaw_;
+            nodes[i]->SetRotation(Quaternion(yaws[i], Vector3::UP));
+        }
+    }
+
+    unsigned numGrounded = 0;
+
+    for (unsigned i = 0; i < count; ++i)
+    {
+        RigidBody* body = bodies[i];
+        unsigned down = buttons[i];
+        unsigned char state = flags[i] & ~CHARACTER_GROUNDED;
+        if (groundProbes)
+        {
+            // The probe index is kept from registration; only when removing other probes has moved this one is it
+            // looked up again
+            unsigned probe = probeIndices[i];
+            if (groundProbes->GetProbeNode(probe) != nodes[i])
+                probe = probeIndices[i] = groundProbes->GetProbeIndex(nodes[i]);
+            if (probe != M_MAX_UNSIGNED && groundProbes->GetResult(probe).grounded_)
+                state |= CHARACTER_GROUNDED;
+        }
+
+        // Update the in air timer. Reset if grounded
+        if (state & CHARACTER_GROUNDED)
+        {
+            inAirTimers[i] = 0.0f;
+            ++numGrounded;
+        }
+        else
+            inAirTimers[i] += timeStep;
+        // When character has been in air less than 1/10 second, it's still interpreted as being on ground
+        bool softGrounded = inAirTimers[i] < INAIR_THRESHOLD_TIME;
+
+        Vector3 moveDir = Vector3::ZERO;
+        if (down & CTRL_FORWARD)
+            moveDir += Vector3::FORWARD;
+        if (down & CTRL_BACK)
+            moveDir += Vector3::BACK;
+        if (down & CTRL_LEFT)
+            moveDir += Vector3::LEFT;
+        if (down & CTRL_RIGHT)
+            moveDir += Vector3::RIGHT;
+
+        // Normalize move vector so that diagonal strafing is not faster
+        if (moveDir.LengthSquared() > 0.0f)
+            moveDir.Normalize();
+
+        // Combine all impulses of the step into one call. If in air, allow control, but slower than when on ground
+        Vector3 impulse = Quaternion(yaws[i], Vector3::UP) * moveDir * (softGrounded ? MOVE_FORCE : INAIR_MOVE_FORCE);
+
+        if (softGrounded)
+        {
+            // When on ground, apply a braking force to limit maximum ground velocity
+            Vector3 velocity = body->GetLinearVelocity();
+            impulse -= Vector3(velocity.x_, 0.0f, velocity.z_) * BRAKE_FORCE;
+
+            // Jump. Must release jump control inbetween jumps
+            if (down & CTRL_JUMP)
+            {
+                if (state & CHARACTER_OK_TO_JUMP)
+                {
+                    impulse += Vector3::UP * JUMP_FORCE;
+                    state &= ~CHARACTER_OK_TO_JUMP;
+                }
+            }
+            else
+                state |= CHARACTER_OK_TO_JUMP;
+        }
+
+        if (impulse != Vector3::ZERO)
+            body->ApplyImpulse(impulse);
+
+        flags[i] = state;
+    }
+
+    numGrounded_ = numGrounded;
+    lastUpdateTime_ = timer.GetUSec(false) / 1000.0f;
+}
+
+unsigned CharacterSystem::GetCharacterIndex(Node* node) const
+{
+    if (!node)
+        return M_MAX_UNSIGNED;
+
+    HashMap<unsigned, unsigned>::ConstIterator i = nodeIndices_.Find(node->GetID());
+    return i != nodeIndices_.End() ? i->second_ : M_MAX_UNSIGNED;
+}
+
+void CharacterSystem::OnNodeSet(Node* node)
+{
+    if (node)
+    {
+        PhysicsWorld* physicsWorld = node->GetComponent<PhysicsWorld>();
+        if (physicsWorld)
+            SubscribeToEvent(physicsWorld, E_PHYSICSPRESTEP, HANDLER(CharacterSystem, HandlePhysicsPreStep));
+        groundProbes_ = node->GetComponent<GroundProbeSystem>();
+        SubscribeToEvent(node, E_NODEREMOVED, HANDLER(CharacterSystem, HandleNodeRemoved));
+    }
+    else
+    {
+        UnsubscribeFromAllEvents();
+        RemoveAllCharacters();
+        groundProbes_.Reset();
+    }
+}
+
+void CharacterSystem::HandlePhysicsPreStep(StringHash eventType, VariantMap& eventData)
+{
+    using namespace PhysicsPreStep;
+
+    if (IsEnabledEffective())
+        Update(eventData[P_TIMESTEP].GetFloat());
+}
+
+void CharacterSystem::HandleNodeRemoved(StringHash eventType, VariantMap& eventData)
+{
+    using namespace NodeRemoved;
+
+    RemoveCharacter(static_cast<Node*>(eventData[P_NODE].GetPtr()));
+}
+
+void CharacterSystem::RemoveCharacterAt(unsigned index)
+{
+    unsigned last = nodes_.Size() - 1;
+    nodeIndices_.Erase(nodes_[index]->GetID());
+    if (groundProbes_)
+        groundProbes_->RemoveProbe(nodes_[index]);
+
+    if (index != last)
+    {
+        buttons_[index] = buttons_[last];
+        yaws_[index] = yaws_[last];
+        inAirTimers_[index] = inAirTimers_[last];
+        flags_[index] = flags_[last];
+        bodies_[index] = bodies_[last];
+        nodes_[index] = nodes_[last];
+        scripts_[index] = scripts_[last];
+        probeIndices_[index] = probeIndices_[last];
+        nodeIndices_[nodes_[index]->GetID()] = index;
+    }
+
+    buttons_.Resize(last);
+    yaws_.Resize(last);
+    inAirTimers_.Resize(last);
+    flags_.Resize(last);
+    bodies_.Resize(last);
+    nodes_.Resize(last);
+    scripts_.Resize(last);
+    probeIndices_.Resize(last);
+}
@@ -0,0 +1,120 @@
+//
+// Copyright (c) 2008-2015 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#pragma once
+
+#include <Urho3D/Container/HashMap.h>
+#include <Urho3D/Scene/Component.h>
+
+#include "ControlScript.h"
+
+namespace Urho3D
+{
+
+class RigidBody;
+
+}
+
+using namespace Urho3D;
+
+class GroundProbeSystem;
+
+/// Character state flag: standing on ground during the last physics step.
+static const unsigned char CHARACTER_GROUNDED = 1;
+/// Character state flag: jump control has been released since the last jump.
+static const unsigned char CHARACTER_OK_TO_JUMP = 2;
+
+/// Scene-level system that drives many bot characters in one pass per physics step. The hot movement state is stored as
+/// structure-of-arrays indexed by character index, and the controls come from a per-character ControlScript. Movement
+/// follows the same rules as the Character component.
+class CharacterSystem : public Component
+{
+    OBJECT(CharacterSystem);
+
+public:
+    /// Construct.
+    CharacterSystem(Context* context);
+    /// Destruct.
+    virtual ~CharacterSystem();
+
+    /// Register object factory.
+    static void RegisterObject(Context* context);
+
+    /// Register a bot character node. The node must already have a dynamic rigid body. Return the character index.
+    unsigned AddCharacter(Node* node, unsigned scriptSeed);
+    /// Unregister a bot character node.
+    void RemoveCharacter(Node* node);
+    /// Unregister all bot characters.
+    void RemoveAllCharacters();
+    /// Evaluate the scripted controls and run the movement logic for all characters.
+    void Update(float timeStep);
+
+    /// Return number of characters.
+    unsigned GetNumCharacters() const { return nodes_.Size(); }
+    /// Return character index of a node, or M_MAX_UNSIGNED if the node is not a registered character.
+    unsigned GetCharacterIndex(Node* node) const;
+    /// Return character node by index.
+    Node* GetCharacterNode(unsigned index) const { return index < nodes_.Size() ? nodes_[index] : 0; }
+    /// Return number of characters that were grounded on the last update.
+    unsigned GetNumGrounded() const { return numGrounded_; }
+    /// Return duration of the last update in milliseconds.
+    float GetLastUpdateTime() const { return lastUpdateTime_; }
+
+protected:
+    /// Handle node being assigned.
+    virtual void OnNodeSet(Node* node);
+
+private:
+    /// Handle physics pre-step event.
+    void HandlePhysicsPreStep(StringHash eventType, VariantMap& eventData);
+    /// Handle scene node removal, to drop characters whose nodes go away.
+    void HandleNodeRemoved(StringHash eventType, VariantMap& eventData);
+    /// Remove character by index by moving the last character into its slot.
+    void RemoveCharacterAt(unsigned index);
+
+    /// Control button bits.
+    PODVector<unsigned> buttons_;
+    /// Control yaw angles.
+    PODVector<float> yaws_;
+    /// In air timers.
+    PODVector<float> inAirTimers_;
+    /// State flags.
+    PODVector<unsigned char> flags_;
+    /// Rigid bodies. Owned by the scene.
+    PODVector<RigidBody*> bodies_;
+    /// Character scene nodes. Owned by the scene; removed from here when the node leaves the scene.
+    PODVector<Node*> nodes_;
+    /// Control scripts.
+    PODVector<ControlScript> scripts_;
+    /// Ground probe indices, as of registration or the last lookup.
+    PODVector<unsigned> probeIndices_;
+    /// Character index by node ID.
+    HashMap<unsigned, unsigned> nodeIndices_;
+    /// Ground probe service of the scene, used for ground detection.
+    WeakPtr<GroundProbeSystem> groundProbes_;
+    /// Script time.
+    float time_;
+    /// Number of characters grounded on the last update.
+    unsigned numGrounded_;
+    /// Duration of the last update in milliseconds.
+    float lastUpdateTime_;
+};
@@ -0,0 +1,82 @@
+//
+// Copyright (c) 2008-2015 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#include <Urho3D/Math/MathDefs.h>
+
+#include "Character.h"
+#include "ControlScript.h"
+
+#include <cmath>
+
+/// Length of one walk pattern cycle in seconds.
+static const float SCRIPT_CYCLE = 8.0f;
+/// How long the jump control is held for each jump.
+static const float JUMP_HOLD_TIME = 0.1f;
+
+/// Integer hash used to derive script parameters from the seed without touching the global random generator.
+static unsigned HashSeed(unsigned x)
+{
+    x ^= x >> 16;
+    x *= 0x7feb352dU;
+    x ^= x >> 15;
+    x *= 0x846ca68bU;
+    x ^= x >> 16;
+    return x;
+}
+
+ControlScript::ControlScript(unsigned seed)
+{
+    SetSeed(seed);
+}
+
+void ControlScript::SetSeed(unsigned seed)
+{
+    seed_ = seed;
+    unsigned hash = HashSeed(seed);
+    timeOffset_ = (float)(hash & 0xffff) / 65536.0f * SCRIPT_CYCLE;
+    turnRate_ = (float)((hash >> 16) & 0xff) / 255.0f * 60.0f - 30.0f;
+    jumpInterval_ = 1.0f + (float)((hash >> 24) & 0xff) / 255.0f * 2.0f;
+}
+
+void ControlScript::Evaluate(float time, Controls& controls) const
+{
+    float t = time + timeOffset_;
+    float cycleTime = std::fmod(t, SCRIPT_CYCLE);
+
+    controls.Set(CTRL_FORWARD | CTRL_BACK | CTRL_LEFT | CTRL_RIGHT | CTRL_JUMP, false);
+
+    // Walk forward, veer left then right, back up, then stand still for the rest of the cycle
+    if (cycleTime < 6.0f)
+        controls.Set(CTRL_FORWARD, true);
+    if (cycleTime >= 3.0f && cycleTime < 4.0f)
+        controls.Set(CTRL_LEFT, true);
+    if (cycleTime >= 4.0f && cycleTime < 6.0f)
+        controls.Set(CTRL_RIGHT, true);
+    if (cycleTime >= 6.0f && cycleTime < 7.0f)
+        controls.Set(CTRL_BACK, true);
+
+    // Jump periodically. The control is released between jumps, as the character requires
+    if (std::fmod(t, jumpInterval_) < JUMP_HOLD_TIME)
+        controls.Set(CTRL_JUMP, true);
+
+    controls.yaw_ = std::fmod(turnRate_ * t + 20.0f * std::sin(t * 0.5f), 360.0f);
+}
@@ -0,0 +1,54 @@
+//
+// Copyright (c) 2008-2015 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#pragma once
+
+#include <Urho3D/Input/Controls.h>
+
+using namespace Urho3D;
+
+/// Deterministic scripted input for unattended runs. Produces character controls as a pure function of the seed and
+/// the time since the script started, so that runs with the same seed and timestep always see the same input.
+class ControlScript
+{
+public:
+    /// Construct with a seed. Different seeds give differently phased walk, turn and jump patterns.
+    ControlScript(unsigned seed = 0);
+
+    /// Set the seed.
+    void SetSeed(unsigned seed);
+    /// Write the controls for the given script time. The yaw is set absolutely; pitch is left untouched.
+    void Evaluate(float time, Controls& controls) const;
+
+    /// Return the seed.
+    unsigned GetSeed() const { return seed_; }
+
+private:
+    /// Seed.
+    unsigned seed_;
+    /// Time offset derived from the seed.
+    float timeOffset_;
+    /// Turn rate in degrees per second derived from the seed.
+    float turnRate_;
+    /// Jump interval in seconds derived from the seed.
+    float jumpInterval_;
+};
@@ -0,0 +1,453 @@
+//
+// Copyright (c) 2008-2015 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#include <Urho3D/Math/MathDefs.h>
+
+#include <Bullet/BulletCollision/BroadphaseCollision/btOverlappingPairCache.h>
+#include <Bullet/LinearMath/btAabbUtil2.h>
+
+#include "GridBroadphase.h"
+
+#include <Urho3D/DebugNew.h>
+
+/// Proxies covering more cells than this are kept in the oversized list.
+static const unsigned MAX_PROXY_CELLS = 512;
+/// Queries covering more cells than this test every proxy instead.
+static const unsigned MAX_QUERY_CELLS = 4096;
+/// Cell coordinate limit, to fit the three coordinates in a 64-bit key.
+static const int MAX_CELL_COORD = (1 << 20) - 1;
+
+static unsigned long long MakeCellKey(int x, int y, int z)
+{
+    return ((unsigned long long)(x & 0x1fffff) << 42) | ((unsigned long long)(y & 0x1fffff) << 21) |
+        (unsigned long long)(z & 0x1fffff);
+}
+
+static int GetCellCoord(float value, float invCellSize)
+{
+    // Clamp in float space first so that huge or infinite bounds do not overflow the conversion
+    return (int)floorf(Clamp(value * invCellSize, (float)-MAX_CELL_COORD, (float)MAX_CELL_COORD));
+}
+
+static bool ProxiesOverlap(const btBroadphaseProxy* a, const btBroadphaseProxy* b)
+{
+    return TestAabbAgainstAabb2(a->m_aabbMin, a->m_aabbMax, b->m_aabbMin, b->m_aabbMax);
+}
+
+GridBroadphase::GridBroadphase(float cellSize) :
+    pairCache_(new btHashedOverlappingPairCache()),
+    cellSize_(Max(cellSize, M_EPSILON)),
+    invCellSize_(1.0f / cellSize_),
+    nextProxyId_(1),
+    queryStamp_(0),
+    numOverlapTests_(0)
+{
+}
+
+GridBroadphase::~GridBroadphase()
+{
+    for (unsigned i = 0; i < proxies_.Size(); ++i)
+        delete proxies_[i];
+    delete pairCache_;
+}
+
+btBroadphaseProxy* GridBroadphase::createProxy(const btVector3& aabbMin, const btVector3& aabbMax, int shapeType, void* userPtr,
+    short int collisionFilterGroup, short int collisionFilterMask, btDispatcher* dispatcher, void* multiSapProxy)
+{
+    GridBroadphaseProxy* proxy = new GridBroadphaseProxy(aabbMin, aabbMax, userPtr, collisionFilterGroup, collisionFilterMask);
+    proxy->m_uniqueId = nextProxyId_++;
+    proxy->index_ = proxies_.Size();
+    proxies_.Push(proxy);
+
+    InsertIntoCells(proxy);
+    MarkMoved(proxy);
+    return proxy;
+}
+
+void GridBroadphase::destroyProxy(btBroadphaseProxy* proxy, btDispatcher* dispatcher)
+{
+    GridBroadphaseProxy* gridProxy = static_cast<GridBroadphaseProxy*>(proxy);
+    pairCache_->removeOverlappingPairsContainingProxy(gridProxy, dispatcher);
+    RemoveFromCells(gridProxy);
+    if (gridProxy->moved_)
+        moved_.Remove(gridProxy);
+
+    // Swap the last proxy into the freed slot
+    GridBroadphaseProxy* last = proxies_.Back();
+    proxies_[gridProxy->index_] = last;
+    last->index_ = gridProxy->index_;
+    proxies_.Pop();
+
+    delete gridProxy;
+}
+
+void GridBroadphase::setAabb(btBroadphaseProxy* proxy, const btVector3& aabbMin, const btVector3& aabbMax,
+    btDispatcher* dispatcher)
+{
+    GridBroadphaseProxy* gridProxy = static_cast<GridBroadphaseProxy*>(proxy);
+    if (gridProxy->m_aabbMin == aabbMin && gridProxy->m_aabbMax == aabbMax)
+        return;
+
+    int cellMin[3], cellMax[3];
+    GetCellRange(aabbMin, aabbMax, cellMin, cellMax);
+    bool cellsChanged = false;
+    for (unsigned i = 0; i < 3; ++i)
+    {
+        if (cellMin[i] != gridProxy->cellMin_[i] || cellMax[i] != gridProxy->cellMax_[i])
+            cellsChanged = true;
+    }
+
+    if (cellsChanged)
+        RemoveFromCells(gridProxy);
+    gridProxy->m_aabbMin = aabbMin;
+    gridProxy->m_aabbMax = aabbMax;
+    if (cellsChanged)
+        InsertIntoCells(gridProxy);
+
+    MarkMoved(gridProxy);
+}
+
+void GridBroadphase::getAabb(btBroadphaseProxy* proxy, btVector3& aabbMin, btVector3& aabbMax) const
+{
+    aabbMin = proxy->m_aabbMin;
+    aabbMax = proxy->m_aabbMax;
+}
+
+void GridBroadphase::rayTest(const btVector3& rayFrom, const btVector3& rayTo, btBroadphaseRayCallback& rayCallback,
+    const btVector3& aabbMin, const btVector3& aabbMax)
+{
+    ++queryStamp_;
+
+    // Swept boxes visit every cell of the swept bounds
+    if (!aabbMin.isZero() || !aabbMax.isZero())
+    {
+        btVector3 sweepMin = rayFrom;
+        btVector3 sweepMax = rayFrom;
+        sweepMin.setMin(rayTo);
+        sweepMax.setMax(rayTo);
+        sweepMin += aabbMin;
+        sweepMax += aabbMax;
+
+        int cellMin[3], cellMax[3];
+        if (GetCellRange(sweepMin, sweepMax, cellMin, cellMax) > MAX_QUERY_CELLS)
+        {
+            for (unsigned i = 0; i < proxies_.Size(); ++i)
+                rayCallback.process(proxies_[i]);
+            return;
+        }
+
+        for (unsigned i = 0; i < oversized_.Size(); ++i)
+            rayCallback.process(oversized_[i]);
+        for (int x = cellMin[0]; x <= cellMax[0]; ++x)
+        {
+            for (int y = cellMin[1]; y <= cellMax[1]; ++y)
+            {
+                for (int z = cellMin[2]; z <= cellMax[2]; ++z)
+                {
+                    HashMap<unsigned long long, PODVector<GridBroadphaseProxy*> >::ConstIterator cell =
+                        cells_.Find(MakeCellKey(x, y, z));
+                    if (cell == cells_.End())
+                        continue;
+                    for (unsigned i = 0; i < cell->second_.Size(); ++i)
+                    {
+                        GridBroadphaseProxy* proxy = cell->second_[i];
+                        if (proxy->queryStamp_ == queryStamp_)
+                            continue;
+                        proxy->queryStamp_ = queryStamp_;
+                        rayCallback.process(proxy);
+                    }
+                }
+            }
+        }
+        return;
+    }
+
+    // Rays walk the cells they cross
+    int cell[3], endCell[3], step[3];
+    float tMax[3], tDelta[3];
+    unsigned numCells = 1;
+    btVector3 direction = rayTo - rayFrom;
+    for (unsigned i = 0; i < 3; ++i)
+    {
+        cell[i] = GetCellCoord(rayFrom[i], invCellSize_);
+        endCell[i] = GetCellCoord(rayTo[i], invCellSize_);
+        numCells += (unsigned)(endCell[i] > cell[i] ? endCell[i] - cell[i] : cell[i] - endCell[i]);
+        if (direction[i] > 0.0f)
+        {
+            step[i] = 1;
+            tMax[i] = ((cell[i] + 1) * cellSize_ - rayFrom[i]) / direction[i];
+            tDelta[i] = cellSize_ / direction[i];
+        }
+        else if (direction[i] < 0.0f)
+        {
+            step[i] = -1;
+            tMax[i] = (cell[i] * cellSize_ - rayFrom[i]) / direction[i];
+            tDelta[i] = -cellSize_ / direction[i];
+        }
+        else
+        {
+            step[i] = 0;
+            tMax[i] = M_INFINITY;
+            tDelta[i] = M_INFINITY;
+        }
+    }
+
+    if (numCells > MAX_QUERY_CELLS)
+    {
+        for (unsigned i = 0; i < proxies_.Size(); ++i)
+            ProcessRay(proxies_[i], rayFrom, rayCallback);
+        return;
+    }
+
+    for (unsigned i = 0; i < oversized_.Size(); ++i)
+        ProcessRay(oversized_[i], rayFrom, rayCallback);
+    for (unsigned n = 0; n < numCells; ++n)
+    {
+        HashMap<unsigned long long, PODVector<GridBroadphaseProxy*> >::ConstIterator i =
+            cells_.Find(MakeCellKey(cell[0], cell[1], cell[2]));
+        if (i != cells_.End())
+        {
+            for (unsigned j = 0; j < i->second_.Size(); ++j)
+                ProcessRay(i->second_[j], rayFrom, rayCallback);
+        }
+
+        unsigned axis = tMax[0] < tMax[1] ? (tMax[0] < tMax[2] ? 0 : 2) : (tMax[1] < tMax[2] ? 1 : 2);
+        if (tMax[axis] > 1.0f)
+            break;
+        cell[axis] += step[axis];
+        tMax[axis] += tDelta[axis];
+    }
+}
+
+void GridBroadphase::aabbTest(const btVector3& aabbMin, const btVector3& aabbMax, btBroadphaseAabbCallback& callback)
+{
+    ++queryStamp_;
+
+    int cellMin[3], cellMax[3];
+    if (GetCellRange(aabbMin, aabbMax, cellMin, cellMax) > MAX_QUERY_CELLS)
+    {
+        for (unsigned i = 0; i < proxies_.Size(); ++i)
+        {
+            GridBroadphaseProxy* proxy = proxies_[i];
+            if (TestAabbAgainstAabb2(aabbMin, aabbMax, proxy->m_aabbMin, proxy->m_aabbMax))
+                callback.process(proxy);
+        }
+        return;
+    }
+
+    for (unsigned i = 0; i < oversized_.Size(); ++i)
+    {
+        GridBroadphaseProxy* proxy = oversized_[i];
+        if (TestAabbAgainstAabb2(aabbMin, aabbMax, proxy->m_aabbMin, proxy->m_aabbMax))
+            callback.process(proxy);
+    }
+    for (int x = cellMin[0]; x <= cellMax[0]; ++x)
+    {
+        for (int y = cellMin[1]; y <= cellMax[1]; ++y)
+        {
+            for (int z = cellMin[2]; z <= cellMax[2]; ++z)
+            {
+                HashMap<unsigned long long, PODVector<GridBroadphaseProxy*> >::ConstIterator cell =
+                    cells_.Find(MakeCellKey(x, y, z));
+                if (cell == cells_.End())
+                    continue;
+                for (unsigned i = 0; i < cell->second_.Size(); ++i)
+                {
+                    GridBroadphaseProxy* proxy = cell->second_[i];
+                    if (proxy->queryStamp_ == queryStamp_)
+                        continue;
+                    proxy->queryStamp_ = queryStamp_;
+                    if (TestAabbAgainstAabb2(aabbMin, aabbMax, proxy->m_aabbMin, proxy->m_aabbMax))
+                        callback.process(proxy);
+                }
+            }
+        }
+    }
+}
+
+void GridBroadphase::calculateOverlappingPairs(btDispatcher* dispatcher)
+{
+    if (moved_.Empty())
+        return;
+
+    // Remove the pairs of moved proxies that no longer overlap. Iterate backwards, as removal swaps the last pair in
+    btBroadphasePairArray& pairs = pairCache_->getOverlappingPairArray();
+    for (int i = pairs.size() - 1; i >= 0; --i)
+    {
+        GridBroadphaseProxy* proxy0 = static_cast<GridBroadphaseProxy*>(pairs[i].m_pProxy0);
+        GridBroadphaseProxy* proxy1 = static_cast<GridBroadphaseProxy*>(pairs[i].m_pProxy1);
+        if (proxy0->moved_ || proxy1->moved_)
+        {
+            ++numOverlapTests_;
+            if (!ProxiesOverlap(proxy0, proxy1))
+                pairCache_->removeOverlappingPair(proxy0, proxy1, dispatcher);
+        }
+    }
+
+    // Find the new pairs of moved proxies in the cells they cover
+    for (unsigned i = 0; i < moved_.Size(); ++i)
+    {
+        GridBroadphaseProxy* proxy = moved_[i];
+        if (proxy->oversized_)
+        {
+            for (unsigned j = 0; j < proxies_.Size(); ++j)
+                TestPair(proxy, proxies_[j]);
+            continue;
+        }
+
+        for (unsigned j = 0; j < oversized_.Size(); ++j)
+            TestPair(proxy, oversized_[j]);
+        for (int x = proxy->cellMin_[0]; x <= proxy->cellMax_[0]; ++x)
+        {
+            for (int y = proxy->cellMin_[1]; y <= proxy->cellMax_[1]; ++y)
+            {
+                for (int z = proxy->cellMin_[2]; z <= proxy->cellMax_[2]; ++z)
+                {
+                    HashMap<unsigned long long, PODVector<GridBroadphaseProxy*> >::ConstIterator cell =
+                        cells_.Find(MakeCellKey(x, y, z));
+                    if (cell == cells_.End())
+                        continue;
+                    for (unsigned j = 0; j < cell->second_.Size(); ++j)
+                    {
+                        GridBroadphaseProxy* other = cell->second_[j];
+                        // Test a pair sharing several cells only in the first of them
+                        if (other->oversized_ || Max(proxy->cellMin_[0], other->cellMin_[0]) != x ||
+                            Max(proxy->cellMin_[1], other->cellMin_[1]) != y || Max(proxy->cellMin_[2], other->cellMin_[2]) != z)
+                            continue;
+                        TestPair(proxy, other);
+                    }
+                }
+            }
+        }
+    }
+
+    for (unsigned i = 0; i < moved_.Size(); ++i)
+        moved_[i]->moved_ = false;
+    moved_.Clear();
+}
+
+void GridBroadphase::getBroadphaseAabb(btVector3& aabbMin, btVector3& aabbMax) const
+{
+    if (proxies_.Empty())
+    {
+        aabbMin.setValue(0, 0, 0);
+        aabbMax.setValue(0, 0, 0);
+        return;
+    }
+
+    aabbMin = proxies_[0]->m_aabbMin;
+    aabbMax = proxies_[0]->m_aabbMax;
+    for (unsigned i = 1; i < proxies_.Size(); ++i)
+    {
+        aabbMin.setMin(proxies_[i]->m_aabbMin);
+        aabbMax.setMax(proxies_[i]->m_aabbMax);
+    }
+}
+
+unsigned GridBroadphase::GetCellRange(const btVector3& aabbMin, const btVector3& aabbMax, int* cellMin, int* cellMax) const
+{
+    unsigned numCells = 1;
+    for (unsigned i = 0; i < 3; ++i)
+    {
+        cellMin[i] = GetCellCoord(aabbMin[i], invCellSize_);
+        cellMax[i] = Max(GetCellCoord(aabbMax[i], invCellSize_), cellMin[i]);
+        unsigned extent = (unsigned)(cellMax[i] - cellMin[i] + 1);
+        numCells = extent > MAX_QUERY_CELLS || numCells > MAX_QUERY_CELLS ? MAX_QUERY_CELLS + 1 : numCells * extent;
+    }
+    return numCells;
+}
+
+void GridBroadphase::InsertIntoCells(GridBroadphaseProxy* proxy)
+{
+    proxy->oversized_ = GetCellRange(proxy->m_aabbMin, proxy->m_aabbMax, proxy->cellMin_, proxy->cellMax_) > MAX_PROXY_CELLS;
+    if (proxy->oversized_)
+    {
+        oversized_.Push(proxy);
+        return;
+    }
+
+    for (int x = proxy->cellMin_[0]; x <= proxy->cellMax_[0]; ++x)
+    {
+        for (int y = proxy->cellMin_[1]; y <= proxy->cellMax_[1]; ++y)
+        {
+            for (int z = proxy->cellMin_[2]; z <= proxy->cellMax_[2]; ++z)
+                cells_[MakeCellKey(x, y, z)].Push(proxy);
+        }
+    }
+}
+
+void GridBroadphase::RemoveFromCells(GridBroadphaseProxy* proxy)
+{
+    if (proxy->oversized_)
+    {
+        oversized_.Remove(proxy);
+        return;
+    }
+
+    for (int x = proxy->cellMin_[0]; x <= proxy->cellMax_[0]; ++x)
+    {
+        for (int y = proxy->cellMin_[1]; y <= proxy->cellMax_[1]; ++y)
+        {
+            for (int z = proxy->cellMin_[2]; z <= proxy->cellMax_[2]; ++z)
+            {
+                HashMap<unsigned long long, PODVector<GridBroadphaseProxy*> >::Iterator cell = cells_.Find(MakeCellKey(x, y, z));
+                if (cell == cells_.End())
+                    continue;
+                cell->second_.Remove(proxy);
+                if (cell->second_.Empty())
+                    cells_.Erase(cell);
+            }
+        }
+    }
+}
+
+void GridBroadphase::MarkMoved(GridBroadphaseProxy* proxy)
+{
+    if (!proxy->moved_)
+    {
+        proxy->moved_ = true;
+        moved_.Push(proxy);
+    }
+}
+
+void GridBroadphase::TestPair(GridBroadphaseProxy* proxy, GridBroadphaseProxy* other)
+{
+    // Pairs of two moved proxies are tested by the one earlier in the proxy list
+    if (other == proxy || (other->moved_ && other->index_ < proxy->index_))
+        return;
+
+    ++numOverlapTests_;
+    if (ProxiesOverlap(proxy, other))
+        pairCache_->addOverlappingPair(proxy, other);
+}
+
+void GridBroadphase::ProcessRay(GridBroadphaseProxy* proxy, const btVector3& rayFrom, btBroadphaseRayCallback& rayCallback)
+{
+    if (proxy->queryStamp_ == queryStamp_)
+        return;
+    proxy->queryStamp_ = queryStamp_;
+
+    btVector3 bounds[2] = { proxy->m_aabbMin, proxy->m_aabbMax };
+    btScalar lambda;
+    if (btRayAabb2(rayFrom, rayCallback.m_rayDirectionInverse, rayCallback.m_signs, bounds, lambda, 0.0f, rayCallback.m_lambda_max))
+        rayCallback.process(proxy);
+}
@@ -0,0 +1,145 @@
+//
+// Copyright (c) 2008-2015 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#pragma once
+
+#include <Urho3D/Container/HashMap.h>
+
+#include <Bullet/BulletCollision/BroadphaseCollision/btBroadphaseInterface.h>
+#include <Bullet/BulletCollision/BroadphaseCollision/btBroadphaseProxy.h>
+
+using namespace Urho3D;
+
+class btOverlappingPairCache;
+
+/// Default uniform grid cell size.
+static const float DEFAULT_GRID_CELL_SIZE = 8.0f;
+
+/// Proxy of a collision object in the uniform grid broadphase.
+struct GridBroadphaseProxy : public btBroadphaseProxy
+{
+    /// Construct.
+    GridBroadphaseProxy(const btVector3& aabbMin, const btVector3& aabbMax, void* userPtr, short int collisionFilterGroup,
+        short int collisionFilterMask) :
+        btBroadphaseProxy(aabbMin, aabbMax, userPtr, collisionFilterGroup, collisionFilterMask, 0),
+        index_(0),
+        queryStamp_(0),
+        moved_(false),
+        oversized_(false)
+    {
+    }
+
+    /// Lowest covered cell.
+    int cellMin_[3];
+    /// Highest covered cell.
+    int cellMax_[3];
+    /// Index in the proxy list.
+    unsigned index_;
+    /// Stamp of the last query that visited the proxy, to visit each proxy once per query.
+    unsigned queryStamp_;
+    /// Moved or created since the last pair update flag.
+    bool moved_;
+    /// Covers too many cells to be stored in them; kept in a separate list instead.
+    bool oversized_;
+};
+
+/// Broadphase that hashes the proxies into a sparse uniform grid of cubic cells. Only proxies that moved since the last
+/// step look for new and ended pairs, and only in the cells they cover, so the cost follows the number of moving bodies
+/// and stays flat along long sparse layouts where tree or sweep broadphases grow with the total count. Proxies larger
+/// than a few hundred cells, like a ground plane, are kept in a list that is tested against every moving proxy.
+class GridBroadphase : public btBroadphaseInterface
+{
+public:
+    /// Construct with the cell size.
+    GridBroadphase(float cellSize = DEFAULT_GRID_CELL_SIZE);
+    /// Destruct.
+    virtual ~GridBroadphase();
+
+    /// Create a proxy.
+    virtual btBroadphaseProxy* createProxy(const btVector3& aabbMin, const btVector3& aabbMax, int shapeType, void* userPtr,
+        short int collisionFilterGroup, short int collisionFilterMask, btDispatcher* dispatcher, void* multiSapProxy);
+    /// Destroy a proxy.
+    virtual void destroyProxy(btBroadphaseProxy* proxy, btDispatcher* dispatcher);
+    /// Update the bounding box of a proxy.
+    virtual void setAabb(btBroadphaseProxy* proxy, const btVector3& aabbMin, const btVector3& aabbMax, btDispatcher* dispatcher);
+    /// Return the bounding box of a proxy.
+    virtual void getAabb(btBroadphaseProxy* proxy, btVector3& aabbMin, btVector3& aabbMax) const;
+    /// Report the proxies along a ray, or along a swept box if the box is not empty.
+    virtual void rayTest(const btVector3& rayFrom, const btVector3& rayTo, btBroadphaseRayCallback& rayCallback,
+        const btVector3& aabbMin = btVector3(0, 0, 0), const btVector3& aabbMax = btVector3(0, 0, 0));
+    /// Report the proxies overlapping a bounding box.
+    virtual void aabbTest(const btVector3& aabbMin, const btVector3& aabbMax, btBroadphaseAabbCallback& callback);
+    /// Update the overlapping pairs of the proxies that moved.
+    virtual void calculateOverlappingPairs(btDispatcher* dispatcher);
+    /// Return the overlapping pair cache.
+    virtual btOverlappingPairCache* getOverlappingPairCache() { return pairCache_; }
+    /// Return the overlapping pair cache.
+    virtual const btOverlappingPairCache* getOverlappingPairCache() const { return pairCache_; }
+    /// Return the bounds of all proxies.
+    virtual void getBroadphaseAabb(btVector3& aabbMin, btVector3& aabbMax) const;
+    /// Print statistics.
+    virtual void printStats() {}
+
+    /// Return the cell size.
+    float GetCellSize() const { return cellSize_; }
+    /// Return number of proxies.
+    unsigned GetNumProxies() const { return proxies_.Size(); }
+    /// Return number of occupied cells.
+    unsigned GetNumCells() const { return cells_.Size(); }
+    /// Return number of proxy pair bounding box tests done so far by the pair updates.
+    unsigned long long GetNumOverlapTests() const { return numOverlapTests_; }
+
+private:
+    /// Compute the range of cells covered by a bounding box. Return the number of cells.
+    unsigned GetCellRange(const btVector3& aabbMin, const btVector3& aabbMax, int* cellMin, int* cellMax) const;
+    /// Add a proxy to the cells it covers, or to the oversized list.
+    void InsertIntoCells(GridBroadphaseProxy* proxy);
+    /// Remove a proxy from the cells it covers, or from the oversized list.
+    void RemoveFromCells(GridBroadphaseProxy* proxy);
+    /// Queue a proxy for the next pair update.
+    void MarkMoved(GridBroadphaseProxy* proxy);
+    /// Test a moved proxy against another proxy and add their pair if they overlap.
+    void TestPair(GridBroadphaseProxy* proxy, GridBroadphaseProxy* other);
+    /// Report a proxy to a ray callback if the ray hits its bounding box.
+    void ProcessRay(GridBroadphaseProxy* proxy, const btVector3& rayFrom, btBroadphaseRayCallback& rayCallback);
+
+    /// Overlapping pairs.
+    btOverlappingPairCache* pairCache_;
+    /// Proxies by cell key.
+    HashMap<unsigned long long, PODVector<GridBroadphaseProxy*> > cells_;
+    /// All proxies.
+    PODVector<GridBroadphaseProxy*> proxies_;
+    /// Proxies too large to store in the cells.
+    PODVector<GridBroadphaseProxy*> oversized_;
+    /// Proxies moved or created since the last pair update.
+    PODVector<GridBroadphaseProxy*> moved_;
+    /// Cell size.
+    float cellSize_;
+    /// Inverse of the cell size.
+    float invCellSize_;
+    /// Next proxy unique ID.
+    int nextProxyId_;
+    /// Current query stamp.
+    unsigned queryStamp_;
+    /// Number of proxy pair bounding box tests done so far.
+    unsigned long long numOverlapTests_;
+};
@@ -0,0 +1,362 @@
+//
+// Copyright (c) 2008-2015 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include <Urho3D/Core/Context.h>
+#include <Urho3D/Core/Timer.h>
+#include <Urho3D/Core/WorkQueue.h>
+#include <Urho3D/Physics/CollisionShape.h>
+#include <Urho3D/Physics/PhysicsEvents.h>
+#include <Urho3D/Physics/PhysicsUtils.h>
+#include <Urho3D/Physics/PhysicsWorld.h>
+#include <Urho3D/Physics/RigidBody.h>
+#include <Urho3D/Scene/Node.h>
+#include <Urho3D/Scene/SceneEvents.h>
+
+#include <Bullet/BulletCollision/BroadphaseCollision/btDbvtBroadphase.h>
+#include <Bullet/BulletDynamics/Dynamics/btDiscreteDynamicsWorld.h>
+
+#include "GroundProbeSystem.h"
+#include "PhysicsBroadphase.h"
+#include "TraceCapture.h"
+
+#include <Urho3D/DebugNew.h>
+
+/// Closest hit ray callback that ignores the probed body itself.
+struct ProbeRayCallback : public btCollisionWorld::ClosestRayResultCallback
+{
+    ProbeRayCallback(const btVector3& from, const btVector3& to, const btCollisionObject* self) :
+        btCollisionWorld::ClosestRayResultCallback(from, to),
+        self_(self)
+    {
+        // Probe with the filtering of the probed body, so that the ray hits what the body would collide with
+        const btBroadphaseProxy* proxy = self->getBroadphaseHandle();
+        if (proxy)
+        {
+            m_collisionFilterGroup = proxy->m_collisionFilterGroup;
+            m_collisionFilterMask = proxy->m_collisionFilterMask;
+        }
+    }
+
+    virtual bool needsCollision(btBroadphaseProxy* proxy0) const
+    {
+        return proxy0->m_clientObject != self_ && btCollisionWorld::ClosestRayResultCallback::needsCollision(proxy0);
+    }
+
+    /// Probed body.
+    const btCollisionObject* self_;
+};
+
+/// Dynamic tree leaf callback that tests the ray against the leaf's collision object. Unlike the broadphase's own ray
+/// test it keeps no shared traversal stack, so it can run on several threads at once.
+struct ProbeTreeCollide : public btDbvt::ICollide
+{
+    ProbeTreeCollide(const btTransform& from, const btTransform& to, ProbeRayCallback& callback) :
+        from_(from),
+        to_(to),
+        callback_(callback)
+    {
+    }
+
+    virtual void Process(const btDbvtNode* leaf)
+    {
+        btBroadphaseProxy* proxy = static_cast<btBroadphaseProxy*>(leaf->data);
+        if (!callback_.needsCollision(proxy))
+            return;
+
+        btCollisionObject* object = static_cast<btCollisionObject*>(proxy->m_clientObject);
+        btCollisionWorld::rayTestSingle(from_, to_, object, object->getCollisionShape(), object->getWorldTransform(),
+            callback_);
+    }
+
+    /// Ray start transform.
+    const btTransform& from_;
+    /// Ray end transform.
+    const btTransform& to_;
+    /// Result callback.
+    ProbeRayCallback& callback_;
+};
+
+static void CastProbesWork(const WorkItem* item, unsigned threadIndex)
+{
+    GroundProbeSystem* probes = static_cast<GroundProbeSystem*>(item->aux_);
+    probes->CastProbes((unsigned)(size_t)item->start_, (unsigned)(size_t)item->end_);
+}
+
+GroundProbeSystem::GroundProbeSystem(Context* context) :
+    Component(context),
+    minParallelProbes_(DEFAULT_MIN_PARALLEL_PROBES),
+    lastUpdateParallel_(false),
+    numGrounded_(0),
+    lastUpdateTime_(0.0f)
+{
+}
+
+GroundProbeSystem::~GroundProbeSystem()
+{
+}
+
+void GroundProbeSystem::RegisterObject(Context* context)
+{
+    context->RegisterFactory<GroundProbeSystem>();
+}
+
+unsigned GroundProbeSystem::AddProbe(Node* node, float margin)
+{
+    if (!node)
+        return M_MAX_UNSIGNED;
+
+    unsigned existing = GetProbeIndex(node);
+    if (existing != M_MAX_UNSIGNED)
+        return existing;
+
+    RigidBody* body = node->GetComponent<RigidBody>();
+    if (!body)
+        return M_MAX_UNSIGNED;
+
+    // Reach down to the bottom of the collision shape, so that the margin alone decides how far off ground still counts
+    float reach = 0.0f;
+    CollisionShape* shape = node->GetComponent<CollisionShape>();
+    if (shape)
+        reach = Max(node->GetWorldScale().y_ * (shape->GetSize().y_ * 0.5f - shape->GetPosition().y_), 0.0f);
+
+    unsigned index = nodes_.Size();
+
+    origins_.Push(Vector3::ZERO);
+    reaches_.Push(reach);
+    margins_.Push(Max(margin, 0.0f));
+    bodies_.Push(body);
+    nodes_.Push(node);
+    results_.Push(GroundProbeResult());
+    nodeIndices_[node->GetID()] = index;
+
+    return index;
+}
+
+void GroundProbeSystem::RemoveProbe(Node* node)
+{
+    unsigned index = GetProbeIndex(node);
+    if (index != M_MAX_UNSIGNED)
+        RemoveProbeAt(index);
+}
+
+void GroundProbeSystem::RemoveAllProbes()
+{
+    origins_.Clear();
+    reaches_.Clear();
+    margins_.Clear();
+    bodies_.Clear();
+    nodes_.Clear();
+    results_.Clear();
+    nodeIndices_.Clear();
+}
+
+void GroundProbeSystem::Update()
+{
+    TRACE_ZONE("GroundProbeSystem::Update");
+
+    HiresTimer timer;
+
+    unsigned count = nodes_.Size();
+    if (!count || !physicsWorld_)
+    {
+        numGrounded_ = 0;
+        lastUpdateParallel_ = false;
+        lastUpdateTime_ = 0.0f;
+        return;
+    }
+
+    // Gather the ray origins on the main thread. The rigid body position is read from the physics world, so it is exact
+    // also between the substeps of one frame
+    Vector3* origins = origins_.Buffer();
+    RigidBody** bodies = bodies_.Buffer();
+    for (unsigned i = 0; i < count; ++i)
+        origins[i] = bodies[i]->GetPosition();
+
+    WorkQueue* queue = GetSubsystem<WorkQueue>();
+    unsigned numThreads = queue ? queue->GetNumThreads() : 0;
+    // Look through the broadphase counting proxy, which forwards to the dynamic tree in the default mode
+    btDbvtBroadphase* tree = dynamic_cast<btDbvtBroadphase*>(PhysicsBroadphase::GetWorkingBroadphase(physicsWorld_));
+
+    // Only the dynamic tree can be traversed from several threads at once
+    lastUpdateParallel_ = tree && numThreads && count >= minParallelProbes_;
+    if (lastUpdateParallel_)
+    {
+        // Split into one batch per worker thread plus one for the main thread, which also works while completing
+        unsigned numBatches = numThreads + 1;
+        unsigned batchSize = (count + numBatches - 1) / numBatches;
+
+        for (unsigned start = 0; start < count; start += batchSize)
+        {
+            SharedPtr<WorkItem> item = queue->GetFreeItem();
+            item->priority_ = M_MAX_UNSIGNED;
+            item->workFunction_ = CastProbesWork;
+            item->aux_ = this;
+            item->start_ = (void*)(size_t)start;
+            item->end_ = (void*)(size_t)Min(start + batchSize, count);
+            queue->AddWorkItem(item);
+        }
+
+        queue->Complete(M_MAX_UNSIGNED);
+    }
+    else
+        CastProbes(0, count);
+
+    unsigned numGrounded = 0;
+    const GroundProbeResult* results = results_.Buffer();
+    for (unsigned i = 0; i < count; ++i)
+    {
+        if (results[i].grounded_)
+            ++numGrounded;
+    }
+
+    numGrounded_ = numGrounded;
+    lastUpdateTime_ = timer.GetUSec(false) / 1000.0f;
+}
+
+void GroundProbeSystem::SetMinParallelProbes(unsigned count)
+{
+    minParallelProbes_ = Max(count, 1U);
+}
+
+unsigned GroundProbeSystem::GetProbeIndex(Node* node) const
+{
+    if (!node)
+        return M_MAX_UNSIGNED;
+
+    HashMap<unsigned, unsigned>::ConstIterator i = nodeIndices_.Find(node->GetID());
+    return i != nodeIndices_.End() ? i->second_ : M_MAX_UNSIGNED;
+}
+
+const GroundProbeResult* GroundProbeSystem::GetResult(Node* node) const
+{
+    unsigned index = GetProbeIndex(node);
+    return index != M_MAX_UNSIGNED ? &results_[index] : 0;
+}
+
+bool GroundProbeSystem::IsGrounded(Node* node) const
+{
+    const GroundProbeResult* result = GetResult(node);
+    return result && result->grounded_;
+}
+
+void GroundProbeSystem::CastProbes(unsigned start, unsigned end)
+{
+    TRACE_ZONE("GroundProbeSystem::CastProbes");
+
+    btDiscreteDynamicsWorld* world = physicsWorld_->GetWorld();
+    btDbvtBroadphase* tree = dynamic_cast<btDbvtBroadphase*>(PhysicsBroadphase::GetWorkingBroadphase(physicsWorld_));
+
+    const Vector3* origins = origins_.Buffer();
+    const float* reaches = reaches_.Buffer();
+    const float* margins = margins_.Buffer();
+    RigidBody** bodies = bodies_.Buffer();
+    GroundProbeResult* results = results_.Buffer();
+
+    for (unsigned i = start; i < end; ++i)
+    {
+        float length = reaches[i] + margins[i];
+        btVector3 from = ToBtVector3(origins[i]);
+        btVector3 to = ToBtVector3(origins[i] - Vector3::UP * length);
+
+        ProbeRayCallback callback(from, to, bodies[i]->GetBody());
+        if (tree)
+        {
+            btTransform fromTransform(btQuaternion::getIdentity(), from);
+            btTransform toTransform(btQuaternion::getIdentity(), to);
+            ProbeTreeCollide collide(fromTransform, toTransform, callback);
+            btDbvt::rayTest(tree->m_sets[0].m_root, from, to, collide);
+            btDbvt::rayTest(tree->m_sets[1].m_root, from, to, collide);
+        }
+        else
+            world->rayTest(from, to, callback);
+
+        GroundProbeResult& result = results[i];
+        result.hit_ = callback.hasHit();
+        if (result.hit_)
+        {
+            result.position_ = ToVector3(callback.m_hitPointWorld);
+            result.normal_ = ToVector3(callback.m_hitNormalWorld).Normalized();
+            result.distance_ = callback.m_closestHitFraction * length;
+            result.body_ = static_cast<RigidBody*>(callback.m_collisionObject->getUserPointer());
+            result.node_ = result.body_ ? result.body_->GetNode() : 0;
+            result.grounded_ = result.normal_.y_ > GROUND_NORMAL_MIN_Y;
+        }
+        else
+            result = GroundProbeResult();
+    }
+}
+
+void GroundProbeSystem::OnNodeSet(Node* node)
+{
+    if (node)
+    {
+        physicsWorld_ = node->GetComponent<PhysicsWorld>();
+        if (physicsWorld_)
+            SubscribeToEvent(physicsWorld_, E_PHYSICSPOSTSTEP, HANDLER(GroundProbeSystem, HandlePhysicsPostStep));
+        SubscribeToEvent(node, E_NODEREMOVED, HANDLER(GroundProbeSystem, HandleNodeRemoved));
+    }
+    else
+    {
+        UnsubscribeFromAllEvents();
+        RemoveAllProbes();
+        physicsWorld_.Reset();
+    }
+}
+
+void GroundProbeSystem::HandlePhysicsPostStep(StringHash eventType, VariantMap& eventData)
+{
+    // Probe right after the step, so that the results are ready for the movement logic of the next step
+    if (IsEnabledEffective())
+        Update();
+}
+
+void GroundProbeSystem::HandleNodeRemoved(StringHash eventType, VariantMap& eventData)
+{
+    using namespace NodeRemoved;
+
+    RemoveProbe(static_cast<Node*>(eventData[P_NODE].GetPtr()));
+}
+
+void GroundProbeSystem::RemoveProbeAt(unsigned index)
+{
+    unsigned last = nodes_.Size() - 1;
+    nodeIndices_.Erase(nodes_[index]->GetID());
+
+    if (index != last)
+    {
+        origins_[index] = origins_[last];
+        reaches_[index] = reaches_[last];
+        margins_[index] = margins_[last];
+        bodies_[index] = bodies_[last];
+        nodes_[index] = nodes_[last];
+        results_[index] = results_[last];
+        nodeIndices_[nodes_[index]->GetID()] = index;
+    }
+
+    origins_.Resize(last);
+    reaches_.Resize(last);
+    margins_.Resize(last);
+    bodies_.Resize(last);
+    nodes_.Resize(last);
+    results_.Resize(last);
+}
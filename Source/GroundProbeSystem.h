@@ -0,0 +1,166 @@
+//
+// Copyright (c) 2008-2015 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#pragma once
+
+#include <Urho3D/Container/HashMap.h>
+#include <Urho3D/Scene/Component.h>
+
+namespace Urho3D
+{
+
+class PhysicsWorld;
+class RigidBody;
+struct WorkItem;
+
+}
+
+using namespace Urho3D;
+
+/// Default distance the ground probe reaches below the bottom of the collision shape.
+static const float DEFAULT_GROUND_PROBE_MARGIN = 0.1f;
+/// Minimum Y component of the ground normal for the hit to count as ground.
+static const float GROUND_NORMAL_MIN_Y = 0.75f;
+/// Default minimum number of probes before the batch is spread over the worker threads.
+static const unsigned DEFAULT_MIN_PARALLEL_PROBES = 64;
+
+/// Result of a ground probe on the last physics step.
+struct GroundProbeResult
+{
+    /// Construct as a miss.
+    GroundProbeResult() :
+        position_(Vector3::ZERO),
+        normal_(Vector3::UP),
+        distance_(0.0f),
+        body_(0),
+        node_(0),
+        hit_(false),
+        grounded_(false)
+    {
+    }
+
+    /// Hit position in world space.
+    Vector3 position_;
+    /// Hit normal in world space.
+    Vector3 normal_;
+    /// Distance from the probe origin to the hit.
+    float distance_;
+    /// Hit rigid body.
+    RigidBody* body_;
+    /// Scene node of the hit rigid body.
+    Node* node_;
+    /// Something was hit within the probe length.
+    bool hit_;
+    /// The hit counts as ground: the normal is mostly vertical.
+    bool grounded_;
+};
+
+/// Scene-level service that casts one short downward ray per registered body after every physics step, all in one
+/// batch, and keeps the grounded state, ground normal and ground body for the next step. Large batches are spread over
+/// the worker threads. The rays start at the node position and reach the given margin below the collision shape.
+class GroundProbeSystem : public Component
+{
+    OBJECT(GroundProbeSystem);
+
+public:
+    /// Construct.
+    GroundProbeSystem(Context* context);
+    /// Destruct.
+    virtual ~GroundProbeSystem();
+
+    /// Register object factory.
+    static void RegisterObject(Context* context);
+
+    /// Register a node for ground probing. The node must already have a rigid body and a collision shape. Return the
+    /// probe index.
+    unsigned AddProbe(Node* node, float margin = DEFAULT_GROUND_PROBE_MARGIN);
+    /// Unregister a node.
+    void RemoveProbe(Node* node);
+    /// Unregister all nodes.
+    void RemoveAllProbes();
+    /// Cast all probes against the current physics world state.
+    void Update();
+    /// Set minimum number of probes before the batch is spread over the worker threads.
+    void SetMinParallelProbes(unsigned count);
+
+    /// Return number of probes.
+    unsigned GetNumProbes() const { return nodes_.Size(); }
+    /// Return probed node by index.
+    Node* GetProbeNode(unsigned index) const { return index < nodes_.Size() ? nodes_[index] : 0; }
+    /// Return probe index of a node, or M_MAX_UNSIGNED if the node is not registered.
+    unsigned GetProbeIndex(Node* node) const;
+    /// Return probe result by index.
+    const GroundProbeResult& GetResult(unsigned index) const { return results_[index]; }
+    /// Return probe result of a node, or null if the node is not registered.
+    const GroundProbeResult* GetResult(Node* node) const;
+    /// Return whether a node was grounded on the last update. Unregistered nodes are never grounded.
+    bool IsGrounded(Node* node) const;
+    /// Return minimum number of probes before the batch is spread over the worker threads.
+    unsigned GetMinParallelProbes() const { return minParallelProbes_; }
+    /// Return whether the last update ran on the worker threads.
+    bool GetLastUpdateParallel() const { return lastUpdateParallel_; }
+    /// Return number of grounded probes on the last update.
+    unsigned GetNumGrounded() const { return numGrounded_; }
+    /// Return duration of the last update in milliseconds.
+    float GetLastUpdateTime() const { return lastUpdateTime_; }
+
+    /// Cast a range of probes. Called from the worker threads; touches only the physics world and the probe arrays.
+    void CastProbes(unsigned start, unsigned end);
+
+protected:
+    /// Handle node being assigned.
+    virtual void OnNodeSet(Node* node);
+
+private:
+    /// Handle physics post-step event.
+    void HandlePhysicsPostStep(StringHash eventType, VariantMap& eventData);
+    /// Handle scene node removal, to drop probes whose nodes go away.
+    void HandleNodeRemoved(StringHash eventType, VariantMap& eventData);
+    /// Remove probe by index by moving the last probe into its slot.
+    void RemoveProbeAt(unsigned index);
+
+    /// Ray start positions, gathered on the main thread before casting.
+    PODVector<Vector3> origins_;
+    /// Distances from the node position to the bottom of the collision shape, in world units along Y.
+    PODVector<float> reaches_;
+    /// Distances probed below the collision shape.
+    PODVector<float> margins_;
+    /// Probed rigid bodies. Owned by the scene.
+    PODVector<RigidBody*> bodies_;
+    /// Probed scene nodes. Owned by the scene; removed from here when the node leaves the scene.
+    PODVector<Node*> nodes_;
+    /// Results of the last update.
+    PODVector<GroundProbeResult> results_;
+    /// Probe index by node ID.
+    HashMap<unsigned, unsigned> nodeIndices_;
+    /// Physics world.
+    WeakPtr<PhysicsWorld> physicsWorld_;
+    /// Minimum number of probes before the batch is spread over the worker threads.
+    unsigned minParallelProbes_;
+    /// Whether the last update ran on the worker threads.
+    bool lastUpdateParallel_;
+    /// Number of grounded probes on the last update.
+    unsigned numGrounded_;
+    /// Duration of the last update in milliseconds.
+    float lastUpdateTime_;
+};
@@ -0,0 +1,171 @@
+//
+// Copyright (c) 2008-2015 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include <Urho3D/Math/MathDefs.h>
+
+#include "HdrHistogram.h"
+
+#include <Urho3D/DebugNew.h>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+/// Return the number of bits needed to represent a nonzero value.
+static unsigned GetBitLength(unsigned long long value)
+{
+#if defined(_MSC_VER) && defined(_WIN64)
+    unsigned long index;
+    _BitScanReverse64(&index, value);
+    return (unsigned)index + 1;
+#elif defined(_MSC_VER)
+    unsigned long index;
+    if (_BitScanReverse(&index, (unsigned long)(value >> 32)))
+        return (unsigned)index + 33;
+    _BitScanReverse(&index, (unsigned long)value);
+    return (unsigned)index + 1;
+#else
+    return 64 - (unsigned)__builtin_clzll(value);
+#endif
+}
+
+HdrHistogram::HdrHistogram(unsigned long long highestTrackableValue, unsigned significantDigits) :
+    highestTrackableValue_(Max(highestTrackableValue, 2ULL)),
+    significantDigits_(Clamp(significantDigits, 1U, 5U)),
+    totalCount_(0),
+    sum_(0),
+    min_(~0ULL),
+    max_(0)
+{
+    // A value is resolved to one part in 10^digits when each bucket has at least 2 * 10^digits sub-buckets, as the lower
+    // half of every bucket but the first overlaps the previous bucket
+    unsigned long long largestSingleUnitResolution = 2;
+    for (unsigned i = 0; i < significantDigits_; ++i)
+        largestSingleUnitResolution *= 10;
+
+    unsigned subBucketCountMagnitude = GetBitLength(largestSingleUnitResolution - 1);
+    subBucketHalfCountMagnitude_ = subBucketCountMagnitude - 1;
+    subBucketCount_ = 1U << subBucketCountMagnitude;
+    subBucketMask_ = subBucketCount_ - 1;
+
+    // Each further bucket doubles the range
+    unsigned bucketCount = 1;
+    unsigned long long smallestUntrackableValue = subBucketCount_;
+    while (smallestUntrackableValue <= highestTrackableValue_)
+    {
+        smallestUntrackableValue <<= 1;
+        ++bucketCount;
+    }
+
+    counts_.Resize((bucketCount + 1) * (subBucketCount_ / 2));
+    Reset();
+}
+
+void HdrHistogram::Record(unsigned long long value)
+{
+    value = Min(value, highestTrackableValue_);
+
+    ++counts_[GetCountsIndex(value)];
+    ++totalCount_;
+    sum_ += value;
+    min_ = Min(min_, value);
+    max_ = Max(max_, value);
+}
+
+void HdrHistogram::Add(const HdrHistogram& histogram)
+{
+    if (histogram.counts_.Size() != counts_.Size() || histogram.subBucketCount_ != subBucketCount_)
+        return;
+
+    for (unsigned i = 0; i < counts_.Size(); ++i)
+        counts_[i] += histogram.counts_[i];
+
+    totalCount_ += histogram.totalCount_;
+    sum_ += histogram.sum_;
+    if (histogram.totalCount_)
+    {
+        min_ = Min(min_, histogram.min_);
+        max_ = Max(max_, histogram.max_);
+    }
+}
+
+void HdrHistogram::Reset()
+{
+    for (unsigned i = 0; i < counts_.Size(); ++i)
+        counts_[i] = 0;
+
+    totalCount_ = 0;
+    sum_ = 0;
+    min_ = ~0ULL;
+    max_ = 0;
+}
+
+unsigned long long HdrHistogram::GetValueAtPercentile(double percentile) const
+{
+    if (!totalCount_)
+        return 0;
+
+    double fraction = Clamp(percentile, 0.0, 100.0) / 100.0;
+    unsigned long long countAtPercentile = Max((unsigned long long)(fraction * (double)totalCount_ + 0.5), 1ULL);
+
+    unsigned long long count = 0;
+    for (unsigned i = 0; i < counts_.Size(); ++i)
+    {
+        count += counts_[i];
+        if (count >= countAtPercentile)
+            return Min(GetHighestEquivalentValue(i), max_);
+    }
+
+    return max_;
+}
+
+String HdrHistogram::ToJSON(double scale) const
+{
+    return "{\"count\":" + String((unsigned)totalCount_) + ",\"p50\":" + String((float)(GetValueAtPercentile(50.0) / scale)) +
+        ",\"p90\":" + String((float)(GetValueAtPercentile(90.0) / scale)) + ",\"p99\":" +
+        String((float)(GetValueAtPercentile(99.0) / scale)) + ",\"max\":" + String((float)(GetMax() / scale)) +
+        ",\"mean\":" + String((float)(GetMean() / scale)) + "}";
+}
+
+unsigned HdrHistogram::GetCountsIndex(unsigned long long value) const
+{
+    // The bucket is found from the position of the highest set bit; values below the sub-bucket count all go to bucket 0
+    unsigned bucketIndex = GetBitLength(value | subBucketMask_) - (subBucketHalfCountMagnitude_ + 1);
+    unsigned subBucketIndex = (unsigned)(value >> bucketIndex);
+    return ((bucketIndex + 1) << subBucketHalfCountMagnitude_) + subBucketIndex - (subBucketCount_ / 2);
+}
+
+unsigned long long HdrHistogram::GetHighestEquivalentValue(unsigned index) const
+{
+    unsigned subBucketHalfCount = subBucketCount_ / 2;
+    int bucketIndex = (int)(index >> subBucketHalfCountMagnitude_) - 1;
+    unsigned subBucketIndex = (index & (subBucketHalfCount - 1)) + subBucketHalfCount;
+    if (bucketIndex < 0)
+    {
+        subBucketIndex -= subBucketHalfCount;
+        bucketIndex = 0;
+    }
+
+    unsigned long long lowestEquivalentValue = (unsigned long long)subBucketIndex << bucketIndex;
+    return lowestEquivalentValue + (1ULL << bucketIndex) - 1;
+}
@@ -0,0 +1,91 @@
+//
+// Copyright (c) 2008-2015 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#pragma once
+
+#include <Urho3D/Container/Str.h>
+#include <Urho3D/Container/Vector.h>
+
+using namespace Urho3D;
+
+/// High dynamic range histogram of non-negative integer values. Values are counted in buckets whose width grows with
+/// the value, so that any recorded value is reproduced within the configured number of significant decimal digits
+/// over the whole trackable range, with constant memory and constant time recording.
+class HdrHistogram
+{
+public:
+    /// Construct with the highest trackable value and the number of significant decimal digits (1-5). Larger values are
+    /// counted as the highest trackable value.
+    HdrHistogram(unsigned long long highestTrackableValue = 60000000, unsigned significantDigits = 3);
+
+    /// Record a value.
+    void Record(unsigned long long value);
+    /// Add the counts of another histogram with the same configuration.
+    void Add(const HdrHistogram& histogram);
+    /// Clear all counts.
+    void Reset();
+
+    /// Return the value below which the given percentage (0-100) of the recorded values fall, within the precision.
+    unsigned long long GetValueAtPercentile(double percentile) const;
+    /// Return number of recorded values.
+    unsigned long long GetCount() const { return totalCount_; }
+    /// Return the smallest recorded value exactly.
+    unsigned long long GetMin() const { return totalCount_ ? min_ : 0; }
+    /// Return the largest recorded value exactly.
+    unsigned long long GetMax() const { return max_; }
+    /// Return the mean of the recorded values.
+    double GetMean() const { return totalCount_ ? (double)sum_ / (double)totalCount_ : 0.0; }
+    /// Return highest trackable value.
+    unsigned long long GetHighestTrackableValue() const { return highestTrackableValue_; }
+    /// Return number of significant digits.
+    unsigned GetSignificantDigits() const { return significantDigits_; }
+    /// Return the count, p50, p90, p99, max and mean as a JSON object, with values divided by the given scale.
+    String ToJSON(double scale = 1.0) const;
+
+private:
+    /// Return counts index of a value.
+    unsigned GetCountsIndex(unsigned long long value) const;
+    /// Return the largest value that falls into the same bucket as the value at a counts index.
+    unsigned long long GetHighestEquivalentValue(unsigned index) const;
+
+    /// Counts by bucket.
+    PODVector<unsigned> counts_;
+    /// Highest trackable value.
+    unsigned long long highestTrackableValue_;
+    /// Number of significant digits.
+    unsigned significantDigits_;
+    /// Number of sub-buckets per bucket, a power of two.
+    unsigned subBucketCount_;
+    /// Base two logarithm of half the sub-bucket count.
+    unsigned subBucketHalfCountMagnitude_;
+    /// Mask of the values that fall into the first bucket.
+    unsigned long long subBucketMask_;
+    /// Number of recorded values.
+    unsigned long long totalCount_;
+    /// Sum of the recorded values.
+    unsigned long long sum_;
+    /// Smallest recorded value.
+    unsigned long long min_;
+    /// Largest recorded value.
+    unsigned long long max_;
+};
@@ -0,0 +1,145 @@
+//
+// Copyright (c) 2008-2015 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include <Urho3D/Core/CoreEvents.h>
+#include <Urho3D/Engine/DebugHud.h>
+#include <Urho3D/Input/InputEvents.h>
+
+#include "InputLatencyTracer.h"
+
+#include <Urho3D/DebugNew.h>
+
+InputLatencyTracer::InputLatencyTracer(Context* context) :
+    Object(context),
+    keyTime_(-1),
+    inputTime_(-1),
+    appliedTime_(-1),
+    applied_(false),
+    inputSequence_(0),
+    lastButtons_(0),
+    numOverlapped_(0),
+    numExpired_(0)
+{
+    SubscribeToEvent(E_KEYDOWN, HANDLER(InputLatencyTracer, HandleKeyDown));
+    SubscribeToEvent(E_KEYUP, HANDLER(InputLatencyTracer, HandleKeyUp));
+    SubscribeToEvent(E_ENDFRAME, HANDLER(InputLatencyTracer, HandleEndFrame));
+}
+
+InputLatencyTracer::~InputLatencyTracer()
+{
+}
+
+void InputLatencyTracer::SampleControls(unsigned buttons)
+{
+    ExpireInput(clock_.GetUSec(false));
+
+    if (buttons != lastButtons_)
+    {
+        if (inputTime_ < 0)
+        {
+            // The key event arrived at the start of the frame, before the controls were set from the key state
+            inputTime_ = keyTime_ >= 0 ? keyTime_ : clock_.GetUSec(false);
+            applied_ = false;
+            ++inputSequence_;
+        }
+        else
+            ++numOverlapped_;
+    }
+
+    lastButtons_ = buttons;
+    keyTime_ = -1;
+}
+
+void InputLatencyTracer::MarkApplied()
+{
+    if (inputTime_ < 0 || applied_)
+        return;
+
+    appliedTime_ = clock_.GetUSec(false);
+    inputToStep_.Record((unsigned long long)(appliedTime_ - inputTime_));
+    applied_ = true;
+}
+
+void InputLatencyTracer::MarkCameraMoved(unsigned inputSequence)
+{
+    long long now = clock_.GetUSec(false);
+    ExpireInput(now);
+    if (inputTime_ < 0 || !applied_ || inputSequence != inputSequence_)
+        return;
+
+    inputToCamera_.Record((unsigned long long)(now - inputTime_));
+    inputTime_ = -1;
+    applied_ = false;
+}
+
+void InputLatencyTracer::Reset()
+{
+    inputToStep_.Reset();
+    inputToCamera_.Reset();
+    numOverlapped_ = 0;
+    numExpired_ = 0;
+}
+
+String InputLatencyTracer::GetResultsJSON() const
+{
+    return "{\"inputToStepMs\":" + inputToStep_.ToJSON(1000.0) + ",\"inputToCameraMs\":" + inputToCamera_.ToJSON(1000.0) +
+        ",\"overlapped\":" + String(numOverlapped_) + ",\"expired\":" + String(numExpired_) + "}";
+}
+
+void InputLatencyTracer::HandleKeyDown(StringHash eventType, VariantMap& eventData)
+{
+    using namespace KeyDown;
+
+    if (!eventData[P_REPEAT].GetBool() && keyTime_ < 0)
+        keyTime_ = clock_.GetUSec(false);
+}
+
+void InputLatencyTracer::HandleKeyUp(StringHash eventType, VariantMap& eventData)
+{
+    if (keyTime_ < 0)
+        keyTime_ = clock_.GetUSec(false);
+}
+
+void InputLatencyTracer::HandleEndFrame(StringHash eventType, VariantMap& eventData)
+{
+    DebugHud* debugHud = GetSubsystem<DebugHud>();
+    if (!debugHud || !debugHud->GetMode() || hudTimer_.GetMSec(false) < INPUT_LATENCY_HUD_INTERVAL)
+        return;
+
+    hudTimer_.Reset();
+    debugHud->SetAppStats("Input to step p50/p99/max ms", String(inputToStep_.GetValueAtPercentile(50.0) / 1000.0f) + " / " +
+        String(inputToStep_.GetValueAtPercentile(99.0) / 1000.0f) + " / " + String(inputToStep_.GetMax() / 1000.0f));
+    debugHud->SetAppStats("Input to camera p50/p99/max ms", String(inputToCamera_.GetValueAtPercentile(50.0) / 1000.0f) +
+        " / " + String(inputToCamera_.GetValueAtPercentile(99.0) / 1000.0f) + " / " + String(inputToCamera_.GetMax() / 1000.0f));
+}
+
+void InputLatencyTracer::ExpireInput(long long now)
+{
+    if (inputTime_ < 0 || !applied_ || now - appliedTime_ <= INPUT_TRACE_TIMEOUT)
+        return;
+
+    // Not recorded, as the camera move that finally comes is not caused by this input
+    ++numExpired_;
+    inputTime_ = -1;
+    applied_ = false;
+}
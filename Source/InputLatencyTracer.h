@@ -0,0 +1,111 @@
+//
+// Copyright (c) 2008-2015 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#pragma once
+
+#include <Urho3D/Core/Object.h>
+#include <Urho3D/Core/Timer.h>
+
+#include "HdrHistogram.h"
+
+using namespace Urho3D;
+
+/// Interval between debug HUD updates in milliseconds.
+static const unsigned INPUT_LATENCY_HUD_INTERVAL = 500;
+/// Time in microseconds after its physics step within which a traced input must move the camera. Inputs that do not move
+/// it, like pushing into a wall, are dropped after this instead of blocking the tracer.
+static const long long INPUT_TRACE_TIMEOUT = 250000;
+
+/// Tracer of the latency from a change of the character controls to its first physics step and to the first camera
+/// movement that follows a character state produced with it. Each traced input gets a sequence number, which the character
+/// keeps from the physics steps that apply it and the camera hands back, so that camera moves from older states or from
+/// other causes do not end the trace. Only one input is traced at a time; changes while one is in flight are counted as
+/// overlapped.
+class InputLatencyTracer : public Object
+{
+    OBJECT(InputLatencyTracer);
+
+public:
+    /// Construct.
+    InputLatencyTracer(Context* context);
+    /// Destruct.
+    virtual ~InputLatencyTracer();
+
+    /// Sample the control buttons after they have been set for the frame. A change starts tracing an input, timestamped
+    /// at the key event that caused it if any.
+    void SampleControls(unsigned buttons);
+    /// Mark that a physics step applied the controls.
+    void MarkApplied();
+    /// Mark that the camera moved to follow a character state produced by physics steps that applied the given input.
+    void MarkCameraMoved(unsigned inputSequence);
+    /// Clear the histograms.
+    void Reset();
+
+    /// Return the histogram of input to physics step latencies in microseconds.
+    const HdrHistogram& GetInputToStep() const { return inputToStep_; }
+    /// Return the histogram of input to camera movement latencies in microseconds.
+    const HdrHistogram& GetInputToCamera() const { return inputToCamera_; }
+    /// Return number of inputs not traced because another input was in flight.
+    unsigned GetNumOverlapped() const { return numOverlapped_; }
+    /// Return number of traced inputs dropped because they did not move the camera in time.
+    unsigned GetNumExpired() const { return numExpired_; }
+    /// Return sequence number of the latest traced input.
+    unsigned GetInputSequence() const { return inputSequence_; }
+    /// Return the histograms as JSON, in milliseconds.
+    String GetResultsJSON() const;
+
+private:
+    /// Handle key down.
+    void HandleKeyDown(StringHash eventType, VariantMap& eventData);
+    /// Handle key up.
+    void HandleKeyUp(StringHash eventType, VariantMap& eventData);
+    /// Handle frame end. Updates the debug HUD.
+    void HandleEndFrame(StringHash eventType, VariantMap& eventData);
+    /// Drop the traced input if it was applied too long ago without moving the camera.
+    void ExpireInput(long long now);
+
+    /// Clock for the timestamps.
+    HiresTimer clock_;
+    /// Debug HUD update timer.
+    Timer hudTimer_;
+    /// Input to physics step latencies.
+    HdrHistogram inputToStep_;
+    /// Input to camera movement latencies.
+    HdrHistogram inputToCamera_;
+    /// Timestamp of the last key event not yet matched to a controls change, or negative.
+    long long keyTime_;
+    /// Timestamp of the traced input, or negative if none.
+    long long inputTime_;
+    /// Timestamp of the physics step that applied the traced input.
+    long long appliedTime_;
+    /// Traced input has been applied by a physics step flag.
+    bool applied_;
+    /// Sequence number of the latest traced input.
+    unsigned inputSequence_;
+    /// Control buttons on the last sample.
+    unsigned lastButtons_;
+    /// Number of inputs not traced because another input was in flight.
+    unsigned numOverlapped_;
+    /// Number of traced inputs dropped because they did not move the camera in time.
+    unsigned numExpired_;
+};
@@ -0,0 +1,270 @@
+//
+// Copyright (c) 2008-2015 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include <Urho3D/Core/CoreEvents.h>
+#include <Urho3D/Engine/Engine.h>
+#include <Urho3D/IO/File.h>
+#include <Urho3D/IO/Log.h>
+#include <Urho3D/Scene/Node.h>
+
+#include <cstring>
+
+#include "InputRecorder.h"
+
+#include <Urho3D/DebugNew.h>
+
+/// Run field flags.
+static const unsigned char RUN_BUTTONS = 1;
+static const unsigned char RUN_YAW = 2;
+static const unsigned char RUN_PITCH = 4;
+
+/// Return whether two floats are bitwise identical, so that also the sign of zero survives the recording.
+static bool SameBits(float lhs, float rhs)
+{
+    return memcmp(&lhs, &rhs, sizeof(float)) == 0;
+}
+
+InputRecorder::InputRecorder(Context* context) :
+    Object(context),
+    mode_(INPUT_RECORDER_IDLE),
+    seed_(0),
+    timeStep_(1.0f / 60.0f),
+    physicsFps_(60),
+    runLength_(0),
+    stepNumber_(0),
+    numSteps_(0),
+    hasRecordedPosition_(false),
+    exitOnFinish_(false)
+{
+}
+
+InputRecorder::~InputRecorder()
+{
+    if (mode_ == INPUT_RECORDER_RECORDING)
+        Finish();
+}
+
+void InputRecorder::StartRecording(const String& fileName, unsigned seed, float timeStep, int physicsFps,
+    const Vector<String>& options)
+{
+    mode_ = INPUT_RECORDER_RECORDING;
+    fileName_ = fileName;
+    seed_ = seed;
+    timeStep_ = timeStep;
+    physicsFps_ = physicsFps;
+    options_ = options;
+    runs_.Clear();
+    runControls_ = Controls();
+    lastRunControls_ = Controls();
+    runLength_ = 0;
+    stepNumber_ = 0;
+
+    GetSubsystem<Engine>()->SetNextTimeStep(timeStep_);
+    SubscribeToEvent(E_ENDFRAME, HANDLER(InputRecorder, HandleEndFrame));
+
+    LOGINFO("Recording input to " + fileName_);
+}
+
+bool InputRecorder::StartReplay(const String& fileName)
+{
+    File file(context_, fileName);
+    if (!file.IsOpen())
+    {
+        LOGERROR("Could not open input recording " + fileName);
+        return false;
+    }
+    if (file.ReadFileID() != "CREC" || file.ReadUInt() != INPUT_RECORDING_VERSION)
+    {
+        LOGERROR(fileName + " is not an input recording of this version");
+        return false;
+    }
+
+    seed_ = file.ReadUInt();
+    timeStep_ = file.ReadFloat();
+    physicsFps_ = file.ReadInt();
+    options_.Resize(file.ReadVLE());
+    for (unsigned i = 0; i < options_.Size(); ++i)
+        options_[i] = file.ReadString();
+    numSteps_ = file.ReadVLE();
+    hasRecordedPosition_ = file.ReadBool();
+    recordedPosition_ = file.ReadVector3();
+    unsigned runsSize = file.ReadVLE();
+    runs_.SetData(file, runsSize);
+
+    mode_ = INPUT_RECORDER_REPLAYING;
+    fileName_ = fileName;
+    runControls_ = Controls();
+    runLength_ = 0;
+    stepNumber_ = 0;
+
+    GetSubsystem<Engine>()->SetNextTimeStep(timeStep_);
+    SubscribeToEvent(E_ENDFRAME, HANDLER(InputRecorder, HandleEndFrame));
+
+    LOGINFOF("Replaying %u physics steps from %s", numSteps_, fileName_.CString());
+    return true;
+}
+
+void InputRecorder::ProcessStep(Controls& controls)
+{
+    if (mode_ == INPUT_RECORDER_RECORDING)
+    {
+        // Extend the current run while the controls stay the same
+        if (runLength_ && (controls.buttons_ != runControls_.buttons_ || !SameBits(controls.yaw_, runControls_.yaw_) ||
+            !SameBits(controls.pitch_, runControls_.pitch_)))
+            WriteRun();
+
+        if (!runLength_)
+        {
+            runControls_.buttons_ = controls.buttons_;
+            runControls_.yaw_ = controls.yaw_;
+            runControls_.pitch_ = controls.pitch_;
+        }
+
+        ++runLength_;
+        ++stepNumber_;
+    }
+    else if (mode_ == INPUT_RECORDER_REPLAYING)
+    {
+        if (!runLength_ && !ReadRun())
+            return;
+
+        controls.buttons_ = runControls_.buttons_;
+        controls.yaw_ = runControls_.yaw_;
+        controls.pitch_ = runControls_.pitch_;
+
+        --runLength_;
+        ++stepNumber_;
+    }
+}
+
+bool InputRecorder::Finish()
+{
+    InputRecorderMode mode = mode_;
+    mode_ = INPUT_RECORDER_IDLE;
+    UnsubscribeFromEvent(E_ENDFRAME);
+
+    if (mode == INPUT_RECORDER_REPLAYING)
+    {
+        if (!hasRecordedPosition_ || !target_)
+            LOGINFOF("Replayed %u of %u physics steps", stepNumber_, numSteps_);
+        else if (target_->GetWorldPosition() == recordedPosition_)
+            LOGINFOF("Replayed %u physics steps, final position matches the recording", stepNumber_);
+        else
+        {
+            LOGWARNINGF("Replayed %u physics steps, final position %s differs from the recorded %s", stepNumber_,
+                target_->GetWorldPosition().ToString().CString(), recordedPosition_.ToString().CString());
+        }
+        return true;
+    }
+
+    if (mode != INPUT_RECORDER_RECORDING)
+        return false;
+
+    if (runLength_)
+        WriteRun();
+
+    File file(context_, fileName_, FILE_WRITE);
+    if (!file.IsOpen())
+    {
+        LOGERROR("Could not write input recording " + fileName_);
+        return false;
+    }
+
+    file.WriteFileID("CREC");
+    file.WriteUInt(INPUT_RECORDING_VERSION);
+    file.WriteUInt(seed_);
+    file.WriteFloat(timeStep_);
+    file.WriteInt(physicsFps_);
+    file.WriteVLE(options_.Size());
+    for (unsigned i = 0; i < options_.Size(); ++i)
+        file.WriteString(options_[i]);
+    file.WriteVLE(stepNumber_);
+    file.WriteBool(target_.NotNull());
+    file.WriteVector3(target_ ? target_->GetWorldPosition() : Vector3::ZERO);
+    file.WriteVLE(runs_.GetSize());
+    file.Write(runs_.GetData(), runs_.GetSize());
+
+    LOGINFOF("Recorded %u physics steps to %s in %u bytes", stepNumber_, fileName_.CString(), file.GetSize());
+    return true;
+}
+
+void InputRecorder::SetTarget(Node* node)
+{
+    target_ = node;
+}
+
+void InputRecorder::HandleEndFrame(StringHash eventType, VariantMap& eventData)
+{
+    if (mode_ == INPUT_RECORDER_REPLAYING && stepNumber_ >= numSteps_)
+    {
+        Finish();
+        if (exitOnFinish_)
+            GetSubsystem<Engine>()->Exit();
+        return;
+    }
+
+    // The physics steps of a frame depend on the frame timestep, so it is fixed for both recording and replay
+    GetSubsystem<Engine>()->SetNextTimeStep(timeStep_);
+}
+
+void InputRecorder::WriteRun()
+{
+    unsigned char flags = 0;
+    if (runControls_.buttons_ != lastRunControls_.buttons_)
+        flags |= RUN_BUTTONS;
+    if (!SameBits(runControls_.yaw_, lastRunControls_.yaw_))
+        flags |= RUN_YAW;
+    if (!SameBits(runControls_.pitch_, lastRunControls_.pitch_))
+        flags |= RUN_PITCH;
+
+    runs_.WriteVLE(runLength_);
+    runs_.WriteUByte(flags);
+    if (flags & RUN_BUTTONS)
+        runs_.WriteVLE(runControls_.buttons_);
+    if (flags & RUN_YAW)
+        runs_.WriteFloat(runControls_.yaw_);
+    if (flags & RUN_PITCH)
+        runs_.WriteFloat(runControls_.pitch_);
+
+    lastRunControls_.buttons_ = runControls_.buttons_;
+    lastRunControls_.yaw_ = runControls_.yaw_;
+    lastRunControls_.pitch_ = runControls_.pitch_;
+    runLength_ = 0;
+}
+
+bool InputRecorder::ReadRun()
+{
+    if (runs_.IsEof())
+        return false;
+
+    runLength_ = runs_.ReadVLE();
+    unsigned char flags = runs_.ReadUByte();
+    if (flags & RUN_BUTTONS)
+        runControls_.buttons_ = runs_.ReadVLE();
+    if (flags & RUN_YAW)
+        runControls_.yaw_ = runs_.ReadFloat();
+    if (flags & RUN_PITCH)
+        runControls_.pitch_ = runs_.ReadFloat();
+
+    return runLength_ > 0;
+}
@@ -0,0 +1,139 @@
+//
+// Copyright (c) 2008-2015 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#pragma once
+
+#include <Urho3D/Core/Object.h>
+#include <Urho3D/Input/Controls.h>
+#include <Urho3D/IO/VectorBuffer.h>
+
+namespace Urho3D
+{
+
+class Node;
+
+}
+
+using namespace Urho3D;
+
+/// Input recording file format version.
+static const unsigned INPUT_RECORDING_VERSION = 1;
+
+/// Input recorder mode.
+enum InputRecorderMode
+{
+    /// Neither recording nor replaying.
+    INPUT_RECORDER_IDLE = 0,
+    /// Recording the controls of each physics step.
+    INPUT_RECORDER_RECORDING,
+    /// Replaying recorded controls.
+    INPUT_RECORDER_REPLAYING
+};
+
+/// Recorder and replayer of the character controls of each physics step. Together with the random seed, the fixed
+/// timestep and the command line options stored in the recording, the controls are the only input to the simulation, so
+/// a replay reproduces the recorded session exactly and can be profiled repeatedly and compared between builds.
+/// The file stores runs of identical controls, and of each run only the fields that changed from the previous run.
+class InputRecorder : public Object
+{
+    OBJECT(InputRecorder);
+
+public:
+    /// Construct.
+    InputRecorder(Context* context);
+    /// Destruct.
+    virtual ~InputRecorder();
+
+    /// Start recording to a file, which is written when finished. The seed, timestep, physics rate and options are
+    /// stored for the replay; the caller must apply them to the session being recorded.
+    void StartRecording(const String& fileName, unsigned seed, float timeStep, int physicsFps,
+        const Vector<String>& options);
+    /// Load a recording and start replaying it. Return true on success.
+    bool StartReplay(const String& fileName);
+    /// Record or replay the controls of one physics step. When replaying, the controls are overwritten.
+    void ProcessStep(Controls& controls);
+    /// Finish recording and write the file, or stop replaying. Return true on success.
+    bool Finish();
+    /// Set node whose final position is stored in the recording and compared at the end of the replay.
+    void SetTarget(Node* node);
+    /// Set whether to exit the engine when the replay ends.
+    void SetExitOnFinish(bool enable) { exitOnFinish_ = enable; }
+
+    /// Return mode.
+    InputRecorderMode GetMode() const { return mode_; }
+    /// Return whether replaying.
+    bool IsReplaying() const { return mode_ == INPUT_RECORDER_REPLAYING; }
+    /// Return random seed of the recording.
+    unsigned GetSeed() const { return seed_; }
+    /// Return fixed timestep of the recording.
+    float GetTimeStep() const { return timeStep_; }
+    /// Return physics steps per second of the recording.
+    int GetPhysicsFps() const { return physicsFps_; }
+    /// Return command line options of the recording.
+    const Vector<String>& GetOptions() const { return options_; }
+    /// Return number of physics steps recorded or replayed so far.
+    unsigned GetStepNumber() const { return stepNumber_; }
+    /// Return total number of physics steps in the replayed recording.
+    unsigned GetNumSteps() const { return numSteps_; }
+
+private:
+    /// Handle frame end. Sets the fixed timestep of the next frame and ends the replay when done.
+    void HandleEndFrame(StringHash eventType, VariantMap& eventData);
+    /// Write the current run of identical controls.
+    void WriteRun();
+    /// Read the next run of identical controls. Return false at the end of the recording.
+    bool ReadRun();
+
+    /// Mode.
+    InputRecorderMode mode_;
+    /// Recording file name.
+    String fileName_;
+    /// Encoded runs of controls.
+    VectorBuffer runs_;
+    /// Node whose final position is checked.
+    WeakPtr<Node> target_;
+    /// Command line options of the recording.
+    Vector<String> options_;
+    /// Random seed.
+    unsigned seed_;
+    /// Fixed timestep.
+    float timeStep_;
+    /// Physics steps per second.
+    int physicsFps_;
+    /// Controls of the current run.
+    Controls runControls_;
+    /// Controls of the previous run, which the current run is encoded against.
+    Controls lastRunControls_;
+    /// Number of steps in the current run. When replaying, number of steps left in it.
+    unsigned runLength_;
+    /// Steps recorded or replayed so far.
+    unsigned stepNumber_;
+    /// Total steps of the replayed recording.
+    unsigned numSteps_;
+    /// Final target position stored in the replayed recording.
+    Vector3 recordedPosition_;
+    /// Whether the replayed recording stores a final target position.
+    bool hasRecordedPosition_;
+    /// Exit the engine when the replay ends flag.
+    bool exitOnFinish_;
+};
@@ -0,0 +1,85 @@
+//
+// Copyright (c) 2008-2015 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#include <Urho3D/Math/MathDefs.h>
+
+#include "LoopbackTransport.h"
+
+#include <Urho3D/DebugNew.h>
+
+LoopbackTransport::LoopbackTransport(Context* context) :
+    Object(context),
+    time_(0.0),
+    latency_(0.0f)
+{
+}
+
+unsigned LoopbackTransport::AddEndpoint()
+{
+    inboxes_.Resize(inboxes_.Size() + 1);
+    counters_.Push(TransportCounters());
+    return inboxes_.Size() - 1;
+}
+
+void LoopbackTransport::Send(unsigned from, unsigned to, const VectorBuffer& packet)
+{
+    if (from >= inboxes_.Size() || to >= inboxes_.Size())
+        return;
+
+    inboxes_[to].Push(Packet());
+    Packet& sent = inboxes_[to].Back();
+    sent.from_ = from;
+    sent.arrivalTime_ = time_ + latency_;
+    sent.data_ = packet.GetBuffer();
+
+    unsigned size = packet.GetSize() + PACKET_HEADER_SIZE;
+    counters_[from].bytesSent_ += size;
+    ++counters_[from].packetsSent_;
+}
+
+bool LoopbackTransport::Receive(unsigned endpoint, unsigned& from, VectorBuffer& packet)
+{
+    if (endpoint >= inboxes_.Size())
+        return false;
+
+    List<Packet>& inbox = inboxes_[endpoint];
+    if (inbox.Empty() || inbox.Front().arrivalTime_ > time_)
+        return false;
+
+    from = inbox.Front().from_;
+    packet.SetData(inbox.Front().data_);
+    inbox.PopFront();
+
+    counters_[endpoint].bytesReceived_ += packet.GetSize() + PACKET_HEADER_SIZE;
+    ++counters_[endpoint].packetsReceived_;
+    return true;
+}
+
+void LoopbackTransport::Update(float timeStep)
+{
+    time_ += timeStep;
+}
+
+void LoopbackTransport::SetLatency(float latency)
+{
+    latency_ = Max(latency, 0.0f);
+}
@@ -0,0 +1,107 @@
+//
+// Copyright (c) 2008-2015 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#pragma once
+
+#include <Urho3D/Container/List.h>
+#include <Urho3D/Core/Object.h>
+#include <Urho3D/IO/VectorBuffer.h>
+
+using namespace Urho3D;
+
+/// Bytes added to each packet on the wire for the IPv4 and UDP headers, included in the traffic totals.
+static const unsigned PACKET_HEADER_SIZE = 28;
+
+/// Traffic totals of a transport endpoint. Byte counts include the packet headers.
+struct TransportCounters
+{
+    /// Construct with zero counts.
+    TransportCounters() :
+        bytesSent_(0),
+        bytesReceived_(0),
+        packetsSent_(0),
+        packetsReceived_(0)
+    {
+    }
+
+    /// Bytes sent.
+    unsigned long long bytesSent_;
+    /// Bytes received.
+    unsigned long long bytesReceived_;
+    /// Packets sent.
+    unsigned long long packetsSent_;
+    /// Packets received.
+    unsigned long long packetsReceived_;
+};
+
+/// In-process stand-in for UDP sockets on localhost, for running replication servers and clients in one process. Each
+/// endpoint has an inbox; packets arrive in order after a fixed one-way latency measured on the transport's own clock,
+/// which the owner advances, so runs with a fixed timestep are reproducible. Packets are never lost or duplicated.
+class LoopbackTransport : public Object
+{
+    OBJECT(LoopbackTransport);
+
+public:
+    /// Construct.
+    LoopbackTransport(Context* context);
+
+    /// Add an endpoint and return its index.
+    unsigned AddEndpoint();
+    /// Send a packet between endpoints.
+    void Send(unsigned from, unsigned to, const VectorBuffer& packet);
+    /// Take the next arrived packet of an endpoint. Return false if there is none.
+    bool Receive(unsigned endpoint, unsigned& from, VectorBuffer& packet);
+    /// Advance the transport clock.
+    void Update(float timeStep);
+    /// Set one-way latency in seconds.
+    void SetLatency(float latency);
+
+    /// Return one-way latency in seconds.
+    float GetLatency() const { return latency_; }
+    /// Return the transport clock in seconds.
+    double GetTime() const { return time_; }
+    /// Return number of endpoints.
+    unsigned GetNumEndpoints() const { return inboxes_.Size(); }
+    /// Return the traffic totals of an endpoint.
+    const TransportCounters& GetCounters(unsigned endpoint) const { return counters_[endpoint]; }
+
+private:
+    /// Packet in flight.
+    struct Packet
+    {
+        /// Sending endpoint.
+        unsigned from_;
+        /// Arrival time on the transport clock.
+        double arrivalTime_;
+        /// Payload.
+        PODVector<unsigned char> data_;
+    };
+
+    /// Packets in flight to each endpoint, in arrival order.
+    Vector<List<Packet> > inboxes_;
+    /// Traffic totals of each endpoint.
+    PODVector<TransportCounters> counters_;
+    /// Transport clock.
+    double time_;
+    /// One-way latency.
+    float latency_;
+};
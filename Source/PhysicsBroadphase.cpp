@@ -0,0 +1,458 @@
+//
+// Copyright (c) 2008-2015 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#include <Urho3D/Core/Context.h>
+#include <Urho3D/Core/CoreEvents.h>
+#include <Urho3D/Core/StringUtils.h>
+#include <Urho3D/Engine/DebugHud.h>
+#include <Urho3D/Physics/PhysicsEvents.h>
+#include <Urho3D/Physics/PhysicsUtils.h>
+#include <Urho3D/Physics/PhysicsWorld.h>
+#include <Urho3D/Scene/Scene.h>
+
+#include <Bullet/BulletCollision/BroadphaseCollision/btAxisSweep3.h>
+#include <Bullet/BulletCollision/BroadphaseCollision/btBroadphaseInterface.h>
+#include <Bullet/BulletCollision/BroadphaseCollision/btOverlappingPairCache.h>
+#include <Bullet/BulletCollision/CollisionDispatch/btCollisionObject.h>
+#include <Bullet/BulletCollision/CollisionShapes/btCollisionShape.h>
+#include <Bullet/BulletDynamics/Dynamics/btDiscreteDynamicsWorld.h>
+
+#include "GridBroadphase.h"
+#include "PhysicsBroadphase.h"
+
+#include <Urho3D/DebugNew.h>
+
+/// Interval between debug HUD updates in milliseconds.
+static const unsigned BROADPHASE_HUD_INTERVAL = 500;
+/// Default axis sweep world bounds.
+static const BoundingBox DEFAULT_BROADPHASE_BOUNDS(Vector3(-1000.0f, -1000.0f, -1000.0f), Vector3(1000.0f, 1000.0f, 1000.0f));
+
+const char* broadphaseTypeNames[] =
+{
+    "DBVT",
+    "AxisSweep",
+    "Grid",
+    0
+};
+
+/// Pair filter that counts the pairs offered to the pair cache. Filters by collision layer and mask like the default, or
+/// defers to the filter that was installed before.
+class CountingPairFilter : public btOverlapFilterCallback
+{
+public:
+    /// Construct.
+    CountingPairFilter(btOverlapFilterCallback* filter, unsigned long long* count) :
+        filter_(filter),
+        count_(count)
+    {
+    }
+
+    /// Count a pair and return whether it should be added.
+    virtual bool needBroadphaseCollision(btBroadphaseProxy* proxy0, btBroadphaseProxy* proxy1) const
+    {
+        ++*count_;
+        if (filter_)
+            return filter_->needBroadphaseCollision(proxy0, proxy1);
+        return (proxy0->m_collisionFilterGroup & proxy1->m_collisionFilterMask) != 0 &&
+            (proxy1->m_collisionFilterGroup & proxy0->m_collisionFilterMask) != 0;
+    }
+
+    /// Return the filter that was installed before.
+    btOverlapFilterCallback* GetFilter() const { return filter_; }
+
+private:
+    /// Filter that was installed before.
+    btOverlapFilterCallback* filter_;
+    /// Count to increment.
+    unsigned long long* count_;
+};
+
+/// Broadphase that forwards everything to the selected broadphase and counts and times its work.
+class CountingBroadphase : public btBroadphaseInterface
+{
+public:
+    /// Construct. The grid broadphase, if given, is the forwarded one and reports its bounding box tests. All the
+    /// broadphases in use keep their pairs in a hashed pair cache, which holds the pair filter to count through.
+    CountingBroadphase(btBroadphaseInterface* broadphase, GridBroadphase* grid) :
+        broadphase_(broadphase),
+        grid_(grid),
+        pairFilter_(static_cast<btHashedOverlappingPairCache*>(broadphase->getOverlappingPairCache())->getOverlapFilterCallback(),
+            &counters_.candidatePairs_),
+        stepStarted_(false),
+        updating_(false)
+    {
+        broadphase_->getOverlappingPairCache()->setOverlapFilterCallback(&pairFilter_);
+    }
+
+    /// Destruct. Puts the previous pair filter back.
+    virtual ~CountingBroadphase()
+    {
+        broadphase_->getOverlappingPairCache()->setOverlapFilterCallback(pairFilter_.GetFilter());
+    }
+
+    /// Create a proxy.
+    virtual btBroadphaseProxy* createProxy(const btVector3& aabbMin, const btVector3& aabbMax, int shapeType, void* userPtr,
+        short int collisionFilterGroup, short int collisionFilterMask, btDispatcher* dispatcher, void* multiSapProxy)
+    {
+        return broadphase_->createProxy(aabbMin, aabbMax, shapeType, userPtr, collisionFilterGroup, collisionFilterMask,
+            dispatcher, multiSapProxy);
+    }
+
+    /// Destroy a proxy.
+    virtual void destroyProxy(btBroadphaseProxy* proxy, btDispatcher* dispatcher)
+    {
+        broadphase_->destroyProxy(proxy, dispatcher);
+    }
+
+    /// Update the bounding box of a proxy and count it by the kind of body that moved.
+    virtual void setAabb(btBroadphaseProxy* proxy, const btVector3& aabbMin, const btVector3& aabbMax, btDispatcher* dispatcher)
+    {
+        if (stepStarted_)
+        {
+            stepStarted_ = false;
+            updating_ = true;
+            stepTimer_.Reset();
+        }
+
+        ++counters_.aabbUpdates_;
+        if (aabbMin != proxy->m_aabbMin || aabbMax != proxy->m_aabbMax)
+        {
+            const btCollisionObject* object = static_cast<const btCollisionObject*>(proxy->m_clientObject);
+            if (object && object->isKinematicObject())
+                ++counters_.kinematicMoves_;
+            else if (object && object->isStaticObject())
+                ++counters_.staticMoves_;
+            else
+                ++counters_.dynamicMoves_;
+        }
+
+        broadphase_->setAabb(proxy, aabbMin, aabbMax, dispatcher);
+    }
+
+    /// Return the bounding box of a proxy.
+    virtual void getAabb(btBroadphaseProxy* proxy, btVector3& aabbMin, btVector3& aabbMax) const
+    {
+        broadphase_->getAabb(proxy, aabbMin, aabbMax);
+    }
+
+    /// Cast a ray.
+    virtual void rayTest(const btVector3& rayFrom, const btVector3& rayTo, btBroadphaseRayCallback& rayCallback,
+        const btVector3& aabbMin, const btVector3& aabbMax)
+    {
+        broadphase_->rayTest(rayFrom, rayTo, rayCallback, aabbMin, aabbMax);
+    }
+
+    /// Query a bounding box.
+    virtual void aabbTest(const btVector3& aabbMin, const btVector3& aabbMax, btBroadphaseAabbCallback& callback)
+    {
+        broadphase_->aabbTest(aabbMin, aabbMax, callback);
+    }
+
+    /// Update the overlapping pairs. Called once per physics step.
+    virtual void calculateOverlappingPairs(btDispatcher* dispatcher)
+    {
+        if (updating_)
+        {
+            counters_.updateUSec_ += stepTimer_.GetUSec(false);
+            updating_ = false;
+        }
+        stepStarted_ = false;
+        stepTimer_.Reset();
+
+        ++counters_.steps_;
+        broadphase_->calculateOverlappingPairs(dispatcher);
+
+        counters_.pairUSec_ += stepTimer_.GetUSec(false);
+        counters_.pairs_ += broadphase_->getOverlappingPairCache()->getNumOverlappingPairs();
+        if (grid_)
+            counters_.overlapTests_ = grid_->GetNumOverlapTests();
+    }
+
+    /// Return the overlapping pair cache.
+    virtual btOverlappingPairCache* getOverlappingPairCache() { return broadphase_->getOverlappingPairCache(); }
+    /// Return the overlapping pair cache.
+    virtual const btOverlappingPairCache* getOverlappingPairCache() const { return broadphase_->getOverlappingPairCache(); }
+
+    /// Return the bounds of all proxies.
+    virtual void getBroadphaseAabb(btVector3& aabbMin, btVector3& aabbMax) const
+    {
+        broadphase_->getBroadphaseAabb(aabbMin, aabbMax);
+    }
+
+    /// Reset the proxy pool.
+    virtual void resetPool(btDispatcher* dispatcher) { broadphase_->resetPool(dispatcher); }
+    /// Print statistics.
+    virtual void printStats() { broadphase_->printStats(); }
+
+    /// Return the forwarded broadphase.
+    btBroadphaseInterface* GetBroadphase() const { return broadphase_; }
+    /// Return the running totals.
+    const BroadphaseCounters& GetCounters() const { return counters_; }
+    /// Start timing the bounding box updates at the next one.
+    void BeginStep() { stepStarted_ = true; }
+
+private:
+    /// Forwarded broadphase.
+    btBroadphaseInterface* broadphase_;
+    /// Forwarded broadphase if it is the grid.
+    GridBroadphase* grid_;
+    /// Running totals.
+    BroadphaseCounters counters_;
+    /// Pair counting filter.
+    CountingPairFilter pairFilter_;
+    /// Step timer.
+    HiresTimer stepTimer_;
+    /// Physics step started and no bounding box updated yet flag.
+    bool stepStarted_;
+    /// Bounding box updates being timed flag.
+    bool updating_;
+};
+
+/// Move the proxies of all collision objects of a world from one broadphase to another.
+static void MoveProxies(btCollisionWorld* world, btBroadphaseInterface* from, btBroadphaseInterface* to)
+{
+    btCollisionObjectArray& objects = world->getCollisionObjectArray();
+    btDispatcher* dispatcher = world->getDispatcher();
+    for (int i = 0; i < objects.size(); ++i)
+    {
+        btCollisionObject* object = objects[i];
+        btBroadphaseProxy* proxy = object->getBroadphaseHandle();
+        if (!proxy)
+            continue;
+
+        short int group = proxy->m_collisionFilterGroup;
+        short int mask = proxy->m_collisionFilterMask;
+        btVector3 aabbMin, aabbMax;
+        from->getAabb(proxy, aabbMin, aabbMax);
+        from->destroyProxy(proxy, dispatcher);
+        object->setBroadphaseHandle(to->createProxy(aabbMin, aabbMax, object->getCollisionShape()->getShapeType(), object, group,
+            mask, dispatcher, 0));
+    }
+}
+
+PhysicsBroadphase::PhysicsBroadphase(Context* context) :
+    Component(context),
+    broadphase_(0),
+    worldBroadphase_(0),
+    ownBroadphase_(0),
+    type_(BROADPHASE_DBVT),
+    worldBounds_(DEFAULT_BROADPHASE_BOUNDS),
+    maxProxies_(DEFAULT_BROADPHASE_MAX_PROXIES),
+    cellSize_(DEFAULT_GRID_CELL_SIZE)
+{
+}
+
+PhysicsBroadphase::~PhysicsBroadphase()
+{
+    Uninstall();
+}
+
+void PhysicsBroadphase::RegisterObject(Context* context)
+{
+    context->RegisterFactory<PhysicsBroadphase>();
+
+    ENUM_ACCESSOR_ATTRIBUTE("Broadphase", GetType, SetType, BroadphaseType, broadphaseTypeNames, BROADPHASE_DBVT, AM_DEFAULT);
+    ACCESSOR_ATTRIBUTE("World Bounds Min", GetWorldBoundsMinAttr, SetWorldBoundsMinAttr, Vector3, DEFAULT_BROADPHASE_BOUNDS.min_,
+        AM_DEFAULT);
+    ACCESSOR_ATTRIBUTE("World Bounds Max", GetWorldBoundsMaxAttr, SetWorldBoundsMaxAttr, Vector3, DEFAULT_BROADPHASE_BOUNDS.max_,
+        AM_DEFAULT);
+    ACCESSOR_ATTRIBUTE("Max Proxies", GetMaxProxies, SetMaxProxies, unsigned, DEFAULT_BROADPHASE_MAX_PROXIES, AM_DEFAULT);
+    ACCESSOR_ATTRIBUTE("Cell Size", GetCellSize, SetCellSize, float, DEFAULT_GRID_CELL_SIZE, AM_DEFAULT);
+}
+
+void PhysicsBroadphase::SetType(BroadphaseType type)
+{
+    if (type == type_)
+        return;
+
+    type_ = type;
+    Reinstall(type);
+}
+
+void PhysicsBroadphase::SetWorldBounds(const BoundingBox& bounds)
+{
+    worldBounds_ = bounds;
+    Reinstall(BROADPHASE_AXIS_SWEEP);
+}
+
+void PhysicsBroadphase::SetMaxProxies(unsigned maxProxies)
+{
+    maxProxies_ = maxProxies;
+    Reinstall(BROADPHASE_AXIS_SWEEP);
+}
+
+void PhysicsBroadphase::SetCellSize(float size)
+{
+    cellSize_ = Max(size, M_EPSILON);
+    Reinstall(BROADPHASE_GRID);
+}
+
+const BroadphaseCounters& PhysicsBroadphase::GetCounters() const
+{
+    static const BroadphaseCounters noCounters;
+    return broadphase_ ? broadphase_->GetCounters() : noCounters;
+}
+
+unsigned PhysicsBroadphase::GetNumPairs() const
+{
+    return broadphase_ ? (unsigned)broadphase_->getOverlappingPairCache()->getNumOverlappingPairs() : 0;
+}
+
+btBroadphaseInterface* PhysicsBroadphase::GetWorkingBroadphase(PhysicsWorld* world)
+{
+    if (!world)
+        return 0;
+
+    btBroadphaseInterface* broadphase = world->GetWorld()->getBroadphase();
+    CountingBroadphase* counting = dynamic_cast<CountingBroadphase*>(broadphase);
+    return counting ? counting->GetBroadphase() : broadphase;
+}
+
+void PhysicsBroadphase::SetWorldBoundsMinAttr(const Vector3& value)
+{
+    SetWorldBounds(BoundingBox(value, worldBounds_.max_));
+}
+
+void PhysicsBroadphase::SetWorldBoundsMaxAttr(const Vector3& value)
+{
+    SetWorldBounds(BoundingBox(worldBounds_.min_, value));
+}
+
+void PhysicsBroadphase::OnNodeSet(Node* node)
+{
+    if (node)
+    {
+        physicsWorld_ = node->GetScene()->GetOrCreateComponent<PhysicsWorld>();
+        Install();
+        SubscribeToEvent(E_ENDFRAME, HANDLER(PhysicsBroadphase, HandleEndFrame));
+        SubscribeToEvent(physicsWorld_, E_PHYSICSPRESTEP, HANDLER(PhysicsBroadphase, HandlePhysicsPreStep));
+    }
+    else
+    {
+        UnsubscribeFromAllEvents();
+        Uninstall();
+        physicsWorld_.Reset();
+    }
+}
+
+void PhysicsBroadphase::Install()
+{
+    if (broadphase_ || !physicsWorld_)
+        return;
+
+    btDiscreteDynamicsWorld* world = physicsWorld_->GetWorld();
+    worldBroadphase_ = world->getBroadphase();
+
+    GridBroadphase* grid = 0;
+    switch (type_)
+    {
+    case BROADPHASE_AXIS_SWEEP:
+        ownBroadphase_ = new bt32BitAxisSweep3(ToBtVector3(worldBounds_.min_), ToBtVector3(worldBounds_.max_),
+            Max(maxProxies_, (unsigned)world->getNumCollisionObjects() * 2));
+        break;
+
+    case BROADPHASE_GRID:
+        ownBroadphase_ = grid = new GridBroadphase(cellSize_);
+        break;
+
+    default:
+        break;
+    }
+
+    btBroadphaseInterface* broadphase = worldBroadphase_;
+    if (ownBroadphase_)
+    {
+        MoveProxies(world, worldBroadphase_, ownBroadphase_);
+        broadphase = ownBroadphase_;
+    }
+
+    broadphase_ = new CountingBroadphase(broadphase, grid);
+    world->setBroadphase(broadphase_);
+}
+
+void PhysicsBroadphase::Uninstall()
+{
+    if (!broadphase_)
+        return;
+
+    // If the physics world is already gone, it has released its bodies through the proxy and nothing refers to it anymore
+    if (physicsWorld_)
+    {
+        btDiscreteDynamicsWorld* world = physicsWorld_->GetWorld();
+        if (ownBroadphase_)
+            MoveProxies(world, ownBroadphase_, worldBroadphase_);
+        world->setBroadphase(worldBroadphase_);
+    }
+
+    delete broadphase_;
+    broadphase_ = 0;
+    delete ownBroadphase_;
+    ownBroadphase_ = 0;
+    worldBroadphase_ = 0;
+    hudCounters_ = BroadphaseCounters();
+}
+
+void PhysicsBroadphase::Reinstall(BroadphaseType type)
+{
+    if (broadphase_ && type == type_)
+    {
+        Uninstall();
+        Install();
+    }
+}
+
+void PhysicsBroadphase::HandleEndFrame(StringHash eventType, VariantMap& eventData)
+{
+    if (hudTimer_.GetMSec(false) < BROADPHASE_HUD_INTERVAL)
+        return;
+    hudTimer_.Reset();
+
+    DebugHud* debugHud = GetSubsystem<DebugHud>();
+    if (!debugHud)
+        return;
+
+    const BroadphaseCounters& counters = GetCounters();
+    unsigned long long steps = counters.steps_ - hudCounters_.steps_;
+    if (steps)
+    {
+        float staticMoves = (float)(counters.staticMoves_ - hudCounters_.staticMoves_) / steps;
+        float kinematicMoves = (float)(counters.kinematicMoves_ - hudCounters_.kinematicMoves_) / steps;
+        float dynamicMoves = (float)(counters.dynamicMoves_ - hudCounters_.dynamicMoves_) / steps;
+        debugHud->SetAppStats("Broadphase moves/step", ToString("static %.1f kinematic %.1f dynamic %.1f", staticMoves,
+            kinematicMoves, dynamicMoves));
+
+        float pairs = (float)(counters.pairs_ - hudCounters_.pairs_) / steps;
+        float candidatePairs = (float)(counters.candidatePairs_ - hudCounters_.candidatePairs_) / steps;
+        float updateMs = (float)(counters.updateUSec_ - hudCounters_.updateUSec_) / steps / 1000.0f;
+        float pairMs = (float)(counters.pairUSec_ - hudCounters_.pairUSec_) / steps / 1000.0f;
+        debugHud->SetAppStats("Broadphase work/step", ToString("%s pairs %.0f candidates %.1f update %.3f ms pairs %.3f ms",
+            broadphaseTypeNames[type_], pairs, candidatePairs, updateMs, pairMs));
+    }
+
+    hudCounters_ = counters;
+}
+
+void PhysicsBroadphase::HandlePhysicsPreStep(StringHash eventType, VariantMap& eventData)
+{
+    if (broadphase_)
+        broadphase_->BeginStep();
+}
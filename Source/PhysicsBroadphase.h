@@ -0,0 +1,185 @@
+//
+// Copyright (c) 2008-2015 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#pragma once
+
+#include <Urho3D/Core/Timer.h>
+#include <Urho3D/Math/BoundingBox.h>
+#include <Urho3D/Scene/Component.h>
+
+namespace Urho3D
+{
+
+class PhysicsWorld;
+
+}
+
+using namespace Urho3D;
+
+class btBroadphaseInterface;
+class CountingBroadphase;
+class GridBroadphase;
+
+/// Broadphase algorithm.
+enum BroadphaseType
+{
+    /// Dynamic bounding volume tree, the physics world's own.
+    BROADPHASE_DBVT = 0,
+    /// Sweep and prune along the three axes, within fixed world bounds.
+    BROADPHASE_AXIS_SWEEP,
+    /// Sparse uniform grid hash.
+    BROADPHASE_GRID
+};
+
+/// Broadphase algorithm names, as used by the attribute.
+extern const char* broadphaseTypeNames[];
+/// Default axis sweep proxy capacity.
+static const unsigned DEFAULT_BROADPHASE_MAX_PROXIES = 65536;
+
+/// Running totals of the broadphase work of a physics world.
+struct BroadphaseCounters
+{
+    /// Construct with zero counts.
+    BroadphaseCounters() :
+        steps_(0),
+        aabbUpdates_(0),
+        staticMoves_(0),
+        kinematicMoves_(0),
+        dynamicMoves_(0),
+        pairs_(0),
+        candidatePairs_(0),
+        overlapTests_(0),
+        updateUSec_(0),
+        pairUSec_(0)
+    {
+    }
+
+    /// Number of broadphase pair updates, one per physics step.
+    unsigned long long steps_;
+    /// Number of bounding box updates submitted to the broadphase, moved or not.
+    unsigned long long aabbUpdates_;
+    /// Number of bounding box updates that moved a static body. Each one pulls the body out of the static part of the
+    /// broadphase.
+    unsigned long long staticMoves_;
+    /// Number of bounding box updates that moved a kinematic body.
+    unsigned long long kinematicMoves_;
+    /// Number of bounding box updates that moved a dynamic body.
+    unsigned long long dynamicMoves_;
+    /// Sum over the steps of the overlapping pairs left after each step.
+    unsigned long long pairs_;
+    /// Number of overlapping bounds the broadphase found and offered to the pair cache, including pairs already there.
+    unsigned long long candidatePairs_;
+    /// Number of proxy pair bounding box tests. Only the grid broadphase reports them; the others test inside Bullet.
+    unsigned long long overlapTests_;
+    /// Time spent updating the bounding boxes of the step, in microseconds.
+    unsigned long long updateUSec_;
+    /// Time spent updating the overlapping pairs of the step, in microseconds.
+    unsigned long long pairUSec_;
+};
+
+/// Scene-level component that selects the broadphase algorithm of the physics world and routes it through a counting
+/// proxy, to measure per physics step how many body bounds the broadphase has to update and of which kind of body, how
+/// many pairs it finds and how long it takes. The counts are shown in the debug HUD. Changing the algorithm moves the
+/// existing bodies over to the new broadphase, but is cheapest before the bodies are created.
+class PhysicsBroadphase : public Component
+{
+    OBJECT(PhysicsBroadphase);
+
+public:
+    /// Construct.
+    PhysicsBroadphase(Context* context);
+    /// Destruct. Gives the physics world its own broadphase back.
+    virtual ~PhysicsBroadphase();
+
+    /// Register object factory.
+    static void RegisterObject(Context* context);
+
+    /// Set the broadphase algorithm.
+    void SetType(BroadphaseType type);
+    /// Set the world bounds of the axis sweep broadphase. Bodies outside are clamped to the bounds and tested coarsely.
+    void SetWorldBounds(const BoundingBox& bounds);
+    /// Set the proxy capacity of the axis sweep broadphase. Raised to twice the body count when it is installed.
+    void SetMaxProxies(unsigned maxProxies);
+    /// Set the cell size of the grid broadphase.
+    void SetCellSize(float size);
+
+    /// Return the broadphase algorithm.
+    BroadphaseType GetType() const { return type_; }
+    /// Return the world bounds of the axis sweep broadphase.
+    const BoundingBox& GetWorldBounds() const { return worldBounds_; }
+    /// Return the proxy capacity of the axis sweep broadphase.
+    unsigned GetMaxProxies() const { return maxProxies_; }
+    /// Return the cell size of the grid broadphase.
+    float GetCellSize() const { return cellSize_; }
+    /// Return the running totals.
+    const BroadphaseCounters& GetCounters() const;
+    /// Return the number of overlapping pairs now.
+    unsigned GetNumPairs() const;
+    /// Return the broadphase doing the work in a physics world, looking through the counting proxy if it is installed.
+    static btBroadphaseInterface* GetWorkingBroadphase(PhysicsWorld* world);
+
+    /// Set the world bounds minimum attribute.
+    void SetWorldBoundsMinAttr(const Vector3& value);
+    /// Return the world bounds minimum attribute.
+    const Vector3& GetWorldBoundsMinAttr() const { return worldBounds_.min_; }
+    /// Set the world bounds maximum attribute.
+    void SetWorldBoundsMaxAttr(const Vector3& value);
+    /// Return the world bounds maximum attribute.
+    const Vector3& GetWorldBoundsMaxAttr() const { return worldBounds_.max_; }
+
+protected:
+    /// Handle node being assigned.
+    virtual void OnNodeSet(Node* node);
+
+private:
+    /// Handle frame end. Updates the debug HUD.
+    void HandleEndFrame(StringHash eventType, VariantMap& eventData);
+    /// Handle physics step start. Starts timing the bounding box updates of the step.
+    void HandlePhysicsPreStep(StringHash eventType, VariantMap& eventData);
+    /// Create the selected broadphase, move the bodies to it and put the counting proxy in front of it.
+    void Install();
+    /// Move the bodies back to the physics world's own broadphase and give it back.
+    void Uninstall();
+    /// Reinstall after a setting of the given broadphase algorithm changed, if it is the one in use.
+    void Reinstall(BroadphaseType type);
+
+    /// Physics world.
+    WeakPtr<PhysicsWorld> physicsWorld_;
+    /// Counting proxy.
+    CountingBroadphase* broadphase_;
+    /// Physics world's own broadphase.
+    btBroadphaseInterface* worldBroadphase_;
+    /// Selected broadphase when it is not the physics world's own.
+    btBroadphaseInterface* ownBroadphase_;
+    /// Broadphase algorithm.
+    BroadphaseType type_;
+    /// Axis sweep world bounds.
+    BoundingBox worldBounds_;
+    /// Axis sweep proxy capacity.
+    unsigned maxProxies_;
+    /// Grid cell size.
+    float cellSize_;
+    /// Totals at the last debug HUD update.
+    BroadphaseCounters hudCounters_;
+    /// Debug HUD update timer.
+    Timer hudTimer_;
+};
@@ -0,0 +1,285 @@
+//
+// Copyright (c) 2008-2015 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include <Urho3D/Container/Sort.h>
+#include <Urho3D/Core/Context.h>
+#include <Urho3D/Physics/PhysicsEvents.h>
+#include <Urho3D/Physics/PhysicsWorld.h>
+#include <Urho3D/Physics/RigidBody.h>
+#include <Urho3D/Scene/Node.h>
+
+#include <Bullet/BulletCollision/CollisionDispatch/btCollisionObject.h>
+#include <Bullet/BulletDynamics/Dynamics/btDiscreteDynamicsWorld.h>
+
+#include "PhysicsContacts.h"
+#include "TraceCapture.h"
+
+#include <Urho3D/DebugNew.h>
+
+static bool CompareManifoldViews(const ContactManifoldView& lhs, const ContactManifoldView& rhs)
+{
+    return lhs.body_ < rhs.body_;
+}
+
+PhysicsContacts::PhysicsContacts(Context* context) :
+    Component(context),
+    dirty_(true),
+    dispatching_(false)
+{
+}
+
+PhysicsContacts::~PhysicsContacts()
+{
+}
+
+void PhysicsContacts::RegisterObject(Context* context)
+{
+    context->RegisterFactory<PhysicsContacts>();
+}
+
+ContactSpan PhysicsContacts::GetContacts(RigidBody* body)
+{
+    if (dirty_)
+        UpdateIndex();
+
+    HashMap<RigidBody*, Pair<unsigned, unsigned> >::ConstIterator i = ranges_.Find(body);
+    if (i == ranges_.End())
+        return ContactSpan();
+
+    const ContactManifoldView* views = views_.Buffer();
+    return ContactSpan(views + i->second_.first_, views + i->second_.second_);
+}
+
+const ContactManifoldView* PhysicsContacts::GetContacts(RigidBody* body, RigidBody* otherBody)
+{
+    ContactSpan contacts = GetContacts(body);
+    for (const ContactManifoldView* i = contacts.Begin(); i != contacts.End(); ++i)
+    {
+        if (i->otherBody_ == otherBody)
+            return i;
+    }
+
+    return 0;
+}
+
+void PhysicsContacts::AddListener(RigidBody* body, CollisionListener* listener)
+{
+    if (!body || !listener)
+        return;
+
+    CollisionListenerEntry entry;
+    entry.body_ = body;
+    entry.listener_ = listener;
+    listeners_.Push(entry);
+}
+
+void PhysicsContacts::RemoveListener(CollisionListener* listener)
+{
+    for (unsigned i = listeners_.Size() - 1; i < listeners_.Size(); --i)
+    {
+        if (listeners_[i].listener_ != listener)
+            continue;
+
+        if (dispatching_)
+            listeners_[i].listener_ = 0;
+        else
+            listeners_.Erase(i);
+    }
+}
+
+unsigned PhysicsContacts::GetNumListeners() const
+{
+    unsigned count = 0;
+    for (unsigned i = 0; i < listeners_.Size(); ++i)
+    {
+        if (listeners_[i].listener_)
+            ++count;
+    }
+
+    return count;
+}
+
+void PhysicsContacts::OnNodeSet(Node* node)
+{
+    if (node)
+    {
+        physicsWorld_ = node->GetComponent<PhysicsWorld>();
+        if (physicsWorld_)
+        {
+            SubscribeToEvent(physicsWorld_, E_PHYSICSPRESTEP, HANDLER(PhysicsContacts, HandlePhysicsPreStep));
+            SubscribeToEvent(physicsWorld_, E_PHYSICSPOSTSTEP, HANDLER(PhysicsContacts, HandlePhysicsPostStep));
+        }
+    }
+    else
+    {
+        UnsubscribeFromAllEvents();
+        physicsWorld_.Reset();
+    }
+
+    views_.Clear();
+    ranges_.Clear();
+    listeners_.Clear();
+    dirty_ = true;
+}
+
+void PhysicsContacts::HandlePhysicsPreStep(StringHash eventType, VariantMap& eventData)
+{
+    // Invalidate before the step changes the manifolds, as the node collision events are sent from within it. The index
+    // is rebuilt on demand, so steps nobody queries cost nothing
+    dirty_ = true;
+}
+
+void PhysicsContacts::HandlePhysicsPostStep(StringHash eventType, VariantMap& eventData)
+{
+    // An index built by a pre-step query is stale by now
+    dirty_ = true;
+
+    if (!listeners_.Empty())
+        DispatchCollisions();
+}
+
+void PhysicsContacts::DispatchCollisions()
+{
+    TRACE_ZONE("PhysicsContacts::DispatchCollisions");
+
+    dispatching_ = true;
+
+    // Index by position and re-check the listener after each call, as listeners may be added or removed from the
+    // callbacks
+    for (unsigned i = 0; i < listeners_.Size(); ++i)
+    {
+        RigidBody* body = listeners_[i].body_;
+        if (!body)
+        {
+            listeners_[i].listener_ = 0;
+            continue;
+        }
+
+        ContactSpan contacts = GetContacts(body);
+        CollisionData collision;
+        collision.body_ = body;
+
+        // Collisions of the last step that have no contact manifold any more have ended
+        for (unsigned j = listeners_[i].touching_.Size() - 1; j < listeners_[i].touching_.Size(); --j)
+        {
+            RigidBody* otherBody = listeners_[i].touching_[j];
+            const ContactManifoldView* manifold = 0;
+            for (const ContactManifoldView* k = contacts.Begin(); k != contacts.End() && otherBody; ++k)
+            {
+                if (k->otherBody_ == otherBody)
+                {
+                    manifold = k;
+                    break;
+                }
+            }
+            if (manifold)
+                continue;
+
+            listeners_[i].touching_.Erase(j);
+            if (listeners_[i].listener_)
+            {
+                collision.otherBody_ = otherBody;
+                collision.otherNode_ = otherBody ? otherBody->GetNode() : 0;
+                collision.manifold_ = 0;
+                listeners_[i].listener_->OnCollisionEnd(collision);
+            }
+        }
+
+        for (const ContactManifoldView* j = contacts.Begin(); j != contacts.End() && listeners_[i].listener_; ++j)
+        {
+            collision.otherBody_ = j->otherBody_;
+            collision.otherNode_ = j->otherBody_->GetNode();
+            collision.manifold_ = j;
+
+            if (listeners_[i].touching_.Contains(WeakPtr<RigidBody>(j->otherBody_)))
+                listeners_[i].listener_->OnCollisionStay(collision);
+            else
+            {
+                listeners_[i].touching_.Push(WeakPtr<RigidBody>(j->otherBody_));
+                listeners_[i].listener_->OnCollisionStart(collision);
+            }
+        }
+    }
+
+    dispatching_ = false;
+
+    for (unsigned i = listeners_.Size() - 1; i < listeners_.Size(); --i)
+    {
+        if (!listeners_[i].listener_)
+            listeners_.Erase(i);
+    }
+}
+
+void PhysicsContacts::UpdateIndex()
+{
+    TRACE_ZONE("PhysicsContacts::UpdateIndex");
+
+    dirty_ = false;
+    views_.Clear();
+    ranges_.Clear();
+
+    if (!physicsWorld_)
+        return;
+
+    btDispatcher* dispatcher = physicsWorld_->GetWorld()->getDispatcher();
+    int numManifolds = dispatcher->getNumManifolds();
+
+    for (int i = 0; i < numManifolds; ++i)
+    {
+        btPersistentManifold* manifold = dispatcher->getManifoldByIndexInternal(i);
+        if (!manifold->getNumContacts())
+            continue;
+
+        RigidBody* bodyA = static_cast<RigidBody*>(manifold->getBody0()->getUserPointer());
+        RigidBody* bodyB = static_cast<RigidBody*>(manifold->getBody1()->getUserPointer());
+        if (!bodyA || !bodyB)
+            continue;
+
+        // One view per body, so that each body sees the manifold with the normals pointing towards itself
+        ContactManifoldView view;
+        view.manifold_ = manifold;
+        view.body_ = bodyA;
+        view.otherBody_ = bodyB;
+        view.flipped_ = false;
+        views_.Push(view);
+        view.body_ = bodyB;
+        view.otherBody_ = bodyA;
+        view.flipped_ = true;
+        views_.Push(view);
+    }
+
+    if (views_.Empty())
+        return;
+
+    Sort(views_.Begin(), views_.End(), CompareManifoldViews);
+
+    unsigned start = 0;
+    for (unsigned i = 1; i <= views_.Size(); ++i)
+    {
+        if (i == views_.Size() || views_[i].body_ != views_[start].body_)
+        {
+            ranges_[views_[start].body_] = MakePair(start, i);
+            start = i;
+        }
+    }
+}
@@ -0,0 +1,206 @@
+//
+// Copyright (c) 2008-2015 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#pragma once
+
+#include <Urho3D/Container/HashMap.h>
+#include <Urho3D/Physics/PhysicsUtils.h>
+#include <Urho3D/Physics/RigidBody.h>
+#include <Urho3D/Scene/Component.h>
+
+#include <Bullet/BulletCollision/NarrowPhaseCollision/btPersistentManifold.h>
+
+namespace Urho3D
+{
+
+class PhysicsWorld;
+
+}
+
+using namespace Urho3D;
+
+/// Typed view of one contact manifold as seen from one of its bodies. The contact points are read directly from the
+/// physics world without copying. Normals always point towards the viewing body, like in the node collision events.
+struct ContactManifoldView
+{
+    /// Return the other body.
+    RigidBody* GetOtherBody() const { return otherBody_; }
+    /// Return number of contact points.
+    unsigned GetNumContacts() const { return (unsigned)manifold_->getNumContacts(); }
+    /// Return a contact point.
+    const btManifoldPoint& GetContact(unsigned index) const { return manifold_->getContactPoint((int)index); }
+    /// Return contact position in world space.
+    Vector3 GetPosition(unsigned index) const { return ToVector3(GetContact(index).m_positionWorldOnB); }
+    /// Return contact normal in world space, pointing towards the viewing body.
+    Vector3 GetNormal(unsigned index) const
+    {
+        const btVector3& normal = GetContact(index).m_normalWorldOnB;
+        return flipped_ ? -ToVector3(normal) : ToVector3(normal);
+    }
+    /// Return contact distance. Negative when penetrating.
+    float GetDistance(unsigned index) const { return GetContact(index).m_distance1; }
+    /// Return impulse applied at the contact during the last step.
+    float GetImpulse(unsigned index) const { return GetContact(index).m_appliedImpulse; }
+
+    /// Viewing body.
+    RigidBody* body_;
+    /// Other body.
+    RigidBody* otherBody_;
+    /// Bullet contact manifold.
+    const btPersistentManifold* manifold_;
+    /// Whether the viewing body is the second body of the manifold.
+    bool flipped_;
+};
+
+/// Contiguous range of the contact manifolds of one body.
+struct ContactSpan
+{
+    /// Construct empty.
+    ContactSpan() :
+        begin_(0),
+        end_(0)
+    {
+    }
+
+    /// Construct from a range.
+    ContactSpan(const ContactManifoldView* begin, const ContactManifoldView* end) :
+        begin_(begin),
+        end_(end)
+    {
+    }
+
+    /// Return number of manifolds.
+    unsigned Size() const { return (unsigned)(end_ - begin_); }
+    /// Return whether there are no manifolds.
+    bool Empty() const { return begin_ == end_; }
+    /// Return manifold by index.
+    const ContactManifoldView& operator [](unsigned index) const { return begin_[index]; }
+    /// Return iterator to the first manifold.
+    const ContactManifoldView* Begin() const { return begin_; }
+    /// Return iterator past the last manifold.
+    const ContactManifoldView* End() const { return end_; }
+
+    /// First manifold.
+    const ContactManifoldView* begin_;
+    /// Past the last manifold.
+    const ContactManifoldView* end_;
+};
+
+/// Collision of a listened body, delivered to a CollisionListener.
+struct CollisionData
+{
+    /// Listened body.
+    RigidBody* body_;
+    /// Other body.
+    RigidBody* otherBody_;
+    /// Scene node of the other body.
+    Node* otherNode_;
+    /// Contact manifold between the bodies. Null when the collision ended.
+    const ContactManifoldView* manifold_;
+};
+
+/// Typed collision callback interface. Registered with PhysicsContacts for one rigid body and called directly after each
+/// physics step, without going through the event system.
+class CollisionListener
+{
+public:
+    /// Destruct.
+    virtual ~CollisionListener() {}
+
+    /// Handle a collision that started on this physics step.
+    virtual void OnCollisionStart(const CollisionData& collision) {}
+    /// Handle a collision that persisted from an earlier physics step.
+    virtual void OnCollisionStay(const CollisionData& collision) {}
+    /// Handle a collision that ended on this physics step. The other body and node are null if they were destroyed.
+    virtual void OnCollisionEnd(const CollisionData& collision) {}
+};
+
+/// Registration of a collision listener.
+struct CollisionListenerEntry
+{
+    /// Listened body.
+    WeakPtr<RigidBody> body_;
+    /// Listener. Null when unregistered during dispatch.
+    CollisionListener* listener_;
+    /// Bodies in contact on the last physics step.
+    Vector<WeakPtr<RigidBody> > touching_;
+};
+
+/// Scene-level index of the current contact manifolds of the physics world by rigid body. Lets components iterate the
+/// contacts of their body as typed structs straight from the physics world, instead of parsing collision event payloads.
+/// The index is rebuilt lazily on the first query after each physics step starts, and the returned spans stay valid until
+/// the next physics step starts. Bullet updates and releases the manifolds during the step, before the physics world sends
+/// the node collision events, so queries from those see the contacts of the step being finished. Queries from physics
+/// pre-step handlers see the previous step's contacts. Collision listeners registered here replace the node collision events; with no listeners nothing is
+/// dispatched at all.
+class PhysicsContacts : public Component
+{
+    OBJECT(PhysicsContacts);
+
+public:
+    /// Construct.
+    PhysicsContacts(Context* context);
+    /// Destruct.
+    virtual ~PhysicsContacts();
+
+    /// Register object factory.
+    static void RegisterObject(Context* context);
+
+    /// Return the contact manifolds of a body that have at least one contact point.
+    ContactSpan GetContacts(RigidBody* body);
+    /// Return the contact manifold between two bodies, or null if they are not in contact.
+    const ContactManifoldView* GetContacts(RigidBody* body, RigidBody* otherBody);
+    /// Register a collision listener for a body.
+    void AddListener(RigidBody* body, CollisionListener* listener);
+    /// Unregister a collision listener. Safe to call from the listener's own callbacks.
+    void RemoveListener(CollisionListener* listener);
+
+    /// Return number of registered collision listeners.
+    unsigned GetNumListeners() const;
+
+protected:
+    /// Handle node being assigned.
+    virtual void OnNodeSet(Node* node);
+
+private:
+    /// Handle physics pre-step event.
+    void HandlePhysicsPreStep(StringHash eventType, VariantMap& eventData);
+    /// Handle physics post-step event.
+    void HandlePhysicsPostStep(StringHash eventType, VariantMap& eventData);
+    /// Rebuild the index from the physics world.
+    void UpdateIndex();
+    /// Compare the current contacts of the listened bodies against the last step and call the listeners.
+    void DispatchCollisions();
+
+    /// Physics world.
+    WeakPtr<PhysicsWorld> physicsWorld_;
+    /// Manifold views sorted by viewing body.
+    PODVector<ContactManifoldView> views_;
+    /// Range of views by viewing body.
+    HashMap<RigidBody*, Pair<unsigned, unsigned> > ranges_;
+    /// Registered collision listeners.
+    Vector<CollisionListenerEntry> listeners_;
+    /// Index needs rebuilding flag.
+    bool dirty_;
+    /// Dispatching collisions flag. Listeners removed meanwhile are only cleared and erased afterwards.
+    bool dispatching_;
+};
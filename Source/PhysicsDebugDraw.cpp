@@ -0,0 +1,321 @@
+//
+// Copyright (c) 2008-2015 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include <Urho3D/Core/Context.h>
+#include <Urho3D/Core/Timer.h>
+#include <Urho3D/Graphics/Camera.h>
+#include <Urho3D/Graphics/DebugRenderer.h>
+#include <Urho3D/Math/Sphere.h>
+#include <Urho3D/Physics/PhysicsUtils.h>
+#include <Urho3D/Physics/PhysicsWorld.h>
+#include <Urho3D/Scene/Node.h>
+
+#include <Bullet/BulletDynamics/Dynamics/btDiscreteDynamicsWorld.h>
+#include <Bullet/LinearMath/btIDebugDraw.h>
+
+#include "PhysicsDebugDraw.h"
+
+#include <Urho3D/DebugNew.h>
+
+/// Debug drawer that records the lines of one collision object instead of rendering them.
+class PhysicsDebugRecorder : public btIDebugDraw
+{
+public:
+    PhysicsDebugRecorder(PODVector<PhysicsDebugLine>& lines) :
+        lines_(lines)
+    {
+    }
+
+    virtual void drawLine(const btVector3& from, const btVector3& to, const btVector3& color)
+    {
+        PhysicsDebugLine line;
+        line.start_ = ToVector3(from);
+        line.end_ = ToVector3(to);
+        line.color_ = Color(color.x(), color.y(), color.z()).ToUInt();
+        lines_.Push(line);
+    }
+
+    virtual void drawContactPoint(const btVector3& pointOnB, const btVector3& normalOnB, btScalar distance, int lifeTime,
+        const btVector3& color)
+    {
+    }
+
+    virtual void reportErrorWarning(const char* warningString) {}
+    virtual void draw3dText(const btVector3& location, const char* textString) {}
+    virtual void setDebugMode(int debugMode) {}
+    virtual int getDebugMode() const { return DBG_DrawWireframe; }
+
+private:
+    /// Recorded lines.
+    PODVector<PhysicsDebugLine>& lines_;
+};
+
+/// Broadphase callback that collects the rigid bodies whose bounding boxes pass a sphere and/or frustum test.
+struct PhysicsDebugQuery : public btBroadphaseAabbCallback
+{
+    PhysicsDebugQuery(PODVector<RigidBody*>& bodies, const Sphere* sphere, const Frustum* frustum) :
+        bodies_(bodies),
+        sphere_(sphere),
+        frustum_(frustum)
+    {
+    }
+
+    virtual bool process(const btBroadphaseProxy* proxy)
+    {
+        BoundingBox box(ToVector3(proxy->m_aabbMin), ToVector3(proxy->m_aabbMax));
+        if ((sphere_ && sphere_->IsInsideFast(box) != OUTSIDE) || (frustum_ && frustum_->IsInsideFast(box) != OUTSIDE))
+        {
+            btCollisionObject* object = static_cast<btCollisionObject*>(proxy->m_clientObject);
+            RigidBody* body = static_cast<RigidBody*>(object->getUserPointer());
+            if (body)
+                bodies_.Push(body);
+        }
+
+        return true;
+    }
+
+    /// Collected bodies.
+    PODVector<RigidBody*>& bodies_;
+    /// Sphere test, or null.
+    const Sphere* sphere_;
+    /// Frustum test, or null.
+    const Frustum* frustum_;
+};
+
+/// Return the debug color of a collision object by activation state, like btCollisionWorld::debugDrawWorld().
+static btVector3 GetActivationColor(int activationState)
+{
+    switch (activationState)
+    {
+    case ACTIVE_TAG:
+        return btVector3(1.0f, 1.0f, 1.0f);
+
+    case ISLAND_SLEEPING:
+        return btVector3(0.0f, 1.0f, 0.0f);
+
+    case WANTS_DEACTIVATION:
+        return btVector3(0.0f, 1.0f, 1.0f);
+
+    case DISABLE_DEACTIVATION:
+        return btVector3(1.0f, 0.0f, 0.0f);
+
+    case DISABLE_SIMULATION:
+        return btVector3(1.0f, 1.0f, 0.0f);
+
+    default:
+        return btVector3(1.0f, 0.0f, 0.0f);
+    }
+}
+
+PhysicsDebugDraw::PhysicsDebugDraw(Context* context) :
+    Component(context),
+    mode_(PHYSICS_DEBUG_FILTERED),
+    radius_(DEFAULT_PHYSICS_DEBUG_RADIUS),
+    frameNumber_(0),
+    numDrawnBodies_(0),
+    numRegeneratedBodies_(0),
+    numDrawnLines_(0),
+    lastDrawTime_(0.0f)
+{
+}
+
+PhysicsDebugDraw::~PhysicsDebugDraw()
+{
+}
+
+void PhysicsDebugDraw::RegisterObject(Context* context)
+{
+    context->RegisterFactory<PhysicsDebugDraw>();
+}
+
+void PhysicsDebugDraw::Draw(DebugRenderer* debug, bool depthTest)
+{
+    HiresTimer timer;
+
+    numDrawnBodies_ = 0;
+    numRegeneratedBodies_ = 0;
+    numDrawnLines_ = 0;
+
+    if (!debug || !physicsWorld_ || mode_ == PHYSICS_DEBUG_OFF)
+    {
+        lastDrawTime_ = 0.0f;
+        return;
+    }
+
+    ++frameNumber_;
+
+    CollectBodies();
+    for (unsigned i = 0; i < bodies_.Size(); ++i)
+        DrawBody(bodies_[i], debug, depthTest);
+
+    // Drop the lines of bodies that have been destroyed or have not been drawn for a while
+    for (HashMap<RigidBody*, PhysicsDebugBodyCache>::Iterator i = cache_.Begin(); i != cache_.End();)
+    {
+        if (!i->second_.body_ || frameNumber_ - i->second_.lastFrame_ > PHYSICS_DEBUG_CACHE_FRAMES)
+            i = cache_.Erase(i);
+        else
+            ++i;
+    }
+
+    lastDrawTime_ = timer.GetUSec(false) / 1000.0f;
+}
+
+void PhysicsDebugDraw::SetMode(PhysicsDebugMode mode)
+{
+    mode_ = mode;
+    if (mode_ == PHYSICS_DEBUG_OFF)
+        ClearCache();
+}
+
+void PhysicsDebugDraw::CycleMode()
+{
+    SetMode((PhysicsDebugMode)((mode_ + 1) % MAX_PHYSICS_DEBUG_MODES));
+}
+
+void PhysicsDebugDraw::SetFocusNode(Node* node)
+{
+    focusNode_ = node;
+}
+
+void PhysicsDebugDraw::SetRadius(float radius)
+{
+    radius_ = Max(radius, 0.0f);
+}
+
+void PhysicsDebugDraw::SetCamera(Camera* camera)
+{
+    camera_ = camera;
+}
+
+void PhysicsDebugDraw::ClearCache()
+{
+    cache_.Clear();
+}
+
+Camera* PhysicsDebugDraw::GetCamera() const
+{
+    return camera_;
+}
+
+void PhysicsDebugDraw::OnNodeSet(Node* node)
+{
+    if (node)
+        physicsWorld_ = node->GetScene()->GetOrCreateComponent<PhysicsWorld>();
+    else
+        physicsWorld_.Reset();
+
+    ClearCache();
+}
+
+void PhysicsDebugDraw::CollectBodies()
+{
+    bodies_.Clear();
+
+    btDiscreteDynamicsWorld* world = physicsWorld_->GetWorld();
+
+    if (mode_ == PHYSICS_DEBUG_ALL)
+    {
+        const btCollisionObjectArray& objects = world->getCollisionObjectArray();
+        for (int i = 0; i < objects.size(); ++i)
+        {
+            RigidBody* body = static_cast<RigidBody*>(objects[i]->getUserPointer());
+            if (body)
+                bodies_.Push(body);
+        }
+        return;
+    }
+
+    // Query the broadphase with the box enclosing each test volume, then test the body bounding boxes against the volume
+    if (focusNode_ && radius_ > 0.0f)
+    {
+        Sphere sphere(focusNode_->GetWorldPosition(), radius_);
+        PhysicsDebugQuery query(bodies_, &sphere, 0);
+        BoundingBox box(sphere);
+        world->getBroadphase()->aabbTest(ToBtVector3(box.min_), ToBtVector3(box.max_), query);
+    }
+
+    if (camera_)
+    {
+        const Frustum& frustum = camera_->GetFrustum();
+        PhysicsDebugQuery query(bodies_, 0, &frustum);
+        BoundingBox box(frustum);
+        world->getBroadphase()->aabbTest(ToBtVector3(box.min_), ToBtVector3(box.max_), query);
+    }
+}
+
+void PhysicsDebugDraw::DrawBody(RigidBody* body, DebugRenderer* debug, bool depthTest)
+{
+    btRigidBody* object = body->GetBody();
+    if (!object)
+        return;
+
+    HashMap<RigidBody*, PhysicsDebugBodyCache>::Iterator i = cache_.Find(body);
+    if (i == cache_.End())
+    {
+        i = cache_.Insert(MakePair(body, PhysicsDebugBodyCache()));
+        i->second_.lastFrame_ = 0;
+    }
+
+    PhysicsDebugBodyCache& entry = i->second_;
+
+    // Bodies found by both the sphere and the frustum test are drawn once
+    if (entry.lastFrame_ == frameNumber_)
+        return;
+    entry.lastFrame_ = frameNumber_;
+
+    const btTransform& transform = object->getWorldTransform();
+    const btCollisionShape* shape = object->getCollisionShape();
+    int activationState = object->getActivationState();
+
+    // Regenerate the lines when the body has moved, changed shape or changed activation state. The body pointer is
+    // compared as well, as a destroyed body's address may be reused by a new one
+    if (entry.body_.Get() != body || !(entry.transform_ == transform) || entry.shape_ != shape ||
+        entry.activationState_ != activationState)
+    {
+        entry.body_ = body;
+        entry.transform_ = transform;
+        entry.shape_ = shape;
+        entry.activationState_ = activationState;
+        entry.lines_.Clear();
+
+        if (shape)
+        {
+            btDiscreteDynamicsWorld* world = physicsWorld_->GetWorld();
+            PhysicsDebugRecorder recorder(entry.lines_);
+            btIDebugDraw* drawer = world->getDebugDrawer();
+            world->setDebugDrawer(&recorder);
+            world->debugDrawObject(transform, shape, GetActivationColor(activationState));
+            world->setDebugDrawer(drawer);
+        }
+
+        ++numRegeneratedBodies_;
+    }
+
+    const PhysicsDebugLine* lines = entry.lines_.Buffer();
+    unsigned numLines = entry.lines_.Size();
+    for (unsigned j = 0; j < numLines; ++j)
+        debug->AddLine(lines[j].start_, lines[j].end_, lines[j].color_, depthTest);
+
+    ++numDrawnBodies_;
+    numDrawnLines_ += numLines;
+}
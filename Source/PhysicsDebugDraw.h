@@ -0,0 +1,174 @@
+//
+// Copyright (c) 2008-2015 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#pragma once
+
+#include <Urho3D/Container/HashMap.h>
+#include <Urho3D/Physics/RigidBody.h>
+#include <Urho3D/Scene/Component.h>
+
+#include <Bullet/LinearMath/btTransform.h>
+
+namespace Urho3D
+{
+
+class Camera;
+class DebugRenderer;
+class PhysicsWorld;
+
+}
+
+using namespace Urho3D;
+
+class btCollisionShape;
+
+/// Default radius around the focus node within which bodies are drawn.
+static const float DEFAULT_PHYSICS_DEBUG_RADIUS = 50.0f;
+/// Number of draws a cached body may go undrawn before its lines are dropped.
+static const unsigned PHYSICS_DEBUG_CACHE_FRAMES = 60;
+
+/// Physics debug geometry mode.
+enum PhysicsDebugMode
+{
+    /// No physics debug geometry.
+    PHYSICS_DEBUG_OFF = 0,
+    /// Only bodies near the focus node or inside the camera frustum.
+    PHYSICS_DEBUG_FILTERED,
+    /// All bodies of the world.
+    PHYSICS_DEBUG_ALL,
+    MAX_PHYSICS_DEBUG_MODES
+};
+
+/// Debug line of a cached body.
+struct PhysicsDebugLine
+{
+    /// Start position.
+    Vector3 start_;
+    /// End position.
+    Vector3 end_;
+    /// Color.
+    unsigned color_;
+};
+
+/// Cached debug lines of one rigid body.
+struct PhysicsDebugBodyCache
+{
+    /// Body the lines were generated for. Expired when the body is destroyed, which invalidates the entry.
+    WeakPtr<RigidBody> body_;
+    /// Body world transform the lines were generated for.
+    btTransform transform_;
+    /// Body collision shape the lines were generated for.
+    const btCollisionShape* shape_;
+    /// Body activation state the lines were generated for; it selects the color.
+    int activationState_;
+    /// Frame number when last drawn.
+    unsigned lastFrame_;
+    /// Lines in world space.
+    PODVector<PhysicsDebugLine> lines_;
+};
+
+/// Scene-level physics debug geometry drawer. Unlike PhysicsWorld::DrawDebugGeometry(), which draws the whole world,
+/// it only draws the bodies within a radius of a focus node or inside a camera frustum, found through the broadphase,
+/// and keeps the generated lines of each body until its transform changes.
+class PhysicsDebugDraw : public Component
+{
+    OBJECT(PhysicsDebugDraw);
+
+public:
+    /// Construct.
+    PhysicsDebugDraw(Context* context);
+    /// Destruct.
+    virtual ~PhysicsDebugDraw();
+
+    /// Register object factory.
+    static void RegisterObject(Context* context);
+
+    /// Draw the physics debug geometry according to the mode.
+    void Draw(DebugRenderer* debug, bool depthTest);
+    /// Set mode.
+    void SetMode(PhysicsDebugMode mode);
+    /// Switch to the next mode.
+    void CycleMode();
+    /// Set node around which bodies are drawn in filtered mode.
+    void SetFocusNode(Node* node);
+    /// Set radius around the focus node within which bodies are drawn in filtered mode. Zero disables the radius test.
+    void SetRadius(float radius);
+    /// Set camera whose frustum selects the bodies drawn in filtered mode. Null disables the frustum test.
+    void SetCamera(Camera* camera);
+    /// Drop all cached lines.
+    void ClearCache();
+
+    /// Return mode.
+    PhysicsDebugMode GetMode() const { return mode_; }
+    /// Return focus node.
+    Node* GetFocusNode() const { return focusNode_; }
+    /// Return radius around the focus node.
+    float GetRadius() const { return radius_; }
+    /// Return camera.
+    Camera* GetCamera() const;
+    /// Return number of bodies drawn on the last draw.
+    unsigned GetNumDrawnBodies() const { return numDrawnBodies_; }
+    /// Return number of bodies whose lines were regenerated on the last draw.
+    unsigned GetNumRegeneratedBodies() const { return numRegeneratedBodies_; }
+    /// Return number of lines drawn on the last draw.
+    unsigned GetNumDrawnLines() const { return numDrawnLines_; }
+    /// Return number of cached bodies.
+    unsigned GetNumCachedBodies() const { return cache_.Size(); }
+    /// Return duration of the last draw in milliseconds.
+    float GetLastDrawTime() const { return lastDrawTime_; }
+
+protected:
+    /// Handle node being assigned.
+    virtual void OnNodeSet(Node* node);
+
+private:
+    /// Collect the bodies to draw.
+    void CollectBodies();
+    /// Draw one body, regenerating its cached lines if needed.
+    void DrawBody(RigidBody* body, DebugRenderer* debug, bool depthTest);
+
+    /// Physics world.
+    WeakPtr<PhysicsWorld> physicsWorld_;
+    /// Focus node.
+    WeakPtr<Node> focusNode_;
+    /// Camera.
+    WeakPtr<Camera> camera_;
+    /// Cached lines by body.
+    HashMap<RigidBody*, PhysicsDebugBodyCache> cache_;
+    /// Bodies to draw on the current draw.
+    PODVector<RigidBody*> bodies_;
+    /// Mode.
+    PhysicsDebugMode mode_;
+    /// Radius around the focus node.
+    float radius_;
+    /// Draw counter, used to evict cache entries of bodies that are no longer drawn.
+    unsigned frameNumber_;
+    /// Number of bodies drawn on the last draw.
+    unsigned numDrawnBodies_;
+    /// Number of bodies whose lines were regenerated on the last draw.
+    unsigned numRegeneratedBodies_;
+    /// Number of lines drawn on the last draw.
+    unsigned numDrawnLines_;
+    /// Duration of the last draw in milliseconds.
+    float lastDrawTime_;
+};
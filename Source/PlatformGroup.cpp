@@ -0,0 +1,165 @@
+//
+// Copyright (c) 2008-2015 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#include <Urho3D/Core/Context.h>
+#include <Urho3D/Graphics/Camera.h>
+#include <Urho3D/Graphics/Geometry.h>
+#include <Urho3D/Graphics/OctreeQuery.h>
+#include <Urho3D/Scene/Node.h>
+
+#include "PlatformGroup.h"
+#include "PlatformSystem.h"
+
+#include <Urho3D/DebugNew.h>
+
+PlatformGroup::PlatformGroup(Context* context) :
+    StaticModel(context)
+{
+}
+
+PlatformGroup::~PlatformGroup()
+{
+}
+
+void PlatformGroup::RegisterObject(Context* context)
+{
+    context->RegisterFactory<PlatformGroup>();
+
+    COPY_BASE_ATTRIBUTES(StaticModel);
+}
+
+void PlatformGroup::ProcessRayQuery(const RayOctreeQuery& query, PODVector<RayQueryResult>& results)
+{
+    RayQueryLevel level = query.level_;
+    if (level < RAY_AABB)
+    {
+        Drawable::ProcessRayQuery(query, results);
+        return;
+    }
+
+    // Check the group bounding box first; GetWorldBoundingBox() also applies the instance bounding box
+    if (query.ray_.HitDistance(GetWorldBoundingBox()) >= query.maxDistance_)
+        return;
+
+    PlatformSystem* platformSystem = platformSystem_;
+    for (unsigned i = 0; i < worldTransforms_.Size(); ++i)
+    {
+        const Matrix3x4& transform = worldTransforms_[i];
+        float distance = query.ray_.HitDistance(boundingBox_.Transformed(transform));
+        Vector3 normal = -query.ray_.direction_;
+
+        if (level >= RAY_OBB && distance < query.maxDistance_)
+        {
+            Ray localRay = query.ray_.Transformed(transform.Inverse());
+            distance = localRay.HitDistance(boundingBox_);
+
+            if (level >= RAY_TRIANGLE && distance < query.maxDistance_)
+            {
+                distance = M_INFINITY;
+                for (unsigned j = 0; j < batches_.Size(); ++j)
+                {
+                    Geometry* geometry = batches_[j].geometry_;
+                    if (!geometry)
+                        continue;
+
+                    Vector3 geometryNormal;
+                    float geometryDistance = geometry->GetHitDistance(localRay, &geometryNormal);
+                    if (geometryDistance < query.maxDistance_ && geometryDistance < distance)
+                    {
+                        distance = geometryDistance;
+                        normal = (transform * Vector4(geometryNormal, 0.0f)).Normalized();
+                    }
+                }
+            }
+        }
+
+        if (distance < query.maxDistance_)
+        {
+            // Report the platform node, so that a hit can be told apart from the other platforms of the group
+            unsigned platformIndex = platformIndices_[i];
+            Node* platformNode = platformSystem ? platformSystem->GetPlatformNode(platformIndex) : 0;
+
+            RayQueryResult result;
+            result.position_ = query.ray_.origin_ + distance * query.ray_.direction_;
+            result.normal_ = normal;
+            result.distance_ = distance;
+            result.drawable_ = this;
+            result.node_ = platformNode ? platformNode : node_;
+            result.subObject_ = platformIndex;
+            results.Push(result);
+        }
+    }
+}
+
+void PlatformGroup::UpdateBatches(const FrameInfo& frame)
+{
+    // Getting the world bounding box ensures the instance bounding box is applied
+    const BoundingBox& worldBoundingBox = GetWorldBoundingBox();
+    distance_ = frame.camera_->GetDistance(worldBoundingBox.Center());
+
+    // All batches draw the whole instance array; the renderer turns them into one instanced draw per material
+    const Matrix3x4* transforms = worldTransforms_.Size() ? &worldTransforms_[0] : &Matrix3x4::IDENTITY;
+    for (unsigned i = 0; i < batches_.Size(); ++i)
+    {
+        batches_[i].distance_ = distance_;
+        batches_[i].worldTransform_ = transforms;
+        batches_[i].numWorldTransforms_ = worldTransforms_.Size();
+    }
+}
+
+void PlatformGroup::SetPlatformSystem(PlatformSystem* platformSystem)
+{
+    platformSystem_ = platformSystem;
+}
+
+void PlatformGroup::ClearInstances()
+{
+    worldTransforms_.Clear();
+    platformIndices_.Clear();
+    instancesBoundingBox_.Clear();
+}
+
+void PlatformGroup::AddInstance(unsigned platformIndex, const Matrix3x4& transform)
+{
+    worldTransforms_.Push(transform);
+    platformIndices_.Push(platformIndex);
+    instancesBoundingBox_.Merge(boundingBox_.Transformed(transform));
+}
+
+void PlatformGroup::CommitInstances()
+{
+    // A group whose platforms have all gone stays out of the octree until it gets some again
+    bool enabled = !worldTransforms_.Empty();
+    if (enabled != IsEnabled())
+        SetEnabled(enabled);
+
+    // Make the octree pick up the new bounding box
+    OnMarkedDirty(node_);
+}
+
+void PlatformGroup::OnWorldBoundingBoxUpdate()
+{
+    if (instancesBoundingBox_.Defined())
+        worldBoundingBox_ = instancesBoundingBox_;
+    else
+        worldBoundingBox_.Define(node_->GetWorldPosition(), node_->GetWorldPosition());
+}
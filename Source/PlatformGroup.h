@@ -0,0 +1,84 @@
+//
+// Copyright (c) 2008-2015 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#pragma once
+
+#include <Urho3D/Graphics/StaticModel.h>
+
+using namespace Urho3D;
+
+class PlatformSystem;
+
+/// Drawable for one spatially bounded group of the platforms drawn by a platform renderer. Draws its platforms as instances
+/// of one model from a world transform array refilled every frame, so the octree culls each group by its own bounding box
+/// for both views and shadows, and octree raycasts test the individual platforms. Created on temporary child nodes by
+/// PlatformRenderer, which must be placed on a node with identity transform.
+class PlatformGroup : public StaticModel
+{
+    OBJECT(PlatformGroup);
+
+public:
+    /// Construct.
+    PlatformGroup(Context* context);
+    /// Destruct.
+    virtual ~PlatformGroup();
+
+    /// Register object factory. StaticModel must be registered first.
+    static void RegisterObject(Context* context);
+
+    /// Process octree raycast. Tests each platform instance and reports the platform node. May be called from a worker
+    /// thread.
+    virtual void ProcessRayQuery(const RayOctreeQuery& query, PODVector<RayQueryResult>& results);
+    /// Calculate distance and prepare batches for rendering.
+    virtual void UpdateBatches(const FrameInfo& frame);
+
+    /// Set the platform system whose platform nodes are reported by raycasts.
+    void SetPlatformSystem(PlatformSystem* platformSystem);
+    /// Remove all instances before refilling the group.
+    void ClearInstances();
+    /// Add an instance for a platform by platform index.
+    void AddInstance(unsigned platformIndex, const Matrix3x4& transform);
+    /// Apply the instances added since the last clear. Takes an empty group out of the octree.
+    void CommitInstances();
+
+    /// Return number of instances.
+    unsigned GetNumInstances() const { return worldTransforms_.Size(); }
+    /// Return platform index of an instance.
+    unsigned GetPlatformIndex(unsigned instance) const
+    {
+        return instance < platformIndices_.Size() ? platformIndices_[instance] : M_MAX_UNSIGNED;
+    }
+
+protected:
+    /// Recalculate the world-space bounding box.
+    virtual void OnWorldBoundingBoxUpdate();
+
+private:
+    /// Platform system whose platforms are drawn.
+    WeakPtr<PlatformSystem> platformSystem_;
+    /// Instance world transforms.
+    PODVector<Matrix3x4> worldTransforms_;
+    /// Platform indices of the instances.
+    PODVector<unsigned> platformIndices_;
+    /// Bounding box of all instances.
+    BoundingBox instancesBoundingBox_;
+};
@@ -0,0 +1,251 @@
+//
+// Copyright (c) 2008-2015 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#include <Urho3D/Container/Vector.h>
+#include <Urho3D/Core/Timer.h>
+
+#include "PlatformKernel.h"
+
+#include <cmath>
+
+using namespace Urho3D;
+
+// Range reduction constants. Two pi is split in two parts so that x - k * 2pi stays accurate for moderately large x
+static const float INV_TWO_PI = 0.159154943092f;
+static const float TWO_PI_HI = 6.28125f;
+static const float TWO_PI_LO = 1.93530717958e-3f;
+static const float PI_F = 3.14159265359f;
+static const double INV_TWO_PI_D = 0.15915494309189533577;
+static const double TWO_PI_D = 6.28318530717958647692;
+
+// Taylor coefficients of sin(x) up to x^11
+static const float SIN_C3 = -1.66666666667e-1f;
+static const float SIN_C5 = 8.33333333333e-3f;
+static const float SIN_C7 = -1.98412698413e-4f;
+static const float SIN_C9 = 2.75573192240e-6f;
+static const float SIN_C11 = -2.50521083854e-8f;
+
+unsigned GetPlatformKernelWidth()
+{
+#if defined(PLATFORM_KERNEL_AVX2)
+    return 8;
+#elif defined(PLATFORM_KERNEL_SSE2)
+    return 4;
+#else
+    return 1;
+#endif
+}
+
+const char* GetPlatformKernelName()
+{
+#if defined(PLATFORM_KERNEL_AVX2)
+    return "AVX2";
+#elif defined(PLATFORM_KERNEL_SSE2)
+    return "SSE2";
+#else
+    return "Scalar";
+#endif
+}
+
+float PlatformSin(float x)
+{
+    // Reduce to [-pi, pi], then fold to [-pi/2, pi/2] using sin(pi - a) = sin(a)
+    float k = std::floor(x * INV_TWO_PI + 0.5f);
+    float r = (x - k * TWO_PI_HI) - k * TWO_PI_LO;
+    float a = std::fabs(r);
+    a = a < PI_F - a ? a : PI_F - a;
+    if (r < 0.0f)
+        a = -a;
+
+    float a2 = a * a;
+    float p = SIN_C11;
+    p = p * a2 + SIN_C9;
+    p = p * a2 + SIN_C7;
+    p = p * a2 + SIN_C5;
+    p = p * a2 + SIN_C3;
+    return a + a * a2 * p;
+}
+
+#if defined(PLATFORM_KERNEL_AVX2)
+
+static inline __m256 PlatformSin8(__m256 x)
+{
+    const __m256 signMask = _mm256_set1_ps(-0.0f);
+
+    __m256 k = _mm256_floor_ps(_mm256_add_ps(_mm256_mul_ps(x, _mm256_set1_ps(INV_TWO_PI)), _mm256_set1_ps(0.5f)));
+    __m256 r = _mm256_sub_ps(_mm256_sub_ps(x, _mm256_mul_ps(k, _mm256_set1_ps(TWO_PI_HI))),
+        _mm256_mul_ps(k, _mm256_set1_ps(TWO_PI_LO)));
+    __m256 sign = _mm256_and_ps(r, signMask);
+    __m256 a = _mm256_andnot_ps(signMask, r);
+    a = _mm256_min_ps(a, _mm256_sub_ps(_mm256_set1_ps(PI_F), a));
+    a = _mm256_xor_ps(a, sign);
+
+    __m256 a2 = _mm256_mul_ps(a, a);
+    __m256 p = _mm256_set1_ps(SIN_C11);
+    p = _mm256_add_ps(_mm256_mul_ps(p, a2), _mm256_set1_ps(SIN_C9));
+    p = _mm256_add_ps(_mm256_mul_ps(p, a2), _mm256_set1_ps(SIN_C7));
+    p = _mm256_add_ps(_mm256_mul_ps(p, a2), _mm256_set1_ps(SIN_C5));
+    p = _mm256_add_ps(_mm256_mul_ps(p, a2), _mm256_set1_ps(SIN_C3));
+    return _mm256_add_ps(a, _mm256_mul_ps(_mm256_mul_ps(a, a2), p));
+}
+
+#elif defined(PLATFORM_KERNEL_SSE2)
+
+static inline __m128 PlatformSin4(__m128 x)
+{
+    const __m128 signMask = _mm_set1_ps(-0.0f);
+
+    // SSE2 has no floor; round to nearest through integer conversion instead, which matches floor(x + 0.5) except at
+    // exact halves where either choice stays within [-pi, pi]
+    __m128 k = _mm_cvtepi32_ps(_mm_cvtps_epi32(_mm_mul_ps(x, _mm_set1_ps(INV_TWO_PI))));
+    __m128 r = _mm_sub_ps(_mm_sub_ps(x, _mm_mul_ps(k, _mm_set1_ps(TWO_PI_HI))), _mm_mul_ps(k, _mm_set1_ps(TWO_PI_LO)));
+    __m128 sign = _mm_and_ps(r, signMask);
+    __m128 a = _mm_andnot_ps(signMask, r);
+    a = _mm_min_ps(a, _mm_sub_ps(_mm_set1_ps(PI_F), a));
+    a = _mm_xor_ps(a, sign);
+
+    __m128 a2 = _mm_mul_ps(a, a);
+    __m128 p = _mm_set1_ps(SIN_C11);
+    p = _mm_add_ps(_mm_mul_ps(p, a2), _mm_set1_ps(SIN_C9));
+    p = _mm_add_ps(_mm_mul_ps(p, a2), _mm_set1_ps(SIN_C7));
+    p = _mm_add_ps(_mm_mul_ps(p, a2), _mm_set1_ps(SIN_C5));
+    p = _mm_add_ps(_mm_mul_ps(p, a2), _mm_set1_ps(SIN_C3));
+    return _mm_add_ps(a, _mm_mul_ps(_mm_mul_ps(a, a2), p));
+}
+
+#endif
+
+void EvaluatePlatformKernel(double time, const float* rates, const float* phaseOffsets, const float* amplitudes,
+    const float* biases, float* displacements, unsigned count)
+{
+    unsigned i = 0;
+
+#if defined(PLATFORM_KERNEL_AVX2)
+    __m256d t = _mm256_set1_pd(time);
+    __m256d invTwoPi = _mm256_set1_pd(INV_TWO_PI_D);
+    __m256d twoPi = _mm256_set1_pd(TWO_PI_D);
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256 rate = _mm256_loadu_ps(rates + i);
+        __m256d lo = _mm256_mul_pd(_mm256_cvtps_pd(_mm256_castps256_ps128(rate)), t);
+        __m256d hi = _mm256_mul_pd(_mm256_cvtps_pd(_mm256_extractf128_ps(rate, 1)), t);
+        lo = _mm256_sub_pd(lo, _mm256_mul_pd(_mm256_floor_pd(_mm256_mul_pd(lo, invTwoPi)), twoPi));
+        hi = _mm256_sub_pd(hi, _mm256_mul_pd(_mm256_floor_pd(_mm256_mul_pd(hi, invTwoPi)), twoPi));
+        __m256 phase = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm256_cvtpd_ps(lo)), _mm256_cvtpd_ps(hi), 1);
+
+        __m256 s = PlatformSin8(_mm256_add_ps(phase, _mm256_loadu_ps(phaseOffsets + i)));
+        _mm256_storeu_ps(displacements + i, _mm256_add_ps(_mm256_loadu_ps(biases + i),
+            _mm256_mul_ps(_mm256_loadu_ps(amplitudes + i), s)));
+    }
+#elif defined(PLATFORM_KERNEL_SSE2)
+    __m128d t = _mm_set1_pd(time);
+    __m128d invTwoPi = _mm_set1_pd(INV_TWO_PI_D);
+    __m128d twoPi = _mm_set1_pd(TWO_PI_D);
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 rate = _mm_loadu_ps(rates + i);
+        __m128d lo = _mm_mul_pd(_mm_cvtps_pd(rate), t);
+        __m128d hi = _mm_mul_pd(_mm_cvtps_pd(_mm_movehl_ps(rate, rate)), t);
+        // Round to nearest instead of floor, which leaves the phase in [-pi, pi] instead of [0, 2pi)
+        lo = _mm_sub_pd(lo, _mm_mul_pd(_mm_cvtepi32_pd(_mm_cvtpd_epi32(_mm_mul_pd(lo, invTwoPi))), twoPi));
+        hi = _mm_sub_pd(hi, _mm_mul_pd(_mm_cvtepi32_pd(_mm_cvtpd_epi32(_mm_mul_pd(hi, invTwoPi))), twoPi));
+        __m128 phase = _mm_movelh_ps(_mm_cvtpd_ps(lo), _mm_cvtpd_ps(hi));
+
+        __m128 s = PlatformSin4(_mm_add_ps(phase, _mm_loadu_ps(phaseOffsets + i)));
+        _mm_storeu_ps(displacements + i, _mm_add_ps(_mm_loadu_ps(biases + i), _mm_mul_ps(_mm_loadu_ps(amplitudes + i), s)));
+    }
+#endif
+
+    // Scalar tail, or the whole range when no vector instruction set is available
+    for (; i < count; ++i)
+    {
+        double phase = (double)rates[i] * time;
+        phase -= std::floor(phase * INV_TWO_PI_D) * TWO_PI_D;
+        displacements[i] = biases[i] + amplitudes[i] * PlatformSin((float)phase + phaseOffsets[i]);
+    }
+}
+
+void EvaluatePlatformKernelReference(double time, const float* rates, const float* phaseOffsets, const float* amplitudes,
+    const float* biases, float* displacements, unsigned count)
+{
+    for (unsigned i = 0; i < count; ++i)
+    {
+        float phase = (float)std::fmod((double)rates[i] * time, TWO_PI_D);
+        displacements[i] = biases[i] + amplitudes[i] * std::sin(phase + phaseOffsets[i]);
+    }
+}
+
+PlatformKernelBenchmark BenchmarkPlatformKernel(unsigned count, unsigned iterations)
+{
+    PlatformKernelBenchmark result;
+    result.count_ = count;
+    result.iterations_ = iterations;
+    result.kernelPlatformsPerSecond_ = 0.0;
+    result.referencePlatformsPerSecond_ = 0.0;
+    result.maxError_ = 0.0f;
+
+    if (!count || !iterations)
+        return result;
+
+    // Same layout as the demo scene: odd ids use the sine family, even ids the cosine family
+    PODVector<float> rates(count);
+    PODVector<float> offsets(count);
+    PODVector<float> amplitudes(count);
+    PODVector<float> biases(count);
+    PODVector<float> kernelDisplacements(count);
+    PODVector<float> referenceDisplacements(count);
+    for (unsigned i = 0; i < count; ++i)
+    {
+        rates[i] = 0.2f + (i ? 1.0f / (float)i : 0.0f);
+        offsets[i] = (i % 2) ? PLATFORM_COSINE_PHASE_OFFSET : 0.0f;
+        amplitudes[i] = (i % 2) ? -5.0f : 3.5f;
+        biases[i] = (i % 2) ? 5.0f : 0.0f;
+    }
+
+    const double timeStep = 1.0 / 60.0;
+    HiresTimer timer;
+
+    timer.Reset();
+    for (unsigned j = 0; j < iterations; ++j)
+        EvaluatePlatformKernel(j * timeStep, &rates[0], &offsets[0], &amplitudes[0], &biases[0], &kernelDisplacements[0], count);
+    long long kernelUSec = timer.GetUSec(false);
+
+    timer.Reset();
+    for (unsigned j = 0; j < iterations; ++j)
+        EvaluatePlatformKernelReference(j * timeStep, &rates[0], &offsets[0], &amplitudes[0], &biases[0],
+            &referenceDisplacements[0], count);
+    long long referenceUSec = timer.GetUSec(false);
+
+    double total = (double)count * (double)iterations;
+    result.kernelPlatformsPerSecond_ = total * 1000000.0 / (double)(kernelUSec > 0 ? kernelUSec : 1);
+    result.referencePlatformsPerSecond_ = total * 1000000.0 / (double)(referenceUSec > 0 ? referenceUSec : 1);
+
+    // Both paths ended at the same simulation time, so the final displacements are directly comparable
+    for (unsigned i = 0; i < count; ++i)
+    {
+        float error = std::fabs(kernelDisplacements[i] - referenceDisplacements[i]) / std::fabs(amplitudes[i]);
+        if (error > result.maxError_)
+            result.maxError_ = error;
+    }
+
+    return result;
+}
@@ -0,0 +1,76 @@
+//
+// Copyright (c) 2008-2015 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#pragma once
+
+#if defined(__AVX2__)
+#define PLATFORM_KERNEL_AVX2
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PLATFORM_KERNEL_SSE2
+#include <emmintrin.h>
+#endif
+
+/// Phase offset that turns the sine evaluation into a cosine: cos(x) = sin(x + pi/2).
+static const float PLATFORM_COSINE_PHASE_OFFSET = 1.57079632679f;
+
+/// Maximum absolute error of PlatformSin() against the exact sine for arguments within +-PLATFORM_KERNEL_MAX_PHASE.
+/// The degree 11 polynomial truncation error on [-pi/2, pi/2] is (pi/2)^13 / 13! ~= 5.7e-8; float rounding in the range
+/// reduction and Horner evaluation brings the measured total to about 2.8e-7.
+static const float PLATFORM_KERNEL_MAX_ERROR = 3.0e-7f;
+/// Largest phase magnitude for which PLATFORM_KERNEL_MAX_ERROR holds. Beyond it the range reduction loses precision.
+static const float PLATFORM_KERNEL_MAX_PHASE = 8192.0f;
+
+/// Return the number of platforms the kernel evaluates per instruction.
+unsigned GetPlatformKernelWidth();
+/// Return the name of the instruction set the kernel was compiled for.
+const char* GetPlatformKernelName();
+
+/// Scalar polynomial sine, identical to one lane of the vectorized kernel.
+float PlatformSin(float x);
+
+/// Evaluate biases + amplitudes * sin(rates * time + phaseOffsets) into displacements. The phase rates * time is formed
+/// and wrapped to one period in double precision, so the result does not degrade with long simulation times. The cosine
+/// family is expressed with a phase offset, so there is no per-platform branch.
+void EvaluatePlatformKernel(double time, const float* rates, const float* phaseOffsets, const float* amplitudes,
+    const float* biases, float* displacements, unsigned count);
+/// Reference implementation of EvaluatePlatformKernel() using std::fmod and std::sin.
+void EvaluatePlatformKernelReference(double time, const float* rates, const float* phaseOffsets, const float* amplitudes,
+    const float* biases, float* displacements, unsigned count);
+
+/// Platform kernel microbenchmark result.
+struct PlatformKernelBenchmark
+{
+    /// Number of platforms per iteration.
+    unsigned count_;
+    /// Number of iterations.
+    unsigned iterations_;
+    /// Throughput of the vectorized kernel in platforms per second.
+    double kernelPlatformsPerSecond_;
+    /// Throughput of the std::sin reference in platforms per second.
+    double referencePlatformsPerSecond_;
+    /// Maximum absolute difference between kernel and reference displacements, divided by amplitude.
+    float maxError_;
+};
+
+/// Run the platform kernel microbenchmark.
+PlatformKernelBenchmark BenchmarkPlatformKernel(unsigned count, unsigned iterations);
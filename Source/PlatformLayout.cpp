@@ -0,0 +1,180 @@
+//
+// Copyright (c) 2008-2015 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#include <Urho3D/Core/StringUtils.h>
+#include <Urho3D/IO/Deserializer.h>
+#include <Urho3D/IO/Serializer.h>
+#include <Urho3D/Math/MathDefs.h>
+#include <Urho3D/Math/Random.h>
+
+#include "PlatformLayout.h"
+#include "PlatformPrototype.h"
+#include "PlatformSystem.h"
+
+/// Size of the parameters written by PlatformLayout::Write().
+static const unsigned PLATFORM_LAYOUT_SIZE = 68;
+
+PlatformLayout::PlatformLayout() :
+    count_(60),
+    columns_(1),
+    spacing_(44.0f, 4.0f),
+    jitter_(10.0f),
+    minSize_(40.0f, 1.0f, 3.0f),
+    maxSize_(40.0f, 1.0f, 3.0f),
+    kinematicRatio_(0.5f),
+    lodDistances_(150.0f, 300.0f),
+    lodInterval_(4),
+    lodHysteresis_(10.0f),
+    seed_(0)
+{
+}
+
+bool PlatformLayout::SetOption(const String& name, const String& value)
+{
+    // Vector values may be given either space or comma separated
+    String values = value.Replaced(',', ' ');
+
+    if (name == "platforms")
+        count_ = ToUInt(value);
+    else if (name == "platformcolumns")
+        columns_ = Max(ToUInt(value), 1U);
+    else if (name == "platformspacing")
+        spacing_ = ToVector2(values);
+    else if (name == "platformjitter")
+        jitter_ = Max(ToFloat(value), 0.0f);
+    else if (name == "platformminsize")
+        minSize_ = ToVector3(values);
+    else if (name == "platformmaxsize")
+        maxSize_ = ToVector3(values);
+    else if (name == "platformkinematic")
+        kinematicRatio_ = Clamp(ToFloat(value), 0.0f, 1.0f);
+    else if (name == "platformbodies")
+    {
+        // Named body modes: every platform kinematic, the original interleave, or every platform a moved static body
+        String mode = value.ToLower();
+        if (mode == "kinematic")
+            kinematicRatio_ = 1.0f;
+        else if (mode == "mixed")
+            kinematicRatio_ = 0.5f;
+        else if (mode == "static")
+            kinematicRatio_ = 0.0f;
+        else
+            return false;
+    }
+    else if (name == "platformlod")
+        lodDistances_ = ToVector2(values);
+    else if (name == "platformlodinterval")
+        lodInterval_ = Max(ToUInt(value), 1U);
+    else if (name == "platformlodhysteresis")
+        lodHysteresis_ = Max(ToFloat(value), 0.0f);
+    else if (name == "seed")
+        seed_ = ToUInt(value);
+    else
+        return false;
+
+    return true;
+}
+
+Vector3 PlatformLayout::GetGridPosition(unsigned index) const
+{
+    unsigned row = index / columns_;
+    unsigned column = index % columns_;
+    return Vector3(((float)column - (columns_ - 1) * 0.5f) * spacing_.x_, 0.0f, row * spacing_.y_);
+}
+
+bool PlatformLayout::Write(Serializer& dest) const
+{
+    bool success = true;
+    success &= dest.WriteUInt(count_);
+    success &= dest.WriteUInt(columns_);
+    success &= dest.WriteVector2(spacing_);
+    success &= dest.WriteFloat(jitter_);
+    success &= dest.WriteVector3(minSize_);
+    success &= dest.WriteVector3(maxSize_);
+    success &= dest.WriteFloat(kinematicRatio_);
+    success &= dest.WriteVector2(lodDistances_);
+    success &= dest.WriteUInt(lodInterval_);
+    success &= dest.WriteFloat(lodHysteresis_);
+    success &= dest.WriteUInt(seed_);
+    return success;
+}
+
+bool PlatformLayout::Read(Deserializer& source)
+{
+    unsigned start = source.GetPosition();
+    count_ = source.ReadUInt();
+    columns_ = Max(source.ReadUInt(), 1U);
+    spacing_ = source.ReadVector2();
+    jitter_ = source.ReadFloat();
+    minSize_ = source.ReadVector3();
+    maxSize_ = source.ReadVector3();
+    kinematicRatio_ = source.ReadFloat();
+    lodDistances_ = source.ReadVector2();
+    lodInterval_ = Max(source.ReadUInt(), 1U);
+    lodHysteresis_ = source.ReadFloat();
+    seed_ = source.ReadUInt();
+    return source.GetPosition() - start == PLATFORM_LAYOUT_SIZE;
+}
+
+BoundingBox PlatformLayout::GetBounds(float margin) const
+{
+    unsigned rows = Max((count_ + columns_ - 1) / columns_, 1U);
+    float halfWidth = (columns_ - 1) * 0.5f * spacing_.x_;
+    Vector3 extent = Vector3(jitter_, 0.0f, 0.0f) + maxSize_ * 0.5f + Vector3(margin, margin, margin);
+    return BoundingBox(Vector3(-halfWidth, 0.0f, 0.0f) - extent, Vector3(halfWidth, 0.0f, (rows - 1) * spacing_.y_) + extent);
+}
+
+bool PlatformLayout::IsKinematic(unsigned index) const
+{
+    // Kinematic whenever the running count of kinematic platforms reaches the next integer; a ratio of 0.5 gives the
+    // odd indices like the original demo
+    return (unsigned)((index + 1) * kinematicRatio_) > (unsigned)(index * kinematicRatio_);
+}
+
+void PlatformLayout::CreatePlatforms(Scene* scene, PlatformSystem* platformSystem) const
+{
+    if (seed_)
+        SetRandomSeed(seed_);
+    bool randomSize = minSize_ != maxSize_;
+
+    // Generate the whole layout first, then create the platforms from it in bulk
+    PODVector<Vector3> positions(count_);
+    PODVector<Vector3> scales(count_);
+    PODVector<unsigned char> kinematic(count_);
+
+    for (unsigned i = 0; i < count_; ++i)
+    {
+        positions[i] = GetGridPosition(i) + Vector3(Random(-jitter_, jitter_), 0.0f, 0.0f);
+        scales[i] = minSize_;
+        if (randomSize)
+        {
+            // Evaluated one axis at a time, so that the random sequence does not depend on the argument evaluation order
+            scales[i].x_ = Random(minSize_.x_, maxSize_.x_);
+            scales[i].y_ = Random(minSize_.y_, maxSize_.y_);
+            scales[i].z_ = Random(minSize_.z_, maxSize_.z_);
+        }
+        kinematic[i] = IsKinematic(i) ? 1 : 0;
+    }
+
+    if (count_)
+        PlatformPrototype().Instantiate(scene, platformSystem, count_, &positions[0], &scales[0], &kinematic[0]);
+}
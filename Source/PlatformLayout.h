@@ -0,0 +1,94 @@
+//
+// Copyright (c) 2008-2015 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#pragma once
+
+#include <Urho3D/Container/Str.h>
+#include <Urho3D/Math/BoundingBox.h>
+#include <Urho3D/Math/Vector2.h>
+#include <Urho3D/Math/Vector3.h>
+
+namespace Urho3D
+{
+
+class Deserializer;
+class Scene;
+class Serializer;
+
+}
+
+using namespace Urho3D;
+
+class PlatformSystem;
+
+/// Layout bounds margin that covers the platforms at the far ends of their travel, which reaches 60 units along X.
+static const float PLATFORM_TRAVEL_MARGIN = 64.0f;
+
+/// Parameters of the generated moving platform field. The defaults reproduce the original demo scene: a single row of
+/// 60 platforms along Z at 4 unit spacing, every other one kinematic.
+struct PlatformLayout
+{
+    /// Construct with the default layout.
+    PlatformLayout();
+
+    /// Set a parameter from a command line option name (without the leading dash) and value. Return true if the option
+    /// was recognized.
+    bool SetOption(const String& name, const String& value);
+    /// Return position of a platform before the random X jitter is added.
+    Vector3 GetGridPosition(unsigned index) const;
+    /// Return the bounds of the layout: the platform grid widened by the jitter, the largest platform size and a margin
+    /// for the platform travel.
+    BoundingBox GetBounds(float margin) const;
+    /// Return whether a platform should have a kinematic body.
+    bool IsKinematic(unsigned index) const;
+    /// Write the parameters to a stream. Return true on success.
+    bool Write(Serializer& dest) const;
+    /// Read the parameters from a stream. Return true on success.
+    bool Read(Deserializer& source);
+    /// Create the platform nodes of the layout in a scene and register them with the platform system. Reseeds the random
+    /// generator first if a seed is set.
+    void CreatePlatforms(Scene* scene, PlatformSystem* platformSystem) const;
+
+    /// Number of platforms.
+    unsigned count_;
+    /// Number of columns along X. Platforms fill the rows along Z.
+    unsigned columns_;
+    /// Spacing between columns (X) and rows (Y, applied along Z).
+    Vector2 spacing_;
+    /// Random X offset range, applied as Random(-jitter, jitter).
+    float jitter_;
+    /// Minimum platform scale.
+    Vector3 minSize_;
+    /// Maximum platform scale. Each axis is drawn uniformly between the minimum and maximum.
+    Vector3 maxSize_;
+    /// Fraction of platforms with kinematic bodies, evenly interleaved. The rest are static bodies that are moved.
+    float kinematicRatio_;
+    /// Distances from the nearest character or camera beyond which platforms update at reduced rate (X) and freeze (Y).
+    /// Zero disables the tier.
+    Vector2 lodDistances_;
+    /// Number of frames between the updates of a reduced rate platform.
+    unsigned lodInterval_;
+    /// Distance by which a platform must cross a tier threshold before it changes tier.
+    float lodHysteresis_;
+    /// Random seed. Zero leaves the random generator as it is.
+    unsigned seed_;
+};
@@ -0,0 +1,71 @@
+//
+// Copyright (c) 2008-2015 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#include <Urho3D/Physics/CollisionShape.h>
+#include <Urho3D/Scene/Scene.h>
+
+#include "PlatformPrototype.h"
+#include "PlatformSystem.h"
+
+PlatformPrototype::PlatformPrototype() :
+    name_("Platform"),
+    // Collision layer bit 2 marks world scenery; collisions go to the collision listeners instead of events
+    collisionLayer_(2),
+    collisionEventMode_(COLLISION_NEVER),
+    friction_(1.0f),
+    shapeSize_(Vector3::ONE)
+{
+}
+
+Node* PlatformPrototype::CreateNode(Scene* scene, const Vector3& position, const Vector3& scale, bool kinematic) const
+{
+    Node* node = scene->CreateChild(name_);
+    node->SetTransform(position, Quaternion::IDENTITY, scale);
+
+    // The shape goes first, so that the body builds its compound shape once when it is added to the world instead of
+    // again for the shape added afterwards
+    CollisionShape* shape = node->CreateComponent<CollisionShape>();
+    shape->SetBox(shapeSize_);
+    RigidBody* body = node->CreateComponent<RigidBody>();
+    body->SetCollisionLayer(collisionLayer_);
+    body->SetCollisionEventMode(collisionEventMode_);
+    body->SetFriction(friction_);
+    if (kinematic)
+        body->SetKinematic(true);
+
+    return node;
+}
+
+unsigned PlatformPrototype::Instantiate(Scene* scene, PlatformSystem* platformSystem, unsigned count, const Vector3* positions,
+    const Vector3* scales, const unsigned char* kinematic, const int* ids, const Vector3* axes) const
+{
+    unsigned first = platformSystem->GetNumPlatforms();
+    platformSystem->Reserve(first + count);
+
+    for (unsigned i = 0; i < count; ++i)
+    {
+        Node* node = CreateNode(scene, positions[i], scales[i], kinematic[i] != 0);
+        platformSystem->AddPlatform(node, ids ? ids[i] : (int)(first + i), axes ? axes[i] : Vector3::RIGHT, positions[i]);
+    }
+
+    return first;
+}
@@ -0,0 +1,67 @@
+//
+// Copyright (c) 2008-2015 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#pragma once
+
+#include <Urho3D/Container/Str.h>
+#include <Urho3D/Math/Vector3.h>
+#include <Urho3D/Physics/RigidBody.h>
+
+namespace Urho3D
+{
+
+class Scene;
+
+}
+
+using namespace Urho3D;
+
+class PlatformSystem;
+
+/// Template of a moving platform node. Holds the node and physics settings shared by all platforms, so that any number
+/// of platforms can be created from arrays of per-platform values in one call, with the platform system storage sized
+/// once up front. Platforms have no drawable of their own; the PlatformRenderer draws them all from one model.
+struct PlatformPrototype
+{
+    /// Construct with the settings of the demo platforms.
+    PlatformPrototype();
+
+    /// Create one platform node with its physics components. It is not registered with the platform system.
+    Node* CreateNode(Scene* scene, const Vector3& position, const Vector3& scale, bool kinematic) const;
+    /// Create count platform nodes and register them with the platform system. The arrays hold one value per platform;
+    /// a nonzero kinematic flag gives a kinematic body. Without ids the platforms are numbered from their index, and without
+    /// axes they move along the default axis. The positions are the positions at time zero. Return the index of the first
+    /// new platform.
+    unsigned Instantiate(Scene* scene, PlatformSystem* platformSystem, unsigned count, const Vector3* positions,
+        const Vector3* scales, const unsigned char* kinematic, const int* ids = 0, const Vector3* axes = 0) const;
+
+    /// Node name.
+    String name_;
+    /// Collision layer of the rigid body.
+    unsigned collisionLayer_;
+    /// Collision event mode of the rigid body.
+    CollisionEventMode collisionEventMode_;
+    /// Friction of the rigid body.
+    float friction_;
+    /// Size of the box collision shape, before the node scale.
+    Vector3 shapeSize_;
+};
@@ -0,0 +1,282 @@
+//
+// Copyright (c) 2008-2015 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include <Urho3D/Core/Context.h>
+#include <Urho3D/Core/Timer.h>
+#include <Urho3D/Graphics/Material.h>
+#include <Urho3D/Graphics/Model.h>
+#include <Urho3D/Resource/ResourceCache.h>
+#include <Urho3D/Scene/Node.h>
+#include <Urho3D/Scene/Scene.h>
+#include <Urho3D/Scene/SceneEvents.h>
+
+#include "PlatformGroup.h"
+#include "PlatformRenderer.h"
+#include "PlatformSystem.h"
+#include "TraceCapture.h"
+
+#include <Urho3D/DebugNew.h>
+
+/// Cell coordinate limit, to fit the three coordinates in a 64-bit key.
+static const int MAX_GROUP_COORD = (1 << 20) - 1;
+
+static unsigned long long MakeGroupKey(const Vector3& position, float invGroupSize)
+{
+    int x = (int)floorf(Clamp(position.x_ * invGroupSize, (float)-MAX_GROUP_COORD, (float)MAX_GROUP_COORD));
+    int y = (int)floorf(Clamp(position.y_ * invGroupSize, (float)-MAX_GROUP_COORD, (float)MAX_GROUP_COORD));
+    int z = (int)floorf(Clamp(position.z_ * invGroupSize, (float)-MAX_GROUP_COORD, (float)MAX_GROUP_COORD));
+    return ((unsigned long long)(x & 0x1fffff) << 42) | ((unsigned long long)(y & 0x1fffff) << 21) |
+        (unsigned long long)(z & 0x1fffff);
+}
+
+PlatformRenderer::PlatformRenderer(Context* context) :
+    Component(context),
+    groupSize_(DEFAULT_PLATFORM_GROUP_SIZE),
+    castShadows_(false),
+    lastPrepareTime_(0.0f)
+{
+}
+
+PlatformRenderer::~PlatformRenderer()
+{
+}
+
+void PlatformRenderer::RegisterObject(Context* context)
+{
+    context->RegisterFactory<PlatformRenderer>(GEOMETRY_CATEGORY);
+
+    ACCESSOR_ATTRIBUTE("Is Enabled", IsEnabled, SetEnabled, bool, true, AM_DEFAULT);
+    MIXED_ACCESSOR_ATTRIBUTE("Model", GetModelAttr, SetModelAttr, ResourceRef, ResourceRef(Model::GetTypeStatic()), AM_DEFAULT);
+    MIXED_ACCESSOR_ATTRIBUTE("Material", GetMaterialAttr, SetMaterialAttr, ResourceRef, ResourceRef(Material::GetTypeStatic()),
+        AM_DEFAULT);
+    ACCESSOR_ATTRIBUTE("Cast Shadows", GetCastShadows, SetCastShadows, bool, false, AM_DEFAULT);
+    ACCESSOR_ATTRIBUTE("Group Size", GetGroupSize, SetGroupSize, float, DEFAULT_PLATFORM_GROUP_SIZE, AM_DEFAULT);
+}
+
+void PlatformRenderer::SetPlatformSystem(PlatformSystem* platformSystem)
+{
+    platformSystem_ = platformSystem;
+    for (unsigned i = 0; i < groups_.Size(); ++i)
+    {
+        if (groups_[i])
+            groups_[i]->SetPlatformSystem(platformSystem);
+    }
+
+    // Platform indices of another system say nothing about the grouping
+    platformNodes_.Clear();
+    platformGroups_.Clear();
+    PrepareInstances();
+}
+
+void PlatformRenderer::SetModel(Model* model)
+{
+    model_ = model;
+    for (unsigned i = 0; i < groups_.Size(); ++i)
+    {
+        if (groups_[i])
+        {
+            groups_[i]->SetModel(model);
+            // Setting the model resets the materials
+            groups_[i]->SetMaterial(material_);
+        }
+    }
+}
+
+void PlatformRenderer::SetMaterial(Material* material)
+{
+    material_ = material;
+    for (unsigned i = 0; i < groups_.Size(); ++i)
+    {
+        if (groups_[i])
+            groups_[i]->SetMaterial(material);
+    }
+}
+
+void PlatformRenderer::SetCastShadows(bool enable)
+{
+    castShadows_ = enable;
+    for (unsigned i = 0; i < groups_.Size(); ++i)
+    {
+        if (groups_[i])
+            groups_[i]->SetCastShadows(enable);
+    }
+}
+
+void PlatformRenderer::SetGroupSize(float size)
+{
+    size = Max(size, M_EPSILON);
+    if (size == groupSize_)
+        return;
+
+    groupSize_ = size;
+    RemoveGroups();
+}
+
+void PlatformRenderer::PrepareInstances()
+{
+    TRACE_ZONE("PlatformRenderer::PrepareInstances");
+
+    HiresTimer timer;
+
+    unsigned count = platformSystem_ ? platformSystem_->GetNumPlatforms() : 0;
+    unsigned oldCount = platformNodes_.Size();
+    platformNodes_.Resize(count);
+    platformGroups_.Resize(count);
+    platformRotations_.Resize(count);
+    platformScales_.Resize(count);
+    for (unsigned i = oldCount; i < count; ++i)
+        platformNodes_[i] = 0;
+
+    for (unsigned i = 0; i < groups_.Size(); ++i)
+    {
+        if (groups_[i])
+            groups_[i]->ClearInstances();
+    }
+
+    // Only the position comes from the platform motion state, interpolated between the last two physics steps. Rotation
+    // and scale never change after a platform is created, so they are read from its node, which is a child of the scene,
+    // only when a slot gets a new node, together with grouping the platform by its base position. The nodes are otherwise
+    // only compared, not dereferenced
+    float factor = platformSystem_ ? platformSystem_->GetInterpolationFactor() : 1.0f;
+    Node** platformNodes = platformNodes_.Buffer();
+    unsigned* platformGroups = platformGroups_.Buffer();
+    Quaternion* platformRotations = platformRotations_.Buffer();
+    Vector3* platformScales = platformScales_.Buffer();
+    for (unsigned i = 0; i < count; ++i)
+    {
+        Node* platformNode = platformSystem_->GetPlatformNode(i);
+        if (platformNodes[i] != platformNode)
+        {
+            platformNodes[i] = platformNode;
+            platformGroups[i] = GetGroupIndex(platformSystem_->GetPlatformBasePosition(i));
+            platformRotations[i] = platformNode->GetRotation();
+            platformScales[i] = platformNode->GetScale();
+        }
+
+        PlatformGroup* group = groups_[platformGroups[i]];
+        if (!group)
+            continue;
+
+        Vector3 position = platformSystem_->GetPlatformPreviousPosition(i).Lerp(platformSystem_->GetPlatformPosition(i),
+            factor);
+        group->AddInstance(i, Matrix3x4(position, platformRotations[i], platformScales[i]));
+    }
+
+    for (unsigned i = 0; i < groups_.Size(); ++i)
+    {
+        if (groups_[i])
+            groups_[i]->CommitInstances();
+    }
+
+    lastPrepareTime_ = timer.GetUSec(false) / 1000.0f;
+}
+
+PlatformSystem* PlatformRenderer::GetPlatformSystem() const
+{
+    return platformSystem_;
+}
+
+void PlatformRenderer::SetModelAttr(const ResourceRef& value)
+{
+    ResourceCache* cache = GetSubsystem<ResourceCache>();
+    SetModel(cache->GetResource<Model>(value.name_));
+}
+
+ResourceRef PlatformRenderer::GetModelAttr() const
+{
+    return GetResourceRef(model_, Model::GetTypeStatic());
+}
+
+void PlatformRenderer::SetMaterialAttr(const ResourceRef& value)
+{
+    ResourceCache* cache = GetSubsystem<ResourceCache>();
+    SetMaterial(cache->GetResource<Material>(value.name_));
+}
+
+ResourceRef PlatformRenderer::GetMaterialAttr() const
+{
+    return GetResourceRef(material_, Material::GetTypeStatic());
+}
+
+void PlatformRenderer::OnNodeSet(Node* node)
+{
+    if (node)
+    {
+        Scene* scene = GetScene();
+        if (scene)
+            SubscribeToEvent(scene, E_SCENEPOSTUPDATE, HANDLER(PlatformRenderer, HandleScenePostUpdate));
+    }
+    else
+    {
+        UnsubscribeFromEvent(E_SCENEPOSTUPDATE);
+        RemoveGroups();
+    }
+}
+
+void PlatformRenderer::HandleScenePostUpdate(StringHash eventType, VariantMap& eventData)
+{
+    if (IsEnabledEffective())
+        PrepareInstances();
+}
+
+unsigned PlatformRenderer::GetGroupIndex(const Vector3& position)
+{
+    unsigned long long key = MakeGroupKey(position, 1.0f / groupSize_);
+    HashMap<unsigned long long, unsigned>::ConstIterator i = groupIndices_.Find(key);
+    if (i != groupIndices_.End())
+        return i->second_;
+
+    // The groups are not saved with the scene; they are rebuilt from the platform system after loading
+    unsigned index = groups_.Size();
+    PlatformGroup* group = 0;
+    if (node_)
+    {
+        Node* groupNode = node_->CreateChild("PlatformGroup", LOCAL);
+        groupNode->SetTemporary(true);
+        group = groupNode->CreateComponent<PlatformGroup>();
+        group->SetPlatformSystem(platformSystem_);
+        group->SetModel(model_);
+        group->SetMaterial(material_);
+        group->SetCastShadows(castShadows_);
+    }
+
+    groups_.Push(WeakPtr<PlatformGroup>(group));
+    groupIndices_[key] = index;
+    return index;
+}
+
+void PlatformRenderer::RemoveGroups()
+{
+    for (unsigned i = 0; i < groups_.Size(); ++i)
+    {
+        if (groups_[i] && groups_[i]->GetNode())
+            groups_[i]->GetNode()->Remove();
+    }
+
+    groups_.Clear();
+    groupIndices_.Clear();
+    platformNodes_.Clear();
+    platformGroups_.Clear();
+    platformRotations_.Clear();
+    platformScales_.Clear();
+}
@@ -0,0 +1,138 @@
+//
+// Copyright (c) 2008-2015 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#pragma once
+
+#include <Urho3D/Container/HashMap.h>
+#include <Urho3D/Scene/Component.h>
+
+namespace Urho3D
+{
+
+class Material;
+class Model;
+
+}
+
+using namespace Urho3D;
+
+class PlatformGroup;
+class PlatformSystem;
+
+/// Default edge length of the cells the platforms are grouped by.
+static const float DEFAULT_PLATFORM_GROUP_SIZE = 64.0f;
+
+/// Renders all moving platforms of a platform system as instances of one model, so the platform nodes need no drawable of
+/// their own. The platforms are grouped by the cell of their base position, and each group is one instanced drawable on a
+/// temporary child node, so that views and shadows only draw the groups they see. The instance transforms are filled from
+/// the platform motion state once per frame. Must be placed on a node with identity transform.
+class PlatformRenderer : public Component
+{
+    OBJECT(PlatformRenderer);
+
+public:
+    /// Construct.
+    PlatformRenderer(Context* context);
+    /// Destruct.
+    virtual ~PlatformRenderer();
+
+    /// Register object factory.
+    static void RegisterObject(Context* context);
+
+    /// Set the platform system to render.
+    void SetPlatformSystem(PlatformSystem* platformSystem);
+    /// Set the model to draw each platform with.
+    void SetModel(Model* model);
+    /// Set the material of all geometries.
+    void SetMaterial(Material* material);
+    /// Set whether the platforms cast shadows.
+    void SetCastShadows(bool enable);
+    /// Set the edge length of the cells the platforms are grouped by. Regroups the platforms.
+    void SetGroupSize(float size);
+    /// Fill the instance transforms and the group bounding boxes from the platform motion state. Called once per frame
+    /// after the scene update.
+    void PrepareInstances();
+
+    /// Return the platform system.
+    PlatformSystem* GetPlatformSystem() const;
+    /// Return the model.
+    Model* GetModel() const { return model_; }
+    /// Return the material.
+    Material* GetMaterial() const { return material_; }
+    /// Return whether the platforms cast shadows.
+    bool GetCastShadows() const { return castShadows_; }
+    /// Return the edge length of the cells the platforms are grouped by.
+    float GetGroupSize() const { return groupSize_; }
+    /// Return number of instances.
+    unsigned GetNumInstances() const { return platformNodes_.Size(); }
+    /// Return number of groups.
+    unsigned GetNumGroups() const { return groups_.Size(); }
+    /// Return duration of the last instance preparation in milliseconds.
+    float GetLastPrepareTime() const { return lastPrepareTime_; }
+
+    /// Set model attribute.
+    void SetModelAttr(const ResourceRef& value);
+    /// Return model attribute.
+    ResourceRef GetModelAttr() const;
+    /// Set material attribute.
+    void SetMaterialAttr(const ResourceRef& value);
+    /// Return material attribute.
+    ResourceRef GetMaterialAttr() const;
+
+protected:
+    /// Handle node being assigned.
+    virtual void OnNodeSet(Node* node);
+
+private:
+    /// Handle scene post-update event.
+    void HandleScenePostUpdate(StringHash eventType, VariantMap& eventData);
+    /// Return the group of a base position, creating it if needed.
+    unsigned GetGroupIndex(const Vector3& position);
+    /// Remove all groups and their nodes. The platforms are regrouped on the next preparation.
+    void RemoveGroups();
+
+    /// Platform system to render.
+    WeakPtr<PlatformSystem> platformSystem_;
+    /// Model.
+    SharedPtr<Model> model_;
+    /// Material.
+    SharedPtr<Material> material_;
+    /// Group drawables.
+    Vector<WeakPtr<PlatformGroup> > groups_;
+    /// Group index by cell.
+    HashMap<unsigned long long, unsigned> groupIndices_;
+    /// Platform nodes as of the last grouping, indexed by platform index. A different node in a slot is regrouped.
+    PODVector<Node*> platformNodes_;
+    /// Group index by platform index.
+    PODVector<unsigned> platformGroups_;
+    /// Platform node rotations, read when a slot gets a new node.
+    PODVector<Quaternion> platformRotations_;
+    /// Platform node scales, read when a slot gets a new node.
+    PODVector<Vector3> platformScales_;
+    /// Cell edge length.
+    float groupSize_;
+    /// Cast shadows flag.
+    bool castShadows_;
+    /// Duration of the last instance preparation in milliseconds.
+    float lastPrepareTime_;
+};
@@ -0,0 +1,770 @@
+//
+// Copyright (c) 2008-2015 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#include <Urho3D/Core/Context.h>
+#include <Urho3D/Core/Timer.h>
+#include <Urho3D/Core/WorkQueue.h>
+#include <Urho3D/IO/MemoryBuffer.h>
+#include <Urho3D/IO/VectorBuffer.h>
+#include <Urho3D/Physics/PhysicsEvents.h>
+#include <Urho3D/Physics/PhysicsWorld.h>
+#include <Urho3D/Physics/RigidBody.h>
+#include <Urho3D/Scene/Node.h>
+#include <Urho3D/Scene/Scene.h>
+#include <Urho3D/Scene/SceneEvents.h>
+
+#include "PlatformKernel.h"
+#include "PlatformSystem.h"
+#include "TraceCapture.h"
+
+#include <Urho3D/DebugNew.h>
+
+/// Phase advance per second shared by all platforms.
+static const float BASE_PHASE_RATE = 1.0f / 5.0f;
+/// Per-frame displacement amplitude of the sine family (odd ids).
+static const float SINE_AMPLITUDE = 10.0f / 100.0f;
+/// Per-frame displacement amplitude of the cosine family (even ids).
+static const float COSINE_AMPLITUDE = 7.0f / 100.0f;
+/// Frame rate at which the per-frame amplitudes above are defined. The closed-form trajectory moves the platforms as the
+/// per-frame integration used to at this rate, independent of the actual frame rate.
+static const float REFERENCE_FRAME_RATE = 60.0f;
+/// Default tier threshold hysteresis distance.
+static const float DEFAULT_LOD_HYSTERESIS = 10.0f;
+/// Default number of updates between the updates of a reduced rate platform.
+static const unsigned DEFAULT_REDUCED_INTERVAL = 4;
+/// Default number of updates over which the LOD tiers of all platforms are refreshed once.
+static const unsigned DEFAULT_LOD_REFRESH_INTERVAL = 4;
+/// Default minimum number of due platforms before an update is spread over the worker threads.
+static const unsigned DEFAULT_MIN_PARALLEL_PLATFORMS = 2048;
+/// Platforms per cache line worth of a float state array. Work chunks start on multiples of this, which is also a multiple
+/// of the kernel width, so every platform is evaluated in the same vector lane as on a single thread.
+static const unsigned PLATFORM_CHUNK_ALIGNMENT = 64 / sizeof(float);
+
+static void EvaluatePlatformsWork(const WorkItem* item, unsigned threadIndex)
+{
+    PlatformSystem* platformSystem = static_cast<PlatformSystem*>(item->aux_);
+    platformSystem->EvaluatePlatforms((unsigned)(size_t)item->start_, (unsigned)(size_t)item->end_);
+}
+
+static void EvaluateListedPlatformsWork(const WorkItem* item, unsigned threadIndex)
+{
+    PlatformSystem* platformSystem = static_cast<PlatformSystem*>(item->aux_);
+    platformSystem->EvaluateListedPlatforms((unsigned)(size_t)item->start_, (unsigned)(size_t)item->end_);
+}
+
+PlatformSystem::PlatformSystem(Context* context) :
+    Component(context),
+    platformsDirty_(false),
+    reducedDistance_(0.0f),
+    frozenDistance_(0.0f),
+    lodHysteresis_(DEFAULT_LOD_HYSTERESIS),
+    reducedInterval_(DEFAULT_REDUCED_INTERVAL),
+    lodRefreshInterval_(DEFAULT_LOD_REFRESH_INTERVAL),
+    lodRefreshStart_(0),
+    numUpdates_(0),
+    numUpdatedPlatforms_(0),
+    minParallelPlatforms_(DEFAULT_MIN_PARALLEL_PLATFORMS),
+    maxThreads_(0),
+    lastUpdateThreads_(0),
+    lastEvaluateTime_(0.0f),
+    time_(0.0),
+    stepAccumulator_(0.0f),
+    stepTimeStep_(0.0f),
+    lastUpdateTime_(0.0f),
+    allPlatformsMoved_(true)
+{
+    for (unsigned i = 0; i < MAX_PLATFORM_LOD_TIERS; ++i)
+        tierCounts_[i] = 0;
+}
+
+PlatformSystem::~PlatformSystem()
+{
+}
+
+void PlatformSystem::RegisterObject(Context* context)
+{
+    context->RegisterFactory<PlatformSystem>();
+
+    ACCESSOR_ATTRIBUTE("Is Enabled", IsEnabled, SetEnabled, bool, true, AM_DEFAULT);
+    ACCESSOR_ATTRIBUTE("Time", GetTime, SetTimeAttr, double, 0.0, AM_DEFAULT);
+    ATTRIBUTE("Reduced Distance", float, reducedDistance_, 0.0f, AM_DEFAULT);
+    ATTRIBUTE("Frozen Distance", float, frozenDistance_, 0.0f, AM_DEFAULT);
+    ATTRIBUTE("LOD Hysteresis", float, lodHysteresis_, DEFAULT_LOD_HYSTERESIS, AM_DEFAULT);
+    ATTRIBUTE("Reduced Interval", unsigned, reducedInterval_, DEFAULT_REDUCED_INTERVAL, AM_DEFAULT);
+    ATTRIBUTE("LOD Refresh Interval", unsigned, lodRefreshInterval_, DEFAULT_LOD_REFRESH_INTERVAL, AM_DEFAULT);
+    MIXED_ACCESSOR_ATTRIBUTE("Platform Nodes", GetPlatformNodesAttr, SetPlatformNodesAttr, VariantVector,
+        Variant::emptyVariantVector, AM_DEFAULT | AM_NODEIDVECTOR);
+    MIXED_ACCESSOR_ATTRIBUTE("Platform Data", GetPlatformDataAttr, SetPlatformDataAttr, PODVector<unsigned char>,
+        Variant::emptyBuffer, AM_DEFAULT | AM_NOEDIT);
+}
+
+void PlatformSystem::ApplyAttributes()
+{
+    if (!platformsDirty_)
+        return;
+
+    platformsDirty_ = false;
+
+    Scene* scene = GetScene();
+    if (!scene)
+        return;
+
+    // The node IDs have been remapped by now, so the platform nodes can be looked up
+    RemoveAllPlatforms();
+
+    MemoryBuffer data(platformDataAttr_);
+    unsigned numPlatforms = platformNodesAttr_.Size() ? platformNodesAttr_[0].GetUInt() : 0;
+    for (unsigned i = 0; i < numPlatforms && i + 1 < platformNodesAttr_.Size() && !data.IsEof(); ++i)
+    {
+        int id = data.ReadInt();
+        Vector3 axis = data.ReadVector3();
+        Vector3 basePosition = data.ReadVector3();
+
+        Node* node = scene->GetNode(platformNodesAttr_[i + 1].GetUInt());
+        if (node)
+            AddPlatform(node, id, axis, basePosition);
+    }
+
+    platformNodesAttr_.Clear();
+    platformDataAttr_.Clear();
+
+    SetTime(time_);
+}
+
+unsigned PlatformSystem::AddPlatform(Node* node, int id, const Vector3& axis)
+{
+    return node ? AddPlatform(node, id, axis, node->GetPosition()) : M_MAX_UNSIGNED;
+}
+
+unsigned PlatformSystem::AddPlatform(Node* node, int id, const Vector3& axis, const Vector3& basePosition)
+{
+    if (!node)
+        return M_MAX_UNSIGNED;
+
+    unsigned existing = GetPlatformIndex(node);
+    if (existing != M_MAX_UNSIGNED)
+        return existing;
+
+    unsigned index = nodes_.Size();
+    bool sine = (id % 2) != 0;
+
+    // Platform 0 would divide by zero, so it only gets the shared rate
+    float rate = BASE_PHASE_RATE + (id ? 1.0f / (float)id : 0.0f);
+    // The platform velocity is speed * sin(rate * t) for the sine family and speed * cos(rate * t) for the cosine family.
+    // Integrated from zero that gives scale * (1 - cos(rate * t)) and scale * sin(rate * t); both are written as
+    // bias + amplitude * sin(rate * t + offset) so that the kernel evaluates them without a branch
+    float scale = (sine ? SINE_AMPLITUDE : COSINE_AMPLITUDE) * REFERENCE_FRAME_RATE / rate;
+
+    ids_.Push(id);
+    rates_.Push(rate);
+    phaseOffsets_.Push(sine ? PLATFORM_COSINE_PHASE_OFFSET : 0.0f);
+    amplitudes_.Push(sine ? -scale : scale);
+    biases_.Push(sine ? scale : 0.0f);
+    displacements_.Push(0.0f);
+    basePositions_.Push(basePosition);
+    positions_.Push(node->GetPosition());
+    previousPositions_.Push(node->GetPosition());
+    axes_.Push(axis);
+    nodes_.Push(node);
+    bodies_.Push(node->GetComponent<RigidBody>());
+    tiers_.Push(PLATFORM_LOD_FULL);
+    nodeIndices_[node->GetID()] = index;
+
+    return index;
+}
+
+void PlatformSystem::RemovePlatform(Node* node)
+{
+    unsigned index = GetPlatformIndex(node);
+    if (index != M_MAX_UNSIGNED)
+        RemovePlatformAt(index);
+}
+
+void PlatformSystem::Reserve(unsigned numPlatforms)
+{
+    ids_.Reserve(numPlatforms);
+    rates_.Reserve(numPlatforms);
+    phaseOffsets_.Reserve(numPlatforms);
+    amplitudes_.Reserve(numPlatforms);
+    biases_.Reserve(numPlatforms);
+    displacements_.Reserve(numPlatforms);
+    basePositions_.Reserve(numPlatforms);
+    positions_.Reserve(numPlatforms);
+    previousPositions_.Reserve(numPlatforms);
+    axes_.Reserve(numPlatforms);
+    nodes_.Reserve(numPlatforms);
+    bodies_.Reserve(numPlatforms);
+    tiers_.Reserve(numPlatforms);
+}
+
+void PlatformSystem::RemoveAllPlatforms()
+{
+    ids_.Clear();
+    rates_.Clear();
+    phaseOffsets_.Clear();
+    amplitudes_.Clear();
+    biases_.Clear();
+    displacements_.Clear();
+    basePositions_.Clear();
+    positions_.Clear();
+    previousPositions_.Clear();
+    axes_.Clear();
+    nodes_.Clear();
+    bodies_.Clear();
+    tiers_.Clear();
+    nodeIndices_.Clear();
+}
+
+void PlatformSystem::Update(float timeStep)
+{
+    TRACE_ZONE("PlatformSystem::Update");
+
+    HiresTimer timer;
+
+    time_ += timeStep;
+
+    if (IsLodEnabled())
+        UpdateScheduled();
+    else
+    {
+        UpdateAllPlatforms();
+
+        for (unsigned i = 0; i < tiers_.Size(); ++i)
+            tiers_[i] = PLATFORM_LOD_FULL;
+        tierCounts_[PLATFORM_LOD_FULL] = nodes_.Size();
+        tierCounts_[PLATFORM_LOD_REDUCED] = 0;
+        tierCounts_[PLATFORM_LOD_FROZEN] = 0;
+        numUpdatedPlatforms_ += nodes_.Size();
+    }
+
+    ++numUpdates_;
+    lastUpdateTime_ += timer.GetUSec(false) / 1000.0f;
+}
+
+void PlatformSystem::SetTime(double time)
+{
+    time_ = time;
+    UpdateAllPlatforms();
+    // A jump in time is not interpolated
+    previousPositions_ = positions_;
+}
+
+void PlatformSystem::UpdatePlatforms(unsigned start, unsigned end)
+{
+    if (end > nodes_.Size())
+        end = nodes_.Size();
+    if (start >= end)
+        return;
+
+    EvaluatePlatforms(start, end);
+
+    for (unsigned i = start; i < end; ++i)
+        CommitPlatform(i);
+
+    // The moved platforms are not known to the next scheduled update, so it resets all previous positions
+    allPlatformsMoved_ = true;
+}
+
+void PlatformSystem::SetMinParallelPlatforms(unsigned count)
+{
+    minParallelPlatforms_ = Max(count, 1U);
+}
+
+void PlatformSystem::SetMaxThreads(unsigned count)
+{
+    maxThreads_ = count;
+}
+
+void PlatformSystem::EvaluatePlatforms(unsigned start, unsigned end)
+{
+    TRACE_ZONE("PlatformSystem::EvaluatePlatforms");
+
+    // Evaluate the displacement of all platforms in the range first, several per instruction, then apply them
+    EvaluatePlatformKernel(time_, &rates_[start], &phaseOffsets_[start], &amplitudes_[start], &biases_[start],
+        &displacements_[start], end - start);
+
+    const float* displacements = displacements_.Buffer();
+    const Vector3* basePositions = basePositions_.Buffer();
+    const Vector3* axes = axes_.Buffer();
+    Vector3* positions = positions_.Buffer();
+
+    for (unsigned i = start; i < end; ++i)
+        positions[i] = basePositions[i] + axes[i] * displacements[i];
+}
+
+void PlatformSystem::EvaluateListedPlatforms(unsigned start, unsigned end)
+{
+    TRACE_ZONE("PlatformSystem::EvaluateListedPlatforms");
+
+    EvaluatePlatformKernel(time_, &updateRates_[start], &updatePhaseOffsets_[start], &updateAmplitudes_[start],
+        &updateBiases_[start], &updateDisplacements_[start], end - start);
+
+    const unsigned* indices = updateIndices_.Buffer();
+    const float* updateDisplacements = updateDisplacements_.Buffer();
+    float* displacements = displacements_.Buffer();
+    const Vector3* basePositions = basePositions_.Buffer();
+    const Vector3* axes = axes_.Buffer();
+    Vector3* positions = positions_.Buffer();
+
+    for (unsigned i = start; i < end; ++i)
+    {
+        unsigned index = indices[i];
+        displacements[index] = updateDisplacements[i];
+        positions[index] = basePositions[index] + axes[index] * updateDisplacements[i];
+    }
+}
+
+void PlatformSystem::AddObserver(Node* node)
+{
+    if (node && !observers_.Contains(WeakPtr<Node>(node)))
+        observers_.Push(WeakPtr<Node>(node));
+}
+
+void PlatformSystem::RemoveObserver(Node* node)
+{
+    observers_.Remove(WeakPtr<Node>(node));
+}
+
+void PlatformSystem::RemoveAllObservers()
+{
+    observers_.Clear();
+}
+
+void PlatformSystem::SetLodDistances(float reducedDistance, float frozenDistance)
+{
+    reducedDistance_ = Max(reducedDistance, 0.0f);
+    frozenDistance_ = Max(frozenDistance, 0.0f);
+}
+
+void PlatformSystem::SetLodHysteresis(float distance)
+{
+    lodHysteresis_ = Max(distance, 0.0f);
+}
+
+void PlatformSystem::SetReducedInterval(unsigned interval)
+{
+    reducedInterval_ = Max(interval, 1U);
+}
+
+void PlatformSystem::SetLodRefreshInterval(unsigned interval)
+{
+    lodRefreshInterval_ = Max(interval, 1U);
+}
+
+float PlatformSystem::GetInterpolationFactor() const
+{
+    PhysicsWorld* physicsWorld = physicsWorld_;
+    if (!physicsWorld || !physicsWorld->GetInterpolation() || stepTimeStep_ <= 0.0f)
+        return 1.0f;
+
+    return Clamp(stepAccumulator_ / stepTimeStep_, 0.0f, 1.0f);
+}
+
+Vector3 PlatformSystem::GetPlatformPosition(unsigned index, double time) const
+{
+    if (index >= nodes_.Size())
+        return Vector3::ZERO;
+
+    float displacement;
+    EvaluatePlatformKernel(time, &rates_[index], &phaseOffsets_[index], &amplitudes_[index], &biases_[index], &displacement, 1);
+    return basePositions_[index] + axes_[index] * displacement;
+}
+
+Vector3 PlatformSystem::GetPlatformVelocity(unsigned index, double time) const
+{
+    if (index >= nodes_.Size())
+        return Vector3::ZERO;
+
+    // Derivative of amplitude * sin(rate * t + offset) is amplitude * rate * sin(rate * t + offset + pi/2)
+    float derivativeOffset = phaseOffsets_[index] + PLATFORM_COSINE_PHASE_OFFSET;
+    float derivativeAmplitude = amplitudes_[index] * rates_[index];
+    float zero = 0.0f;
+    float speed;
+    EvaluatePlatformKernel(time, &rates_[index], &derivativeOffset, &derivativeAmplitude, &zero, &speed, 1);
+    return axes_[index] * speed;
+}
+
+void PlatformSystem::SetPlatformNodesAttr(const VariantVector& value)
+{
+    platformNodesAttr_ = value;
+    platformsDirty_ = true;
+}
+
+const VariantVector& PlatformSystem::GetPlatformNodesAttr() const
+{
+    // Node IDs that have been set but not applied yet are returned as they are
+    if (platformsDirty_)
+        return platformNodesAttr_;
+
+    platformNodesAttr_.Clear();
+    platformNodesAttr_.Reserve(nodes_.Size() + 1);
+    platformNodesAttr_.Push(nodes_.Size());
+    for (unsigned i = 0; i < nodes_.Size(); ++i)
+        platformNodesAttr_.Push(nodes_[i]->GetID());
+
+    return platformNodesAttr_;
+}
+
+void PlatformSystem::SetPlatformDataAttr(const PODVector<unsigned char>& value)
+{
+    platformDataAttr_ = value;
+    platformsDirty_ = true;
+}
+
+PODVector<unsigned char> PlatformSystem::GetPlatformDataAttr() const
+{
+    if (platformsDirty_)
+        return platformDataAttr_;
+
+    VectorBuffer data;
+    for (unsigned i = 0; i < nodes_.Size(); ++i)
+    {
+        data.WriteInt(ids_[i]);
+        data.WriteVector3(axes_[i]);
+        data.WriteVector3(basePositions_[i]);
+    }
+
+    return data.GetBuffer();
+}
+
+unsigned PlatformSystem::GetPlatformIndex(Node* node) const
+{
+    if (!node)
+        return M_MAX_UNSIGNED;
+
+    HashMap<unsigned, unsigned>::ConstIterator i = nodeIndices_.Find(node->GetID());
+    return i != nodeIndices_.End() ? i->second_ : M_MAX_UNSIGNED;
+}
+
+void PlatformSystem::UpdateScheduled()
+{
+    TRACE_ZONE("PlatformSystem::UpdateScheduled");
+
+    // Observers that went away are dropped here rather than tracked through events; the camera is usually not in the scene
+    observerPositions_.Clear();
+    for (unsigned i = observers_.Size() - 1; i < observers_.Size(); --i)
+    {
+        if (observers_[i])
+            observerPositions_.Push(observers_[i]->GetWorldPosition());
+        else
+            observers_.Erase(i);
+    }
+
+    unsigned count = nodes_.Size();
+    unsigned numObservers = observerPositions_.Size();
+    const Vector3* observerPositions = observerPositions_.Buffer();
+    const Vector3* positions = positions_.Buffer();
+    unsigned char* tiers = tiers_.Buffer();
+
+    unsigned tierCounts[MAX_PLATFORM_LOD_TIERS] = { 0, 0, 0 };
+
+    // Platforms evaluated on the last update stand still from now on unless they are due again, so their render
+    // interpolation start catches up with them; the due ones get theirs set when they are evaluated. The others already
+    // have it equal to their position, so the scheduled updates touch no previous positions of platforms that are not due
+    if (allPlatformsMoved_)
+    {
+        previousPositions_ = positions_;
+        allPlatformsMoved_ = false;
+    }
+    else
+    {
+        Vector3* previousPositions = previousPositions_.Buffer();
+        const unsigned* indices = updateIndices_.Buffer();
+        for (unsigned i = 0; i < updateIndices_.Size(); ++i)
+        {
+            // A platform may have been removed since
+            if (indices[i] < count)
+                previousPositions[indices[i]] = positions[indices[i]];
+        }
+    }
+
+    updateIndices_.Clear();
+
+    // The distance tests against the observers cost much more than evaluating a platform, so only one slice of the
+    // platforms is refreshed per update. The hysteresis is wide compared to how far anything moves meanwhile
+    unsigned sliceSize = (count + lodRefreshInterval_ - 1) / lodRefreshInterval_;
+    unsigned sliceStart = lodRefreshStart_ < count ? lodRefreshStart_ : 0;
+    unsigned sliceEnd = Min(sliceStart + sliceSize, count);
+    lodRefreshStart_ = sliceEnd;
+
+    // Move each threshold away from the current tier by the hysteresis, so that a platform has to clearly cross it. They
+    // are compared squared, to skip the square root
+    float reducedEnter = reducedDistance_ + lodHysteresis_;
+    float reducedStay = Max(reducedDistance_ - lodHysteresis_, 0.0f);
+    float frozenEnter = frozenDistance_ + lodHysteresis_;
+    float frozenStay = Max(frozenDistance_ - lodHysteresis_, 0.0f);
+    reducedEnter *= reducedEnter;
+    reducedStay *= reducedStay;
+    frozenEnter *= frozenEnter;
+    frozenStay *= frozenStay;
+
+    for (unsigned i = 0; i < count; ++i)
+    {
+        unsigned char previous = tiers[i];
+        unsigned char tier = previous;
+
+        if (i >= sliceStart && i < sliceEnd)
+        {
+            float minDistanceSquared = M_INFINITY;
+            for (unsigned j = 0; j < numObservers; ++j)
+                minDistanceSquared = Min(minDistanceSquared, (positions[i] - observerPositions[j]).LengthSquared());
+
+            tier = PLATFORM_LOD_FULL;
+            if (reducedDistance_ > 0.0f && minDistanceSquared > (previous >= PLATFORM_LOD_REDUCED ? reducedStay :
+                reducedEnter))
+                tier = PLATFORM_LOD_REDUCED;
+            if (frozenDistance_ > 0.0f && minDistanceSquared > (previous >= PLATFORM_LOD_FROZEN ? frozenStay : frozenEnter))
+                tier = PLATFORM_LOD_FROZEN;
+
+            tiers[i] = tier;
+
+            // A frozen platform stands still, so its body must stop dragging contacts along at its last velocity
+            if (tier == PLATFORM_LOD_FROZEN && previous != PLATFORM_LOD_FROZEN && bodies_[i] && bodies_[i]->IsKinematic())
+                bodies_[i]->SetLinearVelocity(Vector3::ZERO);
+        }
+
+        ++tierCounts[tier];
+
+        // Promoted platforms are evaluated at once to catch up; reduced rate platforms are staggered by index so that the
+        // same number of them is due on every update
+        if (tier == PLATFORM_LOD_FULL || tier < previous || (tier == PLATFORM_LOD_REDUCED && (i + numUpdates_) %
+            reducedInterval_ == 0))
+            updateIndices_.Push(i);
+    }
+
+    for (unsigned i = 0; i < MAX_PLATFORM_LOD_TIERS; ++i)
+        tierCounts_[i] = tierCounts[i];
+
+    UpdateListedPlatforms();
+}
+
+void PlatformSystem::UpdateListedPlatforms()
+{
+    unsigned count = updateIndices_.Size();
+    numUpdatedPlatforms_ += count;
+    if (!count)
+    {
+        lastUpdateThreads_ = 0;
+        lastEvaluateTime_ = 0.0f;
+        return;
+    }
+
+    // Gather the parameters of the due platforms, so that the kernel still evaluates contiguous arrays
+    updateRates_.Resize(count);
+    updatePhaseOffsets_.Resize(count);
+    updateAmplitudes_.Resize(count);
+    updateBiases_.Resize(count);
+    updateDisplacements_.Resize(count);
+
+    const unsigned* indices = updateIndices_.Buffer();
+    for (unsigned i = 0; i < count; ++i)
+    {
+        unsigned index = indices[i];
+        updateRates_[i] = rates_[index];
+        updatePhaseOffsets_[i] = phaseOffsets_[index];
+        updateAmplitudes_[i] = amplitudes_[index];
+        updateBiases_[i] = biases_[index];
+        // The position of the previous update is the start of the render interpolation until the next one
+        previousPositions_[index] = positions_[index];
+    }
+
+    HiresTimer timer;
+    RunChunked(count, EvaluateListedPlatformsWork);
+    lastEvaluateTime_ = timer.GetUSec(false) / 1000.0f;
+
+    // Commit on the main thread; moving nodes touches the octree and the physics world
+    for (unsigned i = 0; i < count; ++i)
+        CommitPlatform(indices[i]);
+}
+
+void PlatformSystem::UpdateAllPlatforms()
+{
+    unsigned count = nodes_.Size();
+    // The positions of the previous update are the start of the render interpolation until the next one
+    previousPositions_ = positions_;
+    allPlatformsMoved_ = true;
+
+    HiresTimer timer;
+    RunChunked(count, EvaluatePlatformsWork);
+    lastEvaluateTime_ = timer.GetUSec(false) / 1000.0f;
+
+    // Commit on the main thread; moving nodes touches the octree and the physics world
+    for (unsigned i = 0; i < count; ++i)
+        CommitPlatform(i);
+}
+
+void PlatformSystem::CommitPlatform(unsigned index)
+{
+    const Vector3& position = positions_[index];
+    nodes_[index]->SetPosition(position);
+
+    // A kinematic body reads the node position only once per frame, so on each step it is also moved directly, with the
+    // velocity of the trajectory for its contacts. The velocity is not derived from the move, which spans several steps
+    // for a reduced rate platform and the whole frozen period for a promoted one. Between the evaluations of a reduced
+    // rate platform the body keeps the velocity of the last one. Static bodies follow the node, but each move takes them
+    // out of the static part of the broadphase
+    RigidBody* body = bodies_[index];
+    if (body && body->IsKinematic())
+    {
+        body->SetPosition(position);
+        body->SetLinearVelocity(GetPlatformVelocity(index, time_));
+    }
+}
+
+void PlatformSystem::RunChunked(unsigned count, void (*workFunction)(const WorkItem*, unsigned))
+{
+    lastUpdateThreads_ = 0;
+    if (!count)
+        return;
+
+    WorkQueue* queue = GetSubsystem<WorkQueue>();
+    unsigned numThreads = (queue ? queue->GetNumThreads() : 0) + 1;
+    if (maxThreads_)
+        numThreads = Min(numThreads, maxThreads_);
+
+    // Round the chunks up to whole cache lines worth of floats. The arrays are not allocated cache line aligned, so two
+    // threads may still share the one line at each chunk boundary, but never more
+    unsigned chunkSize = (count + numThreads - 1) / numThreads;
+    chunkSize = (chunkSize + PLATFORM_CHUNK_ALIGNMENT - 1) / PLATFORM_CHUNK_ALIGNMENT * PLATFORM_CHUNK_ALIGNMENT;
+
+    if (count < minParallelPlatforms_ || numThreads < 2 || chunkSize >= count)
+    {
+        WorkItem item;
+        item.start_ = (void*)(size_t)0;
+        item.end_ = (void*)(size_t)count;
+        item.aux_ = this;
+        workFunction(&item, 0);
+        lastUpdateThreads_ = 1;
+        return;
+    }
+
+    for (unsigned start = 0; start < count; start += chunkSize)
+    {
+        SharedPtr<WorkItem> item = queue->GetFreeItem();
+        item->priority_ = M_MAX_UNSIGNED;
+        item->workFunction_ = workFunction;
+        item->aux_ = this;
+        item->start_ = (void*)(size_t)start;
+        item->end_ = (void*)(size_t)Min(start + chunkSize, count);
+        queue->AddWorkItem(item);
+        ++lastUpdateThreads_;
+    }
+
+    // The main thread works on the queue too while waiting
+    queue->Complete(M_MAX_UNSIGNED);
+}
+
+void PlatformSystem::OnNodeSet(Node* node)
+{
+    if (node)
+    {
+        // The platforms move on the physics steps, so that the physics bodies riding them see them at the same rate
+        Scene* scene = GetScene();
+        physicsWorld_ = scene ? scene->GetOrCreateComponent<PhysicsWorld>() : 0;
+        if (physicsWorld_)
+            SubscribeToEvent(physicsWorld_, E_PHYSICSPRESTEP, HANDLER(PlatformSystem, HandlePhysicsPreStep));
+        SubscribeToEvent(node, E_SCENEUPDATE, HANDLER(PlatformSystem, HandleSceneUpdate));
+        SubscribeToEvent(node, E_NODEREMOVED, HANDLER(PlatformSystem, HandleNodeRemoved));
+    }
+    else
+    {
+        UnsubscribeFromAllEvents();
+        physicsWorld_.Reset();
+        RemoveAllPlatforms();
+        RemoveAllObservers();
+    }
+}
+
+void PlatformSystem::HandleSceneUpdate(StringHash eventType, VariantMap& eventData)
+{
+    using namespace SceneUpdate;
+
+    // The counters sum over the physics steps of the frame, of which there may be none or several
+    lastUpdateTime_ = 0.0f;
+    numUpdatedPlatforms_ = 0;
+    if (!IsEnabledEffective() || !physicsWorld_)
+        return;
+
+    // Track the time not yet simulated the way the physics world does: the steps of this frame consume whole steps, and
+    // the remainder is how far rendering is between the last two steps. Steps dropped by the substep limit are discarded
+    stepTimeStep_ = 1.0f / (float)physicsWorld_->GetFps();
+    if (stepAccumulator_ >= stepTimeStep_)
+        stepAccumulator_ = fmodf(stepAccumulator_, stepTimeStep_);
+    stepAccumulator_ += eventData[P_TIMESTEP].GetFloat();
+}
+
+void PlatformSystem::HandlePhysicsPreStep(StringHash eventType, VariantMap& eventData)
+{
+    using namespace PhysicsPreStep;
+
+    if (!IsEnabledEffective())
+        return;
+
+    float timeStep = eventData[P_TIMESTEP].GetFloat();
+    stepAccumulator_ = Max(stepAccumulator_ - timeStep, 0.0f);
+    Update(timeStep);
+}
+
+void PlatformSystem::HandleNodeRemoved(StringHash eventType, VariantMap& eventData)
+{
+    using namespace NodeRemoved;
+
+    RemovePlatform(static_cast<Node*>(eventData[P_NODE].GetPtr()));
+}
+
+void PlatformSystem::RemovePlatformAt(unsigned index)
+{
+    unsigned last = nodes_.Size() - 1;
+    nodeIndices_.Erase(nodes_[index]->GetID());
+
+    if (index != last)
+    {
+        ids_[index] = ids_[last];
+        rates_[index] = rates_[last];
+        phaseOffsets_[index] = phaseOffsets_[last];
+        amplitudes_[index] = amplitudes_[last];
+        biases_[index] = biases_[last];
+        displacements_[index] = displacements_[last];
+        basePositions_[index] = basePositions_[last];
+        positions_[index] = positions_[last];
+        previousPositions_[index] = previousPositions_[last];
+        axes_[index] = axes_[last];
+        nodes_[index] = nodes_[last];
+        bodies_[index] = bodies_[last];
+        tiers_[index] = tiers_[last];
+        nodeIndices_[nodes_[index]->GetID()] = index;
+    }
+
+    ids_.Resize(last);
+    rates_.Resize(last);
+    phaseOffsets_.Resize(last);
+    amplitudes_.Resize(last);
+    biases_.Resize(last);
+    displacements_.Resize(last);
+    basePositions_.Resize(last);
+    positions_.Resize(last);
+    previousPositions_.Resize(last);
+    axes_.Resize(last);
+    nodes_.Resize(last);
+    bodies_.Resize(last);
+    tiers_.Resize(last);
+}
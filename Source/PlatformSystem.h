@@ -0,0 +1,307 @@
+//
+// Copyright (c) 2008-2015 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#pragma once
+
+#include <Urho3D/Container/HashMap.h>
+#include <Urho3D/Math/Vector3.h>
+#include <Urho3D/Scene/Component.h>
+
+namespace Urho3D
+{
+
+class PhysicsWorld;
+class RigidBody;
+struct WorkItem;
+
+}
+
+using namespace Urho3D;
+
+/// Platform simulation level of detail tier.
+enum PlatformLodTier
+{
+    /// Updated on every update.
+    PLATFORM_LOD_FULL = 0,
+    /// Updated on every Nth update, staggered over the platforms.
+    PLATFORM_LOD_REDUCED,
+    /// Not updated. Jumps to the current position when promoted again.
+    PLATFORM_LOD_FROZEN,
+    MAX_PLATFORM_LOD_TIERS
+};
+
+/// Scene-level system that owns the motion state of all moving platforms and advances them in one pass per physics step.
+/// State is kept as structure-of-arrays indexed by platform index; the platform nodes themselves carry no logic component.
+/// Platform positions are a closed-form function of the platform parameters and the simulation time, so the system can
+/// seek to any time and evaluate any subset of platforms without stepping through the frames in between.
+///
+/// When observers (characters, cameras) are registered and LOD distances are set, each platform is put into a simulation
+/// tier by its distance to the nearest observer: full rate, reduced rate or frozen. Thanks to the closed form a frozen
+/// platform catches up for free when it is promoted again. The tier thresholds have hysteresis, so that platforms near a
+/// threshold do not flap between tiers.
+/// The tiers are refreshed a slice of the platforms per update, so the distance tests are spread over several updates.
+///
+/// Large updates are evaluated on the worker threads in chunks of whole cache lines worth of platforms, followed by a
+/// single-threaded commit of the positions to the nodes. Chunks keep the kernel's vector lanes where the single-threaded
+/// path has them, so the result is bit-identical.
+///
+/// Rendering reads the platform positions interpolated between the last two physics steps by the fraction of a step the
+/// frame time has advanced past the last one, like the physics world does for dynamic bodies. The physics rate can then
+/// be lowered without the platforms visibly stepping.
+class PlatformSystem : public Component
+{
+    OBJECT(PlatformSystem);
+
+public:
+    /// Construct.
+    PlatformSystem(Context* context);
+    /// Destruct.
+    virtual ~PlatformSystem();
+
+    /// Register object factory and attributes.
+    static void RegisterObject(Context* context);
+
+    /// Apply attribute changes that can not be applied immediately. Rebuilds the platforms after loading.
+    virtual void ApplyAttributes();
+
+    /// Register a platform node with the given id. The node's current position is used as the base position. Return the platform index.
+    unsigned AddPlatform(Node* node, int id, const Vector3& axis = Vector3::RIGHT);
+    /// Register a platform node with the given id, motion axis and position at time zero. Return the platform index.
+    unsigned AddPlatform(Node* node, int id, const Vector3& axis, const Vector3& basePosition);
+    /// Unregister a platform node.
+    void RemovePlatform(Node* node);
+    /// Reserve storage for a total number of platforms, to add many without reallocating.
+    void Reserve(unsigned numPlatforms);
+    /// Unregister all platforms.
+    void RemoveAllPlatforms();
+    /// Advance the simulation time by the timestep and write the resulting positions of all platforms to their nodes. Called
+    /// on each physics step.
+    void Update(float timeStep);
+    /// Set the simulation time and write the resulting positions of all platforms to their nodes.
+    void SetTime(double time);
+    /// Evaluate platforms in the index range [start, end) at the current simulation time and write their positions to their nodes.
+    void UpdatePlatforms(unsigned start, unsigned end);
+    /// Set minimum number of platforms due on an update before it is spread over the worker threads.
+    void SetMinParallelPlatforms(unsigned count);
+    /// Set maximum number of threads, including the main thread, to evaluate platforms on. Zero uses all worker threads.
+    void SetMaxThreads(unsigned count);
+    /// Evaluate platforms in the index range [start, end) without writing to their nodes. Called from the worker threads.
+    void EvaluatePlatforms(unsigned start, unsigned end);
+    /// Evaluate the entries [start, end) of the update list without writing to their nodes. Called from the worker threads.
+    void EvaluateListedPlatforms(unsigned start, unsigned end);
+    /// Add an observer node for the LOD tiers.
+    void AddObserver(Node* node);
+    /// Remove an observer node.
+    void RemoveObserver(Node* node);
+    /// Remove all observer nodes. All platforms then update at full rate.
+    void RemoveAllObservers();
+    /// Set distances from the nearest observer beyond which platforms update at reduced rate and freeze. Zero disables the tier.
+    void SetLodDistances(float reducedDistance, float frozenDistance);
+    /// Set distance by which a platform must cross a tier threshold before it changes tier.
+    void SetLodHysteresis(float distance);
+    /// Set number of updates between the updates of a reduced rate platform.
+    void SetReducedInterval(unsigned interval);
+    /// Set number of updates over which the LOD tiers of all platforms are refreshed once, a slice per update.
+    void SetLodRefreshInterval(unsigned interval);
+
+    /// Return number of platforms.
+    unsigned GetNumPlatforms() const { return nodes_.Size(); }
+    /// Return platform index of a node, or M_MAX_UNSIGNED if the node is not a platform.
+    unsigned GetPlatformIndex(Node* node) const;
+    /// Return whether a node is a registered platform.
+    bool IsPlatform(Node* node) const { return GetPlatformIndex(node) != M_MAX_UNSIGNED; }
+    /// Return platform node by index.
+    Node* GetPlatformNode(unsigned index) const { return index < nodes_.Size() ? nodes_[index] : 0; }
+    /// Return platform id by index.
+    int GetPlatformId(unsigned index) const { return index < ids_.Size() ? ids_[index] : 0; }
+    /// Return platform position at time zero by index.
+    const Vector3& GetPlatformBasePosition(unsigned index) const { return basePositions_[index]; }
+    /// Return platform motion axis by index.
+    const Vector3& GetPlatformAxis(unsigned index) const { return axes_[index]; }
+    /// Return LOD tier of a platform.
+    PlatformLodTier GetPlatformTier(unsigned index) const { return (PlatformLodTier)tiers_[index]; }
+    /// Return number of platforms in a LOD tier as of the last update.
+    unsigned GetNumPlatformsInTier(PlatformLodTier tier) const { return tier < MAX_PLATFORM_LOD_TIERS ? tierCounts_[tier] : 0; }
+    /// Return number of platform evaluations during the updates of the last frame.
+    unsigned GetNumUpdatedPlatforms() const { return numUpdatedPlatforms_; }
+    /// Return minimum number of platforms due on an update before it is spread over the worker threads.
+    unsigned GetMinParallelPlatforms() const { return minParallelPlatforms_; }
+    /// Return maximum number of threads to evaluate platforms on. Zero means all worker threads.
+    unsigned GetMaxThreads() const { return maxThreads_; }
+    /// Return number of threads the last update was evaluated on.
+    unsigned GetLastUpdateThreads() const { return lastUpdateThreads_; }
+    /// Return duration of the evaluation part of the last update in milliseconds.
+    float GetLastEvaluateTime() const { return lastEvaluateTime_; }
+    /// Return number of observer nodes.
+    unsigned GetNumObservers() const { return observers_.Size(); }
+    /// Return distance beyond which platforms update at reduced rate.
+    float GetReducedDistance() const { return reducedDistance_; }
+    /// Return distance beyond which platforms freeze.
+    float GetFrozenDistance() const { return frozenDistance_; }
+    /// Return tier threshold hysteresis distance.
+    float GetLodHysteresis() const { return lodHysteresis_; }
+    /// Return number of updates between the updates of a reduced rate platform.
+    unsigned GetReducedInterval() const { return reducedInterval_; }
+    /// Return number of updates over which the LOD tiers of all platforms are refreshed once.
+    unsigned GetLodRefreshInterval() const { return lodRefreshInterval_; }
+    /// Return simulation time.
+    double GetTime() const { return time_; }
+    /// Return duration of the updates during the last frame in milliseconds.
+    float GetLastUpdateTime() const { return lastUpdateTime_; }
+    /// Return platform position as of the last update.
+    const Vector3& GetPlatformPosition(unsigned index) const { return positions_[index]; }
+    /// Return how far the rendered frame is between the last two physics steps, from 0 to 1. Always 1 when the physics
+    /// world does not interpolate.
+    float GetInterpolationFactor() const;
+    /// Return platform position as of the update before the last.
+    const Vector3& GetPlatformPreviousPosition(unsigned index) const { return previousPositions_[index]; }
+    /// Evaluate platform position at an arbitrary simulation time.
+    Vector3 GetPlatformPosition(unsigned index, double time) const;
+    /// Evaluate platform velocity at an arbitrary simulation time.
+    Vector3 GetPlatformVelocity(unsigned index, double time) const;
+
+    /// Set simulation time attribute. Unlike SetTime(), does not move the platforms.
+    void SetTimeAttr(double time) { time_ = time; }
+    /// Set platform node IDs attribute.
+    void SetPlatformNodesAttr(const VariantVector& value);
+    /// Return platform node IDs attribute.
+    const VariantVector& GetPlatformNodesAttr() const;
+    /// Set platform parameters attribute.
+    void SetPlatformDataAttr(const PODVector<unsigned char>& value);
+    /// Return platform parameters attribute.
+    PODVector<unsigned char> GetPlatformDataAttr() const;
+
+protected:
+    /// Handle node being assigned.
+    virtual void OnNodeSet(Node* node);
+
+private:
+    /// Handle scene update event. Accumulates the frame time for the render interpolation.
+    void HandleSceneUpdate(StringHash eventType, VariantMap& eventData);
+    /// Handle physics pre-step event. Moves the platforms.
+    void HandlePhysicsPreStep(StringHash eventType, VariantMap& eventData);
+    /// Handle scene node removal, to drop platforms whose nodes go away.
+    void HandleNodeRemoved(StringHash eventType, VariantMap& eventData);
+    /// Remove platform by index by moving the last platform into its slot.
+    void RemovePlatformAt(unsigned index);
+    /// Return whether the LOD tiers are in use.
+    bool IsLodEnabled() const { return !observers_.Empty() && (reducedDistance_ > 0.0f || frozenDistance_ > 0.0f); }
+    /// Refresh the LOD tiers of one slice of the platforms and evaluate the platforms that are due on this update.
+    void UpdateScheduled();
+    /// Evaluate the platforms listed in the update indices and write their positions to their nodes.
+    void UpdateListedPlatforms();
+    /// Evaluate all platforms and write their positions to their nodes.
+    void UpdateAllPlatforms();
+    /// Write the position of a platform to its node, and to its body with the trajectory velocity if it is kinematic.
+    void CommitPlatform(unsigned index);
+    /// Run a work function over [0, count) in cache line sized chunks, on the worker threads if the count is large enough.
+    void RunChunked(unsigned count, void (*workFunction)(const WorkItem*, unsigned));
+
+    /// Platform ids.
+    PODVector<int> ids_;
+    /// Angular frequencies of the oscillation.
+    PODVector<float> rates_;
+    /// Phase offsets selecting the oscillation family.
+    PODVector<float> phaseOffsets_;
+    /// Displacement amplitudes.
+    PODVector<float> amplitudes_;
+    /// Displacement biases, so that the displacement is zero at time zero.
+    PODVector<float> biases_;
+    /// Displacements along the motion axis evaluated by the platform kernel.
+    PODVector<float> displacements_;
+    /// Base positions at time zero.
+    PODVector<Vector3> basePositions_;
+    /// Positions as of the last update.
+    PODVector<Vector3> positions_;
+    /// Positions as of the update before the last, the start of the render interpolation.
+    PODVector<Vector3> previousPositions_;
+    /// Motion axes.
+    PODVector<Vector3> axes_;
+    /// Platform scene nodes. Owned by the scene; removed from here when the node leaves the scene.
+    PODVector<Node*> nodes_;
+    /// Platform rigid bodies, if any. Owned by the platform nodes, which must keep them while registered.
+    PODVector<RigidBody*> bodies_;
+    /// LOD tiers.
+    PODVector<unsigned char> tiers_;
+    /// Platform index by node ID.
+    HashMap<unsigned, unsigned> nodeIndices_;
+    /// Platform node IDs attribute: the number of platforms followed by their node IDs.
+    mutable VariantVector platformNodesAttr_;
+    /// Platform parameters attribute waiting to be applied.
+    PODVector<unsigned char> platformDataAttr_;
+    /// Platforms need rebuilding from the attributes flag.
+    bool platformsDirty_;
+    /// Observer nodes for the LOD tiers.
+    Vector<WeakPtr<Node> > observers_;
+    /// Observer positions of the current update.
+    PODVector<Vector3> observerPositions_;
+    /// Indices of the platforms due on the current update.
+    PODVector<unsigned> updateIndices_;
+    /// Angular frequencies of the platforms due on the current update.
+    PODVector<float> updateRates_;
+    /// Phase offsets of the platforms due on the current update.
+    PODVector<float> updatePhaseOffsets_;
+    /// Amplitudes of the platforms due on the current update.
+    PODVector<float> updateAmplitudes_;
+    /// Biases of the platforms due on the current update.
+    PODVector<float> updateBiases_;
+    /// Displacements of the platforms due on the current update.
+    PODVector<float> updateDisplacements_;
+    /// Distance beyond which platforms update at reduced rate. Zero disables the tier.
+    float reducedDistance_;
+    /// Distance beyond which platforms freeze. Zero disables the tier.
+    float frozenDistance_;
+    /// Tier threshold hysteresis distance.
+    float lodHysteresis_;
+    /// Number of updates between the updates of a reduced rate platform.
+    unsigned reducedInterval_;
+    /// Number of updates over which the LOD tiers of all platforms are refreshed once.
+    unsigned lodRefreshInterval_;
+    /// First platform index of the slice whose LOD tiers are refreshed on the next update.
+    unsigned lodRefreshStart_;
+    /// Number of updates so far, used to stagger the reduced rate platforms.
+    unsigned numUpdates_;
+    /// Number of platforms per LOD tier as of the last update.
+    unsigned tierCounts_[MAX_PLATFORM_LOD_TIERS];
+    /// Number of platform evaluations during the updates of the last frame.
+    unsigned numUpdatedPlatforms_;
+    /// Minimum number of due platforms before an update is spread over the worker threads.
+    unsigned minParallelPlatforms_;
+    /// Maximum number of threads to evaluate platforms on. Zero means all worker threads.
+    unsigned maxThreads_;
+    /// Number of threads the last update was evaluated on.
+    unsigned lastUpdateThreads_;
+    /// Duration of the evaluation part of the last update in milliseconds.
+    float lastEvaluateTime_;
+    /// Simulation time in seconds. Kept in double precision so that phases stay accurate in long-running sessions.
+    double time_;
+    /// Physics world whose steps move the platforms.
+    WeakPtr<PhysicsWorld> physicsWorld_;
+    /// Frame time not yet consumed by physics steps, in seconds.
+    float stepAccumulator_;
+    /// Physics step length in seconds.
+    float stepTimeStep_;
+    /// Duration of the updates during the last frame in milliseconds.
+    float lastUpdateTime_;
+    /// All platforms moved on the last update, so the next scheduled update resets all previous positions.
+    bool allPlatformsMoved_;
+};
@@ -0,0 +1,254 @@
+//
+// Copyright (c) 2008-2015 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#include <Urho3D/Core/Timer.h>
+#include <Urho3D/IO/Log.h>
+#include <Urho3D/Math/Random.h>
+#include <Urho3D/Scene/Scene.h>
+
+#include "LoopbackTransport.h"
+#include "PlatformLayout.h"
+#include "PlatformSystem.h"
+#include "ReplicationClient.h"
+#include "ReplicationProtocol.h"
+
+#include <Urho3D/DebugNew.h>
+
+/// Interval between clock sample requests in seconds.
+static const float CLOCK_SYNC_INTERVAL = 1.0f;
+/// Fraction of the remaining clock error slewed out per second.
+static const float CLOCK_SLEW_RATE = 2.0f;
+/// Clock error beyond which the clock jumps instead of slewing, in seconds.
+static const float CLOCK_SNAP_THRESHOLD = 0.25f;
+/// Display delay in character state intervals, so that there are two states around the display time to interpolate.
+static const float INTERPOLATION_STATE_INTERVALS = 2.0f;
+
+ReplicationClient::ReplicationClient(Context* context) :
+    Object(context),
+    scene_(new Scene(context)),
+    endpoint_(0),
+    serverEndpoint_(0),
+    localTime_(0.0),
+    time_(0.0),
+    clockCorrection_(0.0),
+    interpolationDelay_(0.0f),
+    clockSyncTimer_(0.0f),
+    clockError_(0.0f),
+    roundTripTime_(0.0f),
+    stateNumber_(0),
+    updateUSec_(0),
+    ready_(false)
+{
+    // The client scene is driven by Update() instead of the engine
+    scene_->SetUpdateEnabled(false);
+}
+
+ReplicationClient::~ReplicationClient()
+{
+}
+
+void ReplicationClient::Connect(LoopbackTransport* transport, unsigned serverEndpoint)
+{
+    transport_ = transport;
+    endpoint_ = transport_->AddEndpoint();
+    serverEndpoint_ = serverEndpoint;
+
+    packet_.Clear();
+    packet_.WriteUByte(MSG_REPLICATION_HELLO);
+    transport_->Send(endpoint_, serverEndpoint_, packet_);
+}
+
+void ReplicationClient::Update(float timeStep)
+{
+    if (!transport_)
+        return;
+
+    HiresTimer timer;
+    localTime_ += timeStep;
+
+    unsigned from;
+    while (transport_->Receive(endpoint_, from, packet_))
+    {
+        ReplicationMessage message = (ReplicationMessage)packet_.ReadUByte();
+        switch (message)
+        {
+        case MSG_REPLICATION_SETUP:
+            HandleSetup(packet_);
+            break;
+
+        case MSG_REPLICATION_STATE:
+            if (ready_)
+                HandleState(packet_);
+            break;
+
+        case MSG_REPLICATION_CLOCK_REPLY:
+            if (ready_)
+                HandleClockReply(packet_);
+            break;
+
+        default:
+            LOGWARNINGF("Unexpected replication message %u from endpoint %u", (unsigned)message, from);
+            break;
+        }
+    }
+
+    if (!ready_)
+        return;
+
+    // Run the clock at the local rate, slewing out the error of the last clock sample
+    double correction = clockCorrection_ * Min(timeStep * CLOCK_SLEW_RATE, 1.0f);
+    clockCorrection_ -= correction;
+    time_ += timeStep + correction;
+
+    clockSyncTimer_ += timeStep;
+    if (clockSyncTimer_ >= CLOCK_SYNC_INTERVAL)
+        SendClockRequest();
+
+    // The platforms need nothing from the server: their positions are evaluated from the layout and the clock
+    if (platformSystem_)
+        platformSystem_->SetTime(GetDisplayTime());
+    PlaceCharacters();
+
+    updateUSec_ += timer.GetUSec(false);
+}
+
+void ReplicationClient::HandleSetup(Deserializer& source)
+{
+    if (ready_)
+        return;
+
+    PlatformLayout layout;
+    if (!layout.Read(source))
+    {
+        LOGERROR("Malformed replication setup");
+        return;
+    }
+    int sendRate = Max((int)source.ReadVLE(), 1);
+    time_ = source.ReadDouble();
+    interpolationDelay_ = INTERPOLATION_STATE_INTERVALS / sendRate;
+
+    // Creating the platforms reseeds the random generator shared with the rest of the process, so restore it afterwards
+    unsigned randomSeed = GetRandomSeed();
+    PlatformSystem* platformSystem = scene_->CreateComponent<PlatformSystem>();
+    layout.CreatePlatforms(scene_, platformSystem);
+    SetRandomSeed(randomSeed);
+
+    platformSystem_ = platformSystem;
+    ready_ = true;
+    SendClockRequest();
+    LOGINFOF("Replication client %u created %u platforms from layout seed %u", endpoint_, platformSystem->GetNumPlatforms(),
+        layout.seed_);
+}
+
+void ReplicationClient::HandleState(Deserializer& source)
+{
+    double time = source.ReadDouble();
+    unsigned numCharacters = source.ReadVLE();
+    ++stateNumber_;
+
+    for (unsigned i = 0; i < numCharacters && !source.IsEof(); ++i)
+    {
+        unsigned id = source.ReadVLE();
+        Vector3 position = source.ReadVector3();
+        Quaternion rotation = source.ReadPackedQuaternion();
+
+        HashMap<unsigned, ReplicatedCharacter>::Iterator j = characters_.Find(id);
+        if (j == characters_.End())
+        {
+            ReplicatedCharacter& character = characters_[id];
+            character.node_ = scene_->CreateChild("Character", LOCAL);
+            character.times_[0] = character.times_[1] = time;
+            character.positions_[0] = character.positions_[1] = position;
+            character.rotations_[0] = character.rotations_[1] = rotation;
+            character.stateNumber_ = stateNumber_;
+        }
+        else
+        {
+            ReplicatedCharacter& character = j->second_;
+            character.times_[0] = character.times_[1];
+            character.positions_[0] = character.positions_[1];
+            character.rotations_[0] = character.rotations_[1];
+            character.times_[1] = time;
+            character.positions_[1] = position;
+            character.rotations_[1] = rotation;
+            character.stateNumber_ = stateNumber_;
+        }
+    }
+
+    // Characters the server no longer sends are gone
+    for (HashMap<unsigned, ReplicatedCharacter>::Iterator i = characters_.Begin(); i != characters_.End();)
+    {
+        if (i->second_.stateNumber_ != stateNumber_)
+        {
+            if (i->second_.node_)
+                i->second_.node_->Remove();
+            i = characters_.Erase(i);
+        }
+        else
+            ++i;
+    }
+}
+
+void ReplicationClient::HandleClockReply(Deserializer& source)
+{
+    double requestTime = source.ReadDouble();
+    double serverTime = source.ReadDouble();
+
+    // The server clock was read halfway through the round trip
+    roundTripTime_ = (float)(localTime_ - requestTime);
+    double error = serverTime + roundTripTime_ * 0.5 - time_;
+    clockError_ = (float)error;
+
+    if (Abs(clockError_) > CLOCK_SNAP_THRESHOLD)
+    {
+        time_ += error;
+        clockCorrection_ = 0.0;
+    }
+    else
+        clockCorrection_ = error;
+}
+
+void ReplicationClient::SendClockRequest()
+{
+    clockSyncTimer_ = 0.0f;
+
+    packet_.Clear();
+    packet_.WriteUByte(MSG_REPLICATION_CLOCK_REQUEST);
+    packet_.WriteDouble(localTime_);
+    transport_->Send(endpoint_, serverEndpoint_, packet_);
+}
+
+void ReplicationClient::PlaceCharacters()
+{
+    double displayTime = GetDisplayTime();
+    for (HashMap<unsigned, ReplicatedCharacter>::Iterator i = characters_.Begin(); i != characters_.End(); ++i)
+    {
+        ReplicatedCharacter& character = i->second_;
+        if (!character.node_)
+            continue;
+
+        double interval = character.times_[1] - character.times_[0];
+        float t = interval > 0.0 ? Clamp((float)((displayTime - character.times_[0]) / interval), 0.0f, 1.0f) : 1.0f;
+        character.node_->SetWorldPosition(character.positions_[0].Lerp(character.positions_[1], t));
+        character.node_->SetWorldRotation(character.rotations_[0].Slerp(character.rotations_[1], t));
+    }
+}
@@ -0,0 +1,146 @@
+//
+// Copyright (c) 2008-2015 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#pragma once
+
+#include <Urho3D/Container/HashMap.h>
+#include <Urho3D/Core/Object.h>
+#include <Urho3D/IO/VectorBuffer.h>
+#include <Urho3D/Math/Quaternion.h>
+
+namespace Urho3D
+{
+
+class Deserializer;
+class Node;
+class Scene;
+
+}
+
+using namespace Urho3D;
+
+class LoopbackTransport;
+class PlatformSystem;
+
+/// Character as last received from the server.
+struct ReplicatedCharacter
+{
+    /// Node in the client scene.
+    WeakPtr<Node> node_;
+    /// Server platform clock of the two last states.
+    double times_[2];
+    /// World positions of the two last states.
+    Vector3 positions_[2];
+    /// World rotations of the two last states.
+    Quaternion rotations_[2];
+    /// Number of the last state that included the character.
+    unsigned stateNumber_;
+};
+
+/// Client side of the deterministic platform replication, with its own scene that is not updated by the engine. After
+/// joining it creates the same platforms from the layout the server sends and keeps a clock in phase with the server's
+/// platform clock from periodic clock samples, slewing it towards each sample instead of jumping. The platforms are
+/// placed locally at that clock every update, and the character states from the server are interpolated at the same
+/// time, delayed by two state intervals, so that characters standing on platforms stay on them.
+class ReplicationClient : public Object
+{
+    OBJECT(ReplicationClient);
+
+public:
+    /// Construct.
+    ReplicationClient(Context* context);
+    /// Destruct.
+    virtual ~ReplicationClient();
+
+    /// Join a server over a transport.
+    void Connect(LoopbackTransport* transport, unsigned serverEndpoint);
+    /// Receive from the server, advance the clock and place the platforms and characters.
+    void Update(float timeStep);
+
+    /// Return the client scene.
+    Scene* GetScene() const { return scene_; }
+    /// Return the platform system of the client scene, or null before joining.
+    PlatformSystem* GetPlatformSystem() const { return platformSystem_; }
+    /// Return whether the client has joined and created the platforms.
+    bool IsReady() const { return ready_; }
+    /// Return the estimate of the server platform clock.
+    double GetTime() const { return time_; }
+    /// Return the time the platforms and characters are shown at.
+    double GetDisplayTime() const { return time_ - interpolationDelay_; }
+    /// Return the clock error found by the last clock sample, in seconds.
+    float GetClockError() const { return clockError_; }
+    /// Return the round trip time of the last clock sample, in seconds.
+    float GetRoundTripTime() const { return roundTripTime_; }
+    /// Return the client endpoint on the transport.
+    unsigned GetEndpoint() const { return endpoint_; }
+    /// Return number of characters.
+    unsigned GetNumCharacters() const { return characters_.Size(); }
+    /// Return time spent in updates since joining, in microseconds.
+    unsigned long long GetUpdateUSec() const { return updateUSec_; }
+
+private:
+    /// Create the platforms from the server's layout.
+    void HandleSetup(Deserializer& source);
+    /// Store a character state.
+    void HandleState(Deserializer& source);
+    /// Correct the clock from a clock sample.
+    void HandleClockReply(Deserializer& source);
+    /// Send a clock sample request.
+    void SendClockRequest();
+    /// Place the characters at the display time.
+    void PlaceCharacters();
+
+    /// Client scene.
+    SharedPtr<Scene> scene_;
+    /// Platform system of the client scene.
+    WeakPtr<PlatformSystem> platformSystem_;
+    /// Transport.
+    SharedPtr<LoopbackTransport> transport_;
+    /// Characters by server node ID.
+    HashMap<unsigned, ReplicatedCharacter> characters_;
+    /// Packet being written or read.
+    VectorBuffer packet_;
+    /// Client endpoint.
+    unsigned endpoint_;
+    /// Server endpoint.
+    unsigned serverEndpoint_;
+    /// Local clock, advanced by the update time steps only.
+    double localTime_;
+    /// Estimate of the server platform clock.
+    double time_;
+    /// Clock error still to be slewed out.
+    double clockCorrection_;
+    /// Interpolation delay of the display time.
+    float interpolationDelay_;
+    /// Time since the last clock sample request.
+    float clockSyncTimer_;
+    /// Clock error found by the last clock sample.
+    float clockError_;
+    /// Round trip time of the last clock sample.
+    float roundTripTime_;
+    /// Number of the last character state.
+    unsigned stateNumber_;
+    /// Time spent in updates, in microseconds.
+    unsigned long long updateUSec_;
+    /// Joined flag.
+    bool ready_;
+};
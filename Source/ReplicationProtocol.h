@@ -0,0 +1,42 @@
+//
+// Copyright (c) 2008-2015 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#pragma once
+
+/// Replication message IDs, written as the first byte of each packet.
+enum ReplicationMessage
+{
+    /// Client asks to join. No payload.
+    MSG_REPLICATION_HELLO = 1,
+    /// Server answers a join. Platform layout, VLE state send rate and double server platform clock.
+    MSG_REPLICATION_SETUP,
+    /// Character state. Double server platform clock, VLE character count, then per character VLE node ID, Vector3
+    /// world position and packed quaternion world rotation.
+    MSG_REPLICATION_STATE,
+    /// Client clock sample request. Double client local clock.
+    MSG_REPLICATION_CLOCK_REQUEST,
+    /// Server answer to a clock sample request. Double echoed client local clock and double server platform clock.
+    MSG_REPLICATION_CLOCK_REPLY
+};
+
+/// Default character state sends per second.
+static const int DEFAULT_REPLICATION_SEND_RATE = 20;
@@ -0,0 +1,269 @@
+//
+// Copyright (c) 2008-2015 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#include <Urho3D/Core/CoreEvents.h>
+#include <Urho3D/Core/StringUtils.h>
+#include <Urho3D/Engine/DebugHud.h>
+#include <Urho3D/IO/Log.h>
+#include <Urho3D/Scene/Scene.h>
+#include <Urho3D/Scene/SceneEvents.h>
+
+#include "PlatformSystem.h"
+#include "ReplicationClient.h"
+#include "ReplicationProtocol.h"
+#include "ReplicationServer.h"
+
+#include <Urho3D/DebugNew.h>
+
+/// Interval between debug HUD updates in milliseconds.
+static const unsigned REPLICATION_HUD_INTERVAL = 500;
+
+ReplicationServer::ReplicationServer(Context* context) :
+    Object(context),
+    endpoint_(0),
+    sendRate_(DEFAULT_REPLICATION_SEND_RATE),
+    sendTimer_(0.0f),
+    updateUSec_(0),
+    numUpdates_(0),
+    hudTime_(0.0),
+    hudUpdateUSec_(0),
+    hudClientUSec_(0),
+    hudUpdates_(0)
+{
+}
+
+ReplicationServer::~ReplicationServer()
+{
+    Stop();
+}
+
+bool ReplicationServer::Start(Scene* scene, const PlatformLayout& layout, LoopbackTransport* transport)
+{
+    Stop();
+
+    if (!scene || !transport)
+        return false;
+
+    PlatformSystem* platformSystem = scene->GetComponent<PlatformSystem>();
+    if (!platformSystem)
+    {
+        LOGERROR("Can not replicate a scene without a platform system");
+        return false;
+    }
+    // Without a seed the clients would draw different random platform offsets and sizes
+    if (!layout.seed_)
+    {
+        LOGERROR("Can not replicate platforms created without a layout seed");
+        return false;
+    }
+
+    scene_ = scene;
+    platformSystem_ = platformSystem;
+    layout_ = layout;
+    transport_ = transport;
+    endpoint_ = transport_->AddEndpoint();
+    sendTimer_ = 0.0f;
+    updateUSec_ = 0;
+    numUpdates_ = 0;
+    hudCounters_ = transport_->GetCounters(endpoint_);
+    hudTime_ = transport_->GetTime();
+    hudUpdateUSec_ = 0;
+    hudClientUSec_ = 0;
+    hudUpdates_ = 0;
+
+    SubscribeToEvent(scene, E_SCENEPOSTUPDATE, HANDLER(ReplicationServer, HandleScenePostUpdate));
+    LOGINFOF("Replicating %u platforms from layout seed %u", platformSystem->GetNumPlatforms(), layout_.seed_);
+    return true;
+}
+
+void ReplicationServer::Stop()
+{
+    UnsubscribeFromAllEvents();
+    loopbackClients_.Clear();
+    clients_.Clear();
+    characters_.Clear();
+    transport_.Reset();
+    platformSystem_.Reset();
+    scene_.Reset();
+}
+
+void ReplicationServer::AddCharacter(Node* node)
+{
+    if (node && !characters_.Contains(WeakPtr<Node>(node)))
+        characters_.Push(WeakPtr<Node>(node));
+}
+
+ReplicationClient* ReplicationServer::AddLoopbackClient()
+{
+    if (!transport_)
+        return 0;
+
+    SharedPtr<ReplicationClient> client(new ReplicationClient(context_));
+    client->Connect(transport_, endpoint_);
+    loopbackClients_.Push(client);
+    return client;
+}
+
+void ReplicationServer::SetSendRate(int rate)
+{
+    sendRate_ = Max(rate, 1);
+}
+
+ReplicationClient* ReplicationServer::GetLoopbackClient(unsigned index) const
+{
+    return index < loopbackClients_.Size() ? loopbackClients_[index] : (ReplicationClient*)0;
+}
+
+void ReplicationServer::HandleScenePostUpdate(StringHash eventType, VariantMap& eventData)
+{
+    using namespace ScenePostUpdate;
+
+    if (!platformSystem_)
+        return;
+
+    float timeStep = eventData[P_TIMESTEP].GetFloat();
+    HiresTimer timer;
+
+    ReceivePackets();
+
+    float sendInterval = 1.0f / sendRate_;
+    sendTimer_ += timeStep;
+    if (sendTimer_ >= sendInterval)
+    {
+        sendTimer_ = fmodf(sendTimer_, sendInterval);
+        SendState();
+    }
+
+    updateUSec_ += timer.GetUSec(false);
+    ++numUpdates_;
+
+    // The packets sent now arrive at the clients once the latency has passed on the transport clock
+    transport_->Update(timeStep);
+    for (unsigned i = 0; i < loopbackClients_.Size(); ++i)
+        loopbackClients_[i]->Update(timeStep);
+
+    if (hudTimer_.GetMSec(false) >= REPLICATION_HUD_INTERVAL)
+    {
+        hudTimer_.Reset();
+        UpdateDebugHud();
+    }
+}
+
+void ReplicationServer::ReceivePackets()
+{
+    unsigned from;
+    while (transport_->Receive(endpoint_, from, packet_))
+    {
+        ReplicationMessage message = (ReplicationMessage)packet_.ReadUByte();
+        switch (message)
+        {
+        case MSG_REPLICATION_HELLO:
+            if (!clients_.Contains(from))
+                clients_.Push(from);
+            packet_.Clear();
+            packet_.WriteUByte(MSG_REPLICATION_SETUP);
+            layout_.Write(packet_);
+            packet_.WriteVLE(sendRate_);
+            packet_.WriteDouble(platformSystem_->GetTime());
+            transport_->Send(endpoint_, from, packet_);
+            break;
+
+        case MSG_REPLICATION_CLOCK_REQUEST:
+            {
+                double clientTime = packet_.ReadDouble();
+                packet_.Clear();
+                packet_.WriteUByte(MSG_REPLICATION_CLOCK_REPLY);
+                packet_.WriteDouble(clientTime);
+                packet_.WriteDouble(platformSystem_->GetTime());
+                transport_->Send(endpoint_, from, packet_);
+            }
+            break;
+
+        default:
+            LOGWARNINGF("Unexpected replication message %u from endpoint %u", (unsigned)message, from);
+            break;
+        }
+    }
+}
+
+void ReplicationServer::SendState()
+{
+    if (clients_.Empty())
+        return;
+
+    unsigned numCharacters = 0;
+    for (unsigned i = 0; i < characters_.Size(); ++i)
+    {
+        if (characters_[i])
+            ++numCharacters;
+    }
+
+    packet_.Clear();
+    packet_.WriteUByte(MSG_REPLICATION_STATE);
+    packet_.WriteDouble(platformSystem_->GetTime());
+    packet_.WriteVLE(numCharacters);
+    for (unsigned i = 0; i < characters_.Size(); ++i)
+    {
+        Node* node = characters_[i];
+        if (!node)
+            continue;
+        packet_.WriteVLE(node->GetID());
+        packet_.WriteVector3(node->GetWorldPosition());
+        packet_.WritePackedQuaternion(node->GetWorldRotation());
+    }
+
+    for (unsigned i = 0; i < clients_.Size(); ++i)
+        transport_->Send(endpoint_, clients_[i], packet_);
+}
+
+void ReplicationServer::UpdateDebugHud()
+{
+    unsigned long long clientUSec = 0;
+    float maxClockError = 0.0f;
+    for (unsigned i = 0; i < loopbackClients_.Size(); ++i)
+    {
+        clientUSec += loopbackClients_[i]->GetUpdateUSec();
+        maxClockError = Max(maxClockError, Abs(loopbackClients_[i]->GetClockError()));
+    }
+
+    const TransportCounters& counters = transport_->GetCounters(endpoint_);
+    double elapsed = transport_->GetTime() - hudTime_;
+    unsigned updates = numUpdates_ - hudUpdates_;
+    DebugHud* debugHud = GetSubsystem<DebugHud>();
+    if (debugHud && !clients_.Empty() && elapsed > 0.0 && updates)
+    {
+        float bytesDown = (float)((counters.bytesSent_ - hudCounters_.bytesSent_) / elapsed / clients_.Size());
+        float bytesUp = (float)((counters.bytesReceived_ - hudCounters_.bytesReceived_) / elapsed / clients_.Size());
+        float serverMs = (float)(updateUSec_ - hudUpdateUSec_) / updates / 1000.0f;
+        float clientMs = (float)(clientUSec - hudClientUSec_) / updates / 1000.0f;
+        debugHud->SetAppStats("Replication B/s per client", ToString("down %.0f up %.0f (%u clients, %u platforms)", bytesDown,
+            bytesUp, clients_.Size(), platformSystem_ ? platformSystem_->GetNumPlatforms() : 0));
+        debugHud->SetAppStats("Replication ms/frame", ToString("server %.3f clients %.3f clock error %.1f ms", serverMs,
+            clientMs, maxClockError * 1000.0f));
+    }
+
+    hudCounters_ = counters;
+    hudTime_ = transport_->GetTime();
+    hudUpdateUSec_ = updateUSec_;
+    hudClientUSec_ = clientUSec;
+    hudUpdates_ = numUpdates_;
+}
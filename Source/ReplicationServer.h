@@ -0,0 +1,136 @@
+//
+// Copyright (c) 2008-2015 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#pragma once
+
+#include <Urho3D/Core/Object.h>
+#include <Urho3D/Core/Timer.h>
+#include <Urho3D/IO/VectorBuffer.h>
+
+#include "LoopbackTransport.h"
+#include "PlatformLayout.h"
+
+namespace Urho3D
+{
+
+class Node;
+class Scene;
+
+}
+
+using namespace Urho3D;
+
+class PlatformSystem;
+class ReplicationClient;
+
+/// Server side of the deterministic platform replication. Platform motion is a function of the platform layout and the
+/// platform system clock only, so instead of the platform transforms the server sends each client the layout once when
+/// it joins, answers its clock samples so that it can run the same clock, and sends the character transforms at a fixed
+/// rate. The traffic per client follows the number of characters and not the number of platforms. The server advances
+/// the transport clock and then updates its loopback clients, so that a whole session runs in one process.
+class ReplicationServer : public Object
+{
+    OBJECT(ReplicationServer);
+
+public:
+    /// Construct.
+    ReplicationServer(Context* context);
+    /// Destruct.
+    virtual ~ReplicationServer();
+
+    /// Start serving a scene whose platforms were created from a layout with a nonzero seed. Return true on success.
+    bool Start(Scene* scene, const PlatformLayout& layout, LoopbackTransport* transport);
+    /// Stop serving and remove the loopback clients.
+    void Stop();
+    /// Add a character node whose transform is sent to the clients.
+    void AddCharacter(Node* node);
+    /// Create a client with its own scene and join it to the server over the transport.
+    ReplicationClient* AddLoopbackClient();
+    /// Set character state sends per second.
+    void SetSendRate(int rate);
+
+    /// Return character state sends per second.
+    int GetSendRate() const { return sendRate_; }
+    /// Return number of joined clients.
+    unsigned GetNumClients() const { return clients_.Size(); }
+    /// Return number of loopback clients.
+    unsigned GetNumLoopbackClients() const { return loopbackClients_.Size(); }
+    /// Return loopback client by index.
+    ReplicationClient* GetLoopbackClient(unsigned index) const;
+    /// Return the transport.
+    LoopbackTransport* GetTransport() const { return transport_; }
+    /// Return the server endpoint on the transport.
+    unsigned GetEndpoint() const { return endpoint_; }
+    /// Return time spent receiving and sending since the start, in microseconds.
+    unsigned long long GetUpdateUSec() const { return updateUSec_; }
+    /// Return number of updates since the start.
+    unsigned GetNumUpdates() const { return numUpdates_; }
+
+private:
+    /// Handle scene post-update. Receives, sends the character state when due and updates the loopback clients.
+    void HandleScenePostUpdate(StringHash eventType, VariantMap& eventData);
+    /// Handle the arrived packets.
+    void ReceivePackets();
+    /// Send the character state to all clients.
+    void SendState();
+    /// Update the debug HUD.
+    void UpdateDebugHud();
+
+    /// Served scene.
+    WeakPtr<Scene> scene_;
+    /// Platform system of the served scene.
+    WeakPtr<PlatformSystem> platformSystem_;
+    /// Transport.
+    SharedPtr<LoopbackTransport> transport_;
+    /// Layout of the platforms.
+    PlatformLayout layout_;
+    /// Replicated characters.
+    Vector<WeakPtr<Node> > characters_;
+    /// Endpoints of the joined clients.
+    PODVector<unsigned> clients_;
+    /// Clients running in this process.
+    Vector<SharedPtr<ReplicationClient> > loopbackClients_;
+    /// Packet being written or read.
+    VectorBuffer packet_;
+    /// Server endpoint.
+    unsigned endpoint_;
+    /// Character state sends per second.
+    int sendRate_;
+    /// Time since the last character state send.
+    float sendTimer_;
+    /// Time spent receiving and sending, in microseconds.
+    unsigned long long updateUSec_;
+    /// Number of updates.
+    unsigned numUpdates_;
+    /// Debug HUD update timer.
+    Timer hudTimer_;
+    /// Server traffic totals at the last debug HUD update.
+    TransportCounters hudCounters_;
+    /// Transport clock at the last debug HUD update.
+    double hudTime_;
+    /// Server update time at the last debug HUD update.
+    unsigned long long hudUpdateUSec_;
+    /// Loopback client update time at the last debug HUD update.
+    unsigned long long hudClientUSec_;
+    /// Update count at the last debug HUD update.
+    unsigned hudUpdates_;
+};
@@ -0,0 +1,144 @@
+//
+// Copyright (c) 2008-2015 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#include <Urho3D/IO/Log.h>
+#include <Urho3D/Resource/ResourceCache.h>
+#include <Urho3D/Resource/ResourceEvents.h>
+
+#include "ResourcePreloader.h"
+
+#include <Urho3D/DebugNew.h>
+
+ResourcePreloader::ResourcePreloader(Context* context) :
+    Object(context),
+    elapsedTime_(0.0f),
+    numDone_(0),
+    numFailed_(0),
+    started_(false),
+    finished_(false)
+{
+}
+
+ResourcePreloader::~ResourcePreloader()
+{
+}
+
+void ResourcePreloader::AddResource(StringHash type, const String& name)
+{
+    if (started_)
+    {
+        LOGERROR("Can not add resources to a preload that has started");
+        return;
+    }
+
+    PreloadResource resource;
+    resource.type_ = type;
+    resource.name_ = GetSubsystem<ResourceCache>()->SanitateResourceName(name);
+    resource.done_ = false;
+    resources_.Push(resource);
+}
+
+void ResourcePreloader::Start()
+{
+    if (started_)
+        return;
+
+    started_ = true;
+    timer_.Reset();
+    SubscribeToEvent(E_RESOURCEBACKGROUNDLOADED, HANDLER(ResourcePreloader, HandleResourceBackgroundLoaded));
+
+    LOGINFOF("Preloading %u resources", resources_.Size());
+
+    ResourceCache* cache = GetSubsystem<ResourceCache>();
+    for (unsigned i = 0; i < resources_.Size(); ++i)
+    {
+        PreloadResource& resource = resources_[i];
+        if (resource.done_)
+            continue;
+
+        // Nothing is queued for a resource that is already loaded, and without threading the load happens right here
+        bool queued = cache->BackgroundLoadResource(resource.type_, resource.name_, true);
+        if (cache->GetExistingResource(resource.type_, resource.name_))
+            MarkDone(resource, true);
+        else if (!queued)
+            MarkDone(resource, false);
+    }
+
+    if (resources_.Empty())
+        Finish();
+}
+
+void ResourcePreloader::HandleResourceBackgroundLoaded(StringHash eventType, VariantMap& eventData)
+{
+    using namespace ResourceBackgroundLoaded;
+
+    const String& name = eventData[P_RESOURCENAME].GetString();
+    bool success = eventData[P_SUCCESS].GetBool();
+
+    // The same file may be in the manifest as more than one resource type; each gets its own event
+    Resource* loaded = static_cast<Resource*>(eventData[P_RESOURCE].GetPtr());
+    for (unsigned i = 0; i < resources_.Size(); ++i)
+    {
+        PreloadResource& resource = resources_[i];
+        if (!resource.done_ && resource.name_ == name && (!loaded || loaded->GetType() == resource.type_))
+        {
+            MarkDone(resource, success);
+            break;
+        }
+    }
+}
+
+void ResourcePreloader::MarkDone(PreloadResource& resource, bool success)
+{
+    resource.done_ = true;
+    ++numDone_;
+    if (!success)
+    {
+        ++numFailed_;
+        LOGWARNING("Could not preload " + resource.name_);
+    }
+
+    using namespace PreloadProgress;
+
+    VariantMap& eventData = GetEventDataMap();
+    eventData[P_RESOURCENAME] = resource.name_;
+    eventData[P_SUCCESS] = success;
+    eventData[P_PROGRESS] = GetProgress();
+    SendEvent(E_PRELOADPROGRESS, eventData);
+
+    if (numDone_ == resources_.Size())
+        Finish();
+}
+
+void ResourcePreloader::Finish()
+{
+    using namespace PreloadFinished;
+
+    finished_ = true;
+    elapsedTime_ = timer_.GetUSec(false) / 1000.0f;
+    UnsubscribeFromEvent(E_RESOURCEBACKGROUNDLOADED);
+    LOGINFOF("Preloaded %u resources in %.2f ms, %u failed", resources_.Size(), elapsedTime_, numFailed_);
+
+    VariantMap& eventData = GetEventDataMap();
+    eventData[P_NUMFAILED] = (int)numFailed_;
+    SendEvent(E_PRELOADFINISHED, eventData);
+}
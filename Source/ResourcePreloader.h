@@ -0,0 +1,115 @@
+//
+// Copyright (c) 2008-2015 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#pragma once
+
+#include <Urho3D/Core/Object.h>
+#include <Urho3D/Core/Timer.h>
+
+using namespace Urho3D;
+
+/// Progress of a resource preload. Sent by the preloader as each resource of the manifest becomes resident or fails.
+EVENT(E_PRELOADPROGRESS, PreloadProgress)
+{
+    PARAM(P_RESOURCENAME, ResourceName);        // String
+    PARAM(P_SUCCESS, Success);                  // bool
+    PARAM(P_PROGRESS, Progress);                // float
+}
+
+/// Resource preload finished. Sent by the preloader once every resource of the manifest has been loaded or has failed.
+EVENT(E_PRELOADFINISHED, PreloadFinished)
+{
+    PARAM(P_NUMFAILED, NumFailed);              // int
+}
+
+/// Resource of a preload manifest.
+struct PreloadResource
+{
+    /// Resource type.
+    StringHash type_;
+    /// Resource name.
+    String name_;
+    /// Loaded or failed flag.
+    bool done_;
+};
+
+/// Loader of a declared manifest of resources through the resource cache's background loading. File reads and decoding
+/// happen on the background loader thread; the main thread only finishes each resource, within the resource cache's
+/// per-frame time budget, so frames keep running meanwhile. Subscribe to E_PRELOADFINISHED from the preloader to build
+/// whatever depends on the resources once they are all resident.
+class ResourcePreloader : public Object
+{
+    OBJECT(ResourcePreloader);
+
+public:
+    /// Construct.
+    ResourcePreloader(Context* context);
+    /// Destruct.
+    virtual ~ResourcePreloader();
+
+    /// Add a resource to the manifest. Must be called before Start().
+    void AddResource(StringHash type, const String& name);
+    /// Start loading the manifest. Resources already in the resource cache complete immediately, so E_PRELOADFINISHED may
+    /// be sent before this returns.
+    void Start();
+
+    /// Template version of adding a resource to the manifest.
+    template <class T> void AddResource(const String& name) { AddResource(T::GetTypeStatic(), name); }
+
+    /// Return number of resources in the manifest.
+    unsigned GetNumResources() const { return resources_.Size(); }
+    /// Return number of resources loaded or failed so far.
+    unsigned GetNumDone() const { return numDone_; }
+    /// Return number of resources that failed to load.
+    unsigned GetNumFailed() const { return numFailed_; }
+    /// Return fraction of the manifest done, from 0 to 1.
+    float GetProgress() const { return resources_.Size() ? (float)numDone_ / (float)resources_.Size() : 1.0f; }
+    /// Return whether the preload has started.
+    bool IsStarted() const { return started_; }
+    /// Return whether every resource has been loaded or has failed.
+    bool IsFinished() const { return started_ && numDone_ == resources_.Size(); }
+    /// Return time from the start to the end of the preload, or to now while it runs, in milliseconds.
+    float GetElapsedTime() const { return finished_ ? elapsedTime_ : timer_.GetUSec(false) / 1000.0f; }
+
+private:
+    /// Handle a background loaded resource.
+    void HandleResourceBackgroundLoaded(StringHash eventType, VariantMap& eventData);
+    /// Mark a resource done and send the progress, and the finish event when it was the last one.
+    void MarkDone(PreloadResource& resource, bool success);
+    /// Record the duration and send the finish event.
+    void Finish();
+
+    /// Manifest.
+    Vector<PreloadResource> resources_;
+    /// Timer from the start.
+    HiresTimer timer_;
+    /// Duration of the whole preload in milliseconds.
+    float elapsedTime_;
+    /// Number of resources loaded or failed.
+    unsigned numDone_;
+    /// Number of resources that failed to load.
+    unsigned numFailed_;
+    /// Started flag.
+    bool started_;
+    /// Finished flag.
+    bool finished_;
+};
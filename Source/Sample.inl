@@ -69,14 +69,18 @@ void Sample::Start()
         // On desktop platform, do not detect touch when we already got a joystick
         SubscribeToEvent(E_TOUCHBEGIN, HANDLER(Sample, HandleTouchBegin));
 
-    // Create logo
-    CreateLogo();
+    // Headless runs have no window, UI rendering, console or debug HUD
+    if (!engine_->IsHeadless())
+    {
+        // Create logo
+        CreateLogo();
 
-    // Set custom window Title & Icon
-    SetWindowTitleAndIcon();
+        // Set custom window Title & Icon
+        SetWindowTitleAndIcon();
 
-    // Create console and debug HUD
-    CreateConsoleAndDebugHud();
+        // Create console and debug HUD
+        CreateConsoleAndDebugHud();
+    }
 
     // Subscribe key down event
     SubscribeToEvent(E_KEYDOWN, HANDLER(Sample, HandleKeyDown));
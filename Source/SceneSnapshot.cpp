@@ -0,0 +1,359 @@
+//
+// Copyright (c) 2008-2015 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include <Urho3D/Core/Timer.h>
+#include <Urho3D/IO/File.h>
+#include <Urho3D/IO/FileSystem.h>
+#include <Urho3D/IO/Log.h>
+#include <Urho3D/IO/MemoryBuffer.h>
+#include <Urho3D/IO/VectorBuffer.h>
+#include <Urho3D/Physics/RigidBody.h>
+#include <Urho3D/Scene/Scene.h>
+#include <Urho3D/Scene/SceneResolver.h>
+
+#include "Character.h"
+#include "PlatformPrototype.h"
+#include "PlatformSystem.h"
+#include "SceneSnapshot.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <cstring>
+
+#include <Urho3D/DebugNew.h>
+
+/// Platform array in a scene snapshot file.
+enum SnapshotPlatformArray
+{
+    SNAPSHOT_NODE_IDS = 0,
+    SNAPSHOT_PLATFORM_IDS,
+    SNAPSHOT_BASE_POSITIONS,
+    SNAPSHOT_SCALES,
+    SNAPSHOT_AXES,
+    SNAPSHOT_FLAGS,
+    SNAPSHOT_PLATFORMS_END
+};
+
+/// Platform flag for a kinematic body.
+static const unsigned char SNAPSHOT_PLATFORM_KINEMATIC = 1;
+
+/// Read-only memory mapping of a whole file.
+class MappedFile
+{
+public:
+    /// Map a file. Check GetData() for success.
+    MappedFile(const String& fileName) :
+        data_(0),
+        size_(0)
+    {
+#ifdef _WIN32
+        mapping_ = 0;
+        file_ = CreateFileW(WString(GetNativePath(fileName)).CString(), GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING,
+            FILE_ATTRIBUTE_NORMAL, 0);
+        if (file_ == INVALID_HANDLE_VALUE)
+            return;
+        size_ = (unsigned)GetFileSize(file_, 0);
+        mapping_ = size_ ? CreateFileMappingW(file_, 0, PAGE_READONLY, 0, 0, 0) : 0;
+        if (mapping_)
+            data_ = (const unsigned char*)MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0);
+#else
+        file_ = open(GetNativePath(fileName).CString(), O_RDONLY);
+        if (file_ < 0)
+            return;
+        struct stat fileStat;
+        if (fstat(file_, &fileStat) < 0 || !fileStat.st_size)
+            return;
+        size_ = (unsigned)fileStat.st_size;
+        void* data = mmap(0, size_, PROT_READ, MAP_PRIVATE, file_, 0);
+        if (data != MAP_FAILED)
+            data_ = (const unsigned char*)data;
+#endif
+    }
+
+    /// Unmap and close the file.
+    ~MappedFile()
+    {
+#ifdef _WIN32
+        if (data_)
+            UnmapViewOfFile(data_);
+        if (mapping_)
+            CloseHandle(mapping_);
+        if (file_ != INVALID_HANDLE_VALUE)
+            CloseHandle(file_);
+#else
+        if (data_)
+            munmap((void*)data_, size_);
+        if (file_ >= 0)
+            close(file_);
+#endif
+    }
+
+    /// Return mapped data, or null if mapping failed.
+    const unsigned char* GetData() const { return data_; }
+    /// Return file size.
+    unsigned GetSize() const { return size_; }
+
+private:
+#ifdef _WIN32
+    /// File handle.
+    HANDLE file_;
+    /// Mapping handle.
+    HANDLE mapping_;
+#else
+    /// File descriptor.
+    int file_;
+#endif
+    /// Mapped data.
+    const unsigned char* data_;
+    /// File size.
+    unsigned size_;
+};
+
+/// Round an offset up to the snapshot array alignment.
+static unsigned AlignSnapshotOffset(unsigned offset)
+{
+    return (offset + SCENE_SNAPSHOT_ALIGNMENT - 1) & ~(SCENE_SNAPSHOT_ALIGNMENT - 1);
+}
+
+/// Compute the offsets of the platform arrays and their end, for the given number of platforms starting at an offset.
+static void GetPlatformArrayOffsets(unsigned start, unsigned numPlatforms, unsigned* offsets)
+{
+    const unsigned elementSizes[] = { sizeof(unsigned), sizeof(int), sizeof(Vector3), sizeof(Vector3), sizeof(Vector3),
+        sizeof(unsigned char) };
+
+    unsigned offset = AlignSnapshotOffset(start);
+    for (unsigned i = SNAPSHOT_NODE_IDS; i < SNAPSHOT_PLATFORMS_END; ++i)
+    {
+        offsets[i] = offset;
+        offset = AlignSnapshotOffset(offset + elementSizes[i] * numPlatforms);
+    }
+    offsets[SNAPSHOT_PLATFORMS_END] = offset;
+}
+
+SceneSnapshot::SceneSnapshot(Context* context) :
+    Object(context),
+    lastSaveTime_(0.0f),
+    lastLoadTime_(0.0f),
+    lastFileSize_(0)
+{
+}
+
+SceneSnapshot::~SceneSnapshot()
+{
+}
+
+bool SceneSnapshot::Save(Scene* scene, const String& fileName)
+{
+    if (!scene)
+        return false;
+
+    HiresTimer timer;
+
+    PlatformSystem* platformSystem = scene->GetComponent<PlatformSystem>();
+    unsigned numPlatforms = platformSystem ? platformSystem->GetNumPlatforms() : 0;
+    PODVector<Character*> characters;
+    scene->GetComponents<Character>(characters, true);
+
+    SceneSnapshotHeader header;
+    memset(&header, 0, sizeof header);
+    memcpy(header.id_, "CSNP", 4);
+    header.version_ = SCENE_SNAPSHOT_VERSION;
+    header.numPlatforms_ = numPlatforms;
+    header.numCharacters_ = characters.Size();
+    header.time_ = platformSystem ? platformSystem->GetTime() : 0.0;
+
+    unsigned offsets[SNAPSHOT_PLATFORMS_END + 1];
+    GetPlatformArrayOffsets(sizeof header, numPlatforms, offsets);
+    header.platformsOffset_ = offsets[SNAPSHOT_NODE_IDS];
+    header.charactersOffset_ = offsets[SNAPSHOT_PLATFORMS_END];
+
+    PODVector<unsigned char> data(header.charactersOffset_);
+    memset(data.Buffer(), 0, data.Size());
+
+    // Platform state goes in as plain arrays, so that the load can read them from the mapped file as they are
+    unsigned* nodeIDs = reinterpret_cast<unsigned*>(&data[offsets[SNAPSHOT_NODE_IDS]]);
+    int* ids = reinterpret_cast<int*>(&data[offsets[SNAPSHOT_PLATFORM_IDS]]);
+    Vector3* basePositions = reinterpret_cast<Vector3*>(&data[offsets[SNAPSHOT_BASE_POSITIONS]]);
+    Vector3* scales = reinterpret_cast<Vector3*>(&data[offsets[SNAPSHOT_SCALES]]);
+    Vector3* axes = reinterpret_cast<Vector3*>(&data[offsets[SNAPSHOT_AXES]]);
+    unsigned char* flags = &data[offsets[SNAPSHOT_FLAGS]];
+
+    for (unsigned i = 0; i < numPlatforms; ++i)
+    {
+        Node* node = platformSystem->GetPlatformNode(i);
+        RigidBody* body = node->GetComponent<RigidBody>();
+
+        nodeIDs[i] = node->GetID();
+        ids[i] = platformSystem->GetPlatformId(i);
+        basePositions[i] = platformSystem->GetPlatformBasePosition(i);
+        scales[i] = node->GetScale();
+        axes[i] = platformSystem->GetPlatformAxis(i);
+        flags[i] = body && body->IsKinematic() ? SNAPSHOT_PLATFORM_KINEMATIC : 0;
+    }
+
+    // Characters are few, so their attributes are stored in the engine's binary attribute format
+    for (unsigned i = 0; i < characters.Size(); ++i)
+    {
+        Character* character = characters[i];
+        Node* node = character->GetNode();
+        RigidBody* body = node->GetComponent<RigidBody>();
+
+        VectorBuffer attributes;
+        character->Serializable::Save(attributes);
+
+        SceneSnapshotCharacter record;
+        record.componentID_ = character->GetID();
+        record.attributesSize_ = attributes.GetSize();
+        record.position_ = node->GetPosition();
+        record.rotation_ = node->GetRotation();
+        record.linearVelocity_ = body ? body->GetLinearVelocity() : Vector3::ZERO;
+
+        unsigned offset = data.Size();
+        data.Resize(AlignSnapshotOffset(offset + sizeof record + attributes.GetSize()));
+        memset(&data[offset], 0, data.Size() - offset);
+        memcpy(&data[offset], &record, sizeof record);
+        if (attributes.GetSize())
+            memcpy(&data[offset + sizeof record], attributes.GetData(), attributes.GetSize());
+    }
+
+    header.fileSize_ = data.Size();
+    memcpy(&data[0], &header, sizeof header);
+
+    File file(context_, fileName, FILE_WRITE);
+    if (!file.IsOpen() || file.Write(&data[0], data.Size()) != data.Size())
+    {
+        LOGERROR("Could not write scene snapshot " + fileName);
+        return false;
+    }
+
+    lastFileSize_ = data.Size();
+    lastSaveTime_ = timer.GetUSec(false) / 1000.0f;
+    LOGINFOF("Saved %u platforms and %u characters to %s in %.2f ms", numPlatforms, characters.Size(), fileName.CString(),
+        lastSaveTime_);
+    return true;
+}
+
+bool SceneSnapshot::Load(Scene* scene, const String& fileName)
+{
+    if (!scene)
+        return false;
+
+    HiresTimer timer;
+
+    MappedFile file(fileName);
+    const unsigned char* data = file.GetData();
+    if (!data)
+    {
+        LOGERROR("Could not map scene snapshot " + fileName);
+        return false;
+    }
+
+    SceneSnapshotHeader header;
+    if (file.GetSize() < sizeof header)
+    {
+        LOGERROR(fileName + " is not a scene snapshot");
+        return false;
+    }
+    memcpy(&header, data, sizeof header);
+
+    unsigned offsets[SNAPSHOT_PLATFORMS_END + 1];
+    GetPlatformArrayOffsets(sizeof header, header.numPlatforms_, offsets);
+    if (memcmp(header.id_, "CSNP", 4) || header.version_ != SCENE_SNAPSHOT_VERSION || header.fileSize_ != file.GetSize() ||
+        header.platformsOffset_ != offsets[SNAPSHOT_NODE_IDS] || header.charactersOffset_ != offsets[SNAPSHOT_PLATFORMS_END] ||
+        header.charactersOffset_ > header.fileSize_)
+    {
+        LOGERROR(fileName + " is not a scene snapshot of this version");
+        return false;
+    }
+
+    // Replace the current platforms
+    PlatformSystem* platformSystem = scene->GetOrCreateComponent<PlatformSystem>();
+    PODVector<Node*> oldPlatforms;
+    for (unsigned i = 0; i < platformSystem->GetNumPlatforms(); ++i)
+        oldPlatforms.Push(platformSystem->GetPlatformNode(i));
+    platformSystem->RemoveAllPlatforms();
+    for (unsigned i = 0; i < oldPlatforms.Size(); ++i)
+        oldPlatforms[i]->Remove();
+
+    const unsigned* nodeIDs = reinterpret_cast<const unsigned*>(data + offsets[SNAPSHOT_NODE_IDS]);
+    const int* ids = reinterpret_cast<const int*>(data + offsets[SNAPSHOT_PLATFORM_IDS]);
+    const Vector3* basePositions = reinterpret_cast<const Vector3*>(data + offsets[SNAPSHOT_BASE_POSITIONS]);
+    const Vector3* scales = reinterpret_cast<const Vector3*>(data + offsets[SNAPSHOT_SCALES]);
+    const Vector3* axes = reinterpret_cast<const Vector3*>(data + offsets[SNAPSHOT_AXES]);
+    const unsigned char* flags = data + offsets[SNAPSHOT_FLAGS];
+
+    // The arrays are used in place to create the platforms in bulk. The new platform nodes get new IDs; the resolver maps
+    // the saved IDs to them for the characters' platform references
+    if (header.numPlatforms_)
+        PlatformPrototype().Instantiate(scene, platformSystem, header.numPlatforms_, basePositions, scales, flags, ids, axes);
+    SceneResolver resolver;
+    for (unsigned i = 0; i < header.numPlatforms_; ++i)
+        resolver.AddNode(nodeIDs[i], platformSystem->GetPlatformNode(i));
+    platformSystem->SetTime(header.time_);
+
+    PODVector<Character*> characters;
+    scene->GetComponents<Character>(characters, true);
+    unsigned numCharacters = Min(header.numCharacters_, characters.Size());
+    unsigned offset = header.charactersOffset_;
+
+    for (unsigned i = 0; i < numCharacters; ++i)
+    {
+        SceneSnapshotCharacter record;
+        if (offset + sizeof record > header.fileSize_)
+            break;
+        memcpy(&record, data + offset, sizeof record);
+        if (offset + sizeof record + record.attributesSize_ > header.fileSize_)
+            break;
+
+        Character* character = characters[i];
+        MemoryBuffer attributes(data + offset + sizeof record, record.attributesSize_);
+        character->Load(attributes);
+        resolver.AddComponent(record.componentID_, character);
+
+        Node* node = character->GetNode();
+        node->SetPosition(record.position_);
+        node->SetRotation(record.rotation_);
+        RigidBody* body = node->GetComponent<RigidBody>();
+        if (body)
+            body->SetLinearVelocity(record.linearVelocity_);
+
+        offset = AlignSnapshotOffset(offset + sizeof record + record.attributesSize_);
+    }
+
+    resolver.Resolve();
+    for (unsigned i = 0; i < numCharacters; ++i)
+        characters[i]->ApplyAttributes();
+
+    lastFileSize_ = header.fileSize_;
+    lastLoadTime_ = timer.GetUSec(false) / 1000.0f;
+    LOGINFOF("Loaded %u platforms and %u characters from %s in %.2f ms", header.numPlatforms_, numCharacters,
+        fileName.CString(), lastLoadTime_);
+    return true;
+}
@@ -0,0 +1,118 @@
+//
+// Copyright (c) 2008-2015 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#pragma once
+
+#include <Urho3D/Core/Object.h>
+#include <Urho3D/Math/Quaternion.h>
+
+namespace Urho3D
+{
+
+class Scene;
+
+}
+
+using namespace Urho3D;
+
+/// Scene snapshot file format version.
+static const unsigned SCENE_SNAPSHOT_VERSION = 2;
+/// Alignment of the arrays in a scene snapshot file.
+static const unsigned SCENE_SNAPSHOT_ALIGNMENT = 16;
+
+/// Scene snapshot file header.
+struct SceneSnapshotHeader
+{
+    /// File identifier, "CSNP".
+    char id_[4];
+    /// Format version.
+    unsigned version_;
+    /// Size of the whole file in bytes.
+    unsigned fileSize_;
+    /// Number of platforms.
+    unsigned numPlatforms_;
+    /// Number of characters.
+    unsigned numCharacters_;
+    /// Offset of the platform arrays from the start of the file.
+    unsigned platformsOffset_;
+    /// Offset of the character records from the start of the file.
+    unsigned charactersOffset_;
+    /// Reserved, zero.
+    unsigned reserved_;
+    /// Platform simulation time.
+    double time_;
+};
+
+/// Scene snapshot record of one character.
+struct SceneSnapshotCharacter
+{
+    /// Component ID when saved, to remap its node references.
+    unsigned componentID_;
+    /// Size of the serialized character attributes following the record.
+    unsigned attributesSize_;
+    /// Node position.
+    Vector3 position_;
+    /// Node rotation.
+    Quaternion rotation_;
+    /// Rigid body linear velocity.
+    Vector3 linearVelocity_;
+};
+
+/// Compact binary snapshot of the moving platforms and the character state of a scene. The platform state is stored as
+/// aligned arrays in native byte order, which are read straight from a memory mapping of the file to create the platforms
+/// in one pass, with no per-attribute parsing. Characters are restored onto the characters of the scene in hierarchy
+/// order, from their binary attributes. The static scenery is not stored; it is created as usual.
+///
+/// File layout: header, then at platformsOffset_ the arrays of node IDs, platform ids, base positions, scales, motion
+/// axes and kinematic flags (each starting aligned), then at charactersOffset_ the character records, each followed by
+/// its attributes.
+class SceneSnapshot : public Object
+{
+    OBJECT(SceneSnapshot);
+
+public:
+    /// Construct.
+    SceneSnapshot(Context* context);
+    /// Destruct.
+    virtual ~SceneSnapshot();
+
+    /// Write the platforms and characters of a scene to a file. Return true on success.
+    bool Save(Scene* scene, const String& fileName);
+    /// Replace the platforms of a scene with those of a snapshot file and restore its characters. Return true on success.
+    bool Load(Scene* scene, const String& fileName);
+
+    /// Return duration of the last save in milliseconds.
+    float GetLastSaveTime() const { return lastSaveTime_; }
+    /// Return duration of the last load in milliseconds.
+    float GetLastLoadTime() const { return lastLoadTime_; }
+    /// Return size of the last saved or loaded file in bytes.
+    unsigned GetLastFileSize() const { return lastFileSize_; }
+
+private:
+    /// Duration of the last save in milliseconds.
+    float lastSaveTime_;
+    /// Duration of the last load in milliseconds.
+    float lastLoadTime_;
+    /// Size of the last saved or loaded file in bytes.
+    unsigned lastFileSize_;
+};
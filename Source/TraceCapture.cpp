@@ -0,0 +1,282 @@
+//
+// Copyright (c) 2008-2015 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include <Urho3D/Core/CoreEvents.h>
+#include <Urho3D/Core/Mutex.h>
+#include <Urho3D/Core/Thread.h>
+#include <Urho3D/Core/Timer.h>
+#include <Urho3D/Engine/EngineEvents.h>
+#include <Urho3D/IO/File.h>
+#include <Urho3D/IO/Log.h>
+#include <Urho3D/Physics/PhysicsEvents.h>
+#include <Urho3D/Physics/PhysicsWorld.h>
+#include <Urho3D/Scene/Scene.h>
+
+#include "TraceCapture.h"
+
+#include <Urho3D/DebugNew.h>
+
+#ifdef _MSC_VER
+#define TRACE_THREAD_LOCAL __declspec(thread)
+#else
+#define TRACE_THREAD_LOCAL __thread
+#endif
+
+/// Ring buffer of the zones of one thread.
+struct TraceBuffer
+{
+    /// Zones.
+    PODVector<TraceZoneRecord> zones_;
+    /// Index of the next zone to write.
+    unsigned next_;
+    /// Number of valid zones.
+    unsigned count_;
+    /// Thread name.
+    String name_;
+};
+
+volatile bool TraceCapture::capturing_ = false;
+
+/// Thread buffers, claimed on the first zone of each thread and kept for the lifetime of the process.
+static TraceBuffer traceBuffers[MAX_TRACE_THREADS];
+/// Number of claimed thread buffers.
+static unsigned numTraceBuffers = 0;
+/// Mutex for claiming thread buffers.
+static Mutex traceBufferMutex;
+/// Capture start time.
+static HiresTimer traceEpoch;
+/// Buffer of the calling thread, or null if not claimed yet.
+static TRACE_THREAD_LOCAL TraceBuffer* threadTraceBuffer = 0;
+
+/// Claim a buffer for the calling thread. Return null when all buffers are taken.
+static TraceBuffer* ClaimTraceBuffer()
+{
+    MutexLock lock(traceBufferMutex);
+
+    if (numTraceBuffers >= MAX_TRACE_THREADS)
+        return 0;
+
+    TraceBuffer* buffer = &traceBuffers[numTraceBuffers];
+    buffer->zones_.Resize(TRACE_BUFFER_ZONES);
+    buffer->next_ = 0;
+    buffer->count_ = 0;
+    buffer->name_ = Thread::IsMainThread() ? "Main thread" : "Worker thread " + String(numTraceBuffers);
+    ++numTraceBuffers;
+
+    return buffer;
+}
+
+TraceCapture::TraceCapture(Context* context) :
+    Object(context),
+    outputFile_("Trace.json"),
+    frameStart_(-1),
+    physicsStepStart_(-1)
+{
+    SubscribeToEvent(E_CONSOLECOMMAND, HANDLER(TraceCapture, HandleConsoleCommand));
+}
+
+TraceCapture::~TraceCapture()
+{
+    Stop();
+}
+
+void TraceCapture::Start()
+{
+    {
+        MutexLock lock(traceBufferMutex);
+        for (unsigned i = 0; i < numTraceBuffers; ++i)
+        {
+            traceBuffers[i].next_ = 0;
+            traceBuffers[i].count_ = 0;
+        }
+    }
+
+    traceEpoch.Reset();
+    frameStart_ = -1;
+    physicsStepStart_ = -1;
+    capturing_ = true;
+
+    SubscribeToEvent(E_BEGINFRAME, HANDLER(TraceCapture, HandleBeginFrame));
+    SubscribeToEvent(E_ENDFRAME, HANDLER(TraceCapture, HandleEndFrame));
+
+    LOGINFO("Trace capture started");
+}
+
+void TraceCapture::Stop()
+{
+    if (!capturing_)
+        return;
+
+    capturing_ = false;
+    UnsubscribeFromEvent(E_BEGINFRAME);
+    UnsubscribeFromEvent(E_ENDFRAME);
+
+    LOGINFO("Trace capture stopped");
+}
+
+bool TraceCapture::Dump(const String& fileName)
+{
+    File file(context_, fileName, FILE_WRITE);
+    if (!file.IsOpen())
+    {
+        LOGERROR("Could not write trace to " + fileName);
+        return false;
+    }
+
+    file.WriteLine(GetTraceJSON());
+    LOGINFOF("Wrote %u trace zones to %s", GetNumZones(), fileName.CString());
+    return true;
+}
+
+void TraceCapture::SetScene(Scene* scene)
+{
+    if (scene_)
+    {
+        PhysicsWorld* oldWorld = scene_->GetComponent<PhysicsWorld>();
+        if (oldWorld)
+        {
+            UnsubscribeFromEvent(oldWorld, E_PHYSICSPRESTEP);
+            UnsubscribeFromEvent(oldWorld, E_PHYSICSPOSTSTEP);
+        }
+    }
+
+    scene_ = scene;
+
+    PhysicsWorld* physicsWorld = scene ? scene->GetComponent<PhysicsWorld>() : 0;
+    if (physicsWorld)
+    {
+        SubscribeToEvent(physicsWorld, E_PHYSICSPRESTEP, HANDLER(TraceCapture, HandlePhysicsPreStep));
+        SubscribeToEvent(physicsWorld, E_PHYSICSPOSTSTEP, HANDLER(TraceCapture, HandlePhysicsPostStep));
+    }
+}
+
+String TraceCapture::GetTraceJSON() const
+{
+    MutexLock lock(traceBufferMutex);
+
+    String json = "{\"traceEvents\":[";
+    bool first = true;
+
+    for (unsigned i = 0; i < numTraceBuffers; ++i)
+    {
+        const TraceBuffer& buffer = traceBuffers[i];
+
+        if (!first)
+            json += ",";
+        first = false;
+        json += "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" + String(i) + ",\"args\":{\"name\":\"" +
+            buffer.name_ + "\"}}";
+
+        // Oldest zone first. Once the buffer has wrapped, the oldest zone is the one to be overwritten next
+        unsigned oldest = buffer.count_ < TRACE_BUFFER_ZONES ? 0 : buffer.next_;
+        for (unsigned j = 0; j < buffer.count_; ++j)
+        {
+            const TraceZoneRecord& zone = buffer.zones_[(oldest + j) % TRACE_BUFFER_ZONES];
+            json += ",{\"name\":\"" + String(zone.name_) + "\",\"ph\":\"X\",\"pid\":1,\"tid\":" + String(i) + ",\"ts\":" +
+                String(zone.start_) + ",\"dur\":" + String(zone.duration_) + "}";
+        }
+    }
+
+    json += "],\"displayTimeUnit\":\"ms\"}";
+    return json;
+}
+
+unsigned TraceCapture::GetNumZones() const
+{
+    MutexLock lock(traceBufferMutex);
+
+    unsigned count = 0;
+    for (unsigned i = 0; i < numTraceBuffers; ++i)
+        count += traceBuffers[i].count_;
+    return count;
+}
+
+long long TraceCapture::GetTimestamp()
+{
+    return traceEpoch.GetUSec(false);
+}
+
+void TraceCapture::RecordZone(const char* name, long long start)
+{
+    if (!capturing_)
+        return;
+
+    TraceBuffer* buffer = threadTraceBuffer;
+    if (!buffer)
+    {
+        buffer = threadTraceBuffer = ClaimTraceBuffer();
+        if (!buffer)
+            return;
+    }
+
+    TraceZoneRecord& zone = buffer->zones_[buffer->next_];
+    zone.name_ = name;
+    zone.start_ = start;
+    zone.duration_ = GetTimestamp() - start;
+
+    buffer->next_ = (buffer->next_ + 1) % TRACE_BUFFER_ZONES;
+    if (buffer->count_ < TRACE_BUFFER_ZONES)
+        ++buffer->count_;
+}
+
+void TraceCapture::HandleBeginFrame(StringHash eventType, VariantMap& eventData)
+{
+    frameStart_ = GetTimestamp();
+}
+
+void TraceCapture::HandleEndFrame(StringHash eventType, VariantMap& eventData)
+{
+    if (frameStart_ >= 0)
+        RecordZone("Frame", frameStart_);
+}
+
+void TraceCapture::HandlePhysicsPreStep(StringHash eventType, VariantMap& eventData)
+{
+    physicsStepStart_ = capturing_ ? GetTimestamp() : -1;
+}
+
+void TraceCapture::HandlePhysicsPostStep(StringHash eventType, VariantMap& eventData)
+{
+    // The collision events and listeners of the step are dispatched before the post-step event, so they are included
+    if (physicsStepStart_ >= 0)
+        RecordZone("PhysicsStep", physicsStepStart_);
+}
+
+void TraceCapture::HandleConsoleCommand(StringHash eventType, VariantMap& eventData)
+{
+    using namespace ConsoleCommand;
+
+    Vector<String> arguments = eventData[P_COMMAND].GetString().Split(' ');
+    if (arguments.Empty() || arguments[0].ToLower() != "trace")
+        return;
+
+    String command = arguments.Size() > 1 ? arguments[1].ToLower() : String::EMPTY;
+    if (command == "start")
+        Start();
+    else if (command == "stop")
+        Stop();
+    else if (command == "dump")
+        Dump(arguments.Size() > 2 ? arguments[2] : outputFile_);
+    else
+        LOGINFO("Usage: trace start | stop | dump [file]");
+}
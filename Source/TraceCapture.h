@@ -0,0 +1,144 @@
+//
+// Copyright (c) 2008-2015 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#pragma once
+
+#include <Urho3D/Core/Object.h>
+
+namespace Urho3D
+{
+
+class Scene;
+
+}
+
+using namespace Urho3D;
+
+/// Maximum number of threads that can record trace zones.
+static const unsigned MAX_TRACE_THREADS = 64;
+/// Number of zones kept per thread. When full, the oldest zones are overwritten.
+static const unsigned TRACE_BUFFER_ZONES = 65536;
+
+/// Recorded trace zone.
+struct TraceZoneRecord
+{
+    /// Zone name. Must be a string literal or otherwise outlive the capture.
+    const char* name_;
+    /// Start time in microseconds since the capture started.
+    long long start_;
+    /// Duration in microseconds.
+    long long duration_;
+};
+
+/// Timeline capture of named zones on all threads, written out in the Chrome trace event format for chrome://tracing.
+/// Each thread records into its own ring buffer without locking; when not capturing, a zone costs one flag check. Capture
+/// control and dumping must happen on the main thread while no work items are running.
+class TraceCapture : public Object
+{
+    OBJECT(TraceCapture);
+
+public:
+    /// Construct.
+    TraceCapture(Context* context);
+    /// Destruct. Stops capturing.
+    virtual ~TraceCapture();
+
+    /// Clear the buffers and start capturing.
+    void Start();
+    /// Stop capturing. The buffers are kept for dumping.
+    void Stop();
+    /// Write the buffers as Chrome trace event JSON. Return true on success.
+    bool Dump(const String& fileName);
+    /// Record the physics steps of a scene as zones.
+    void SetScene(Scene* scene);
+    /// Set the file the console command and the hotkey dump to.
+    void SetOutputFile(const String& fileName) { outputFile_ = fileName; }
+
+    /// Return the dump file name.
+    const String& GetOutputFile() const { return outputFile_; }
+    /// Return the buffers as Chrome trace event JSON.
+    String GetTraceJSON() const;
+    /// Return number of zones in the buffers.
+    unsigned GetNumZones() const;
+
+    /// Return whether capturing.
+    static bool IsCapturing() { return capturing_; }
+    /// Return microseconds since the capture started.
+    static long long GetTimestamp();
+    /// Record a zone that started at the given timestamp and ends now on the calling thread.
+    static void RecordZone(const char* name, long long start);
+
+private:
+    /// Handle frame begin.
+    void HandleBeginFrame(StringHash eventType, VariantMap& eventData);
+    /// Handle frame end.
+    void HandleEndFrame(StringHash eventType, VariantMap& eventData);
+    /// Handle physics step begin.
+    void HandlePhysicsPreStep(StringHash eventType, VariantMap& eventData);
+    /// Handle physics step end.
+    void HandlePhysicsPostStep(StringHash eventType, VariantMap& eventData);
+    /// Handle a console command.
+    void HandleConsoleCommand(StringHash eventType, VariantMap& eventData);
+
+    /// Scene whose physics steps are recorded.
+    WeakPtr<Scene> scene_;
+    /// Dump file name.
+    String outputFile_;
+    /// Current frame start timestamp.
+    long long frameStart_;
+    /// Current physics step start timestamp.
+    long long physicsStepStart_;
+
+    /// Capturing flag, checked by every zone.
+    static volatile bool capturing_;
+};
+
+/// Scoped trace zone. Records its lifetime on the calling thread when capturing.
+class TraceZone
+{
+public:
+    /// Construct and start timing if capturing.
+    TraceZone(const char* name) :
+        name_(name),
+        start_(TraceCapture::IsCapturing() ? TraceCapture::GetTimestamp() : -1)
+    {
+    }
+
+    /// Destruct and record the zone if it was started.
+    ~TraceZone()
+    {
+        if (start_ >= 0)
+            TraceCapture::RecordZone(name_, start_);
+    }
+
+private:
+    /// Zone name.
+    const char* name_;
+    /// Start timestamp, or negative if not capturing.
+    long long start_;
+};
+
+#define TRACE_ZONE_CONCAT_IMPL(a, b) a##b
+#define TRACE_ZONE_CONCAT(a, b) TRACE_ZONE_CONCAT_IMPL(a, b)
+/// Record the rest of the enclosing scope as a named trace zone. The name must be a string literal.
+#define TRACE_ZONE(name) TraceZone TRACE_ZONE_CONCAT(traceZone_, __LINE__)(name)